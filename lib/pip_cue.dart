@@ -0,0 +1,21 @@
+/// One timed line of a cue track, see [PipPlugin.loadCueTrack].
+class PipCue {
+  /// When the line appears, from the start of the track.
+  final Duration start;
+
+  /// When the line disappears.
+  final Duration end;
+
+  final String text;
+
+  const PipCue({required this.start, required this.end, required this.text});
+
+  Map<String, Object?> toMap() => {
+        'startMs': start.inMilliseconds,
+        'endMs': end.inMilliseconds,
+        'text': text,
+      };
+
+  @override
+  String toString() => 'PipCue(start: $start, end: $end, text: $text)';
+}
@@ -0,0 +1,3 @@
+/// Easing of an animation started with [PipPlugin.animate]. The eased
+/// curves are cubic.
+enum PipCurve { linear, easeIn, easeOut, easeInOut }
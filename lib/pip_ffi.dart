@@ -0,0 +1,177 @@
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:math';
+import 'dart:typed_data';
+
+import 'package:ffi/ffi.dart';
+
+typedef _TextNative = Void Function(Pointer<Utf8> text);
+typedef _Text = void Function(Pointer<Utf8> text);
+typedef _RedrawNative = Void Function();
+typedef _Redraw = void Function();
+typedef _RingOpenNative = Pointer<Uint8> Function(Uint32 capacity);
+typedef _RingOpen = Pointer<Uint8> Function(int capacity);
+typedef _RingCapacityNative = Uint32 Function();
+typedef _RingIndexNative = Uint64 Function();
+typedef _RingIndex = int Function();
+typedef _RingPublishNative = Void Function(Uint64 writeIndex);
+typedef _RingPublish = void Function(int writeIndex);
+
+/// Synchronous text updates through the plugin's C ABI on Linux and
+/// Windows, skipping the method channel's async hop and codec.
+///
+/// Meant for tickers and timers that update the text many times per
+/// second. Setup and lifecycle still go through [PipPlugin]. Calls return
+/// immediately; the native side keeps only the newest text and shows it
+/// with the next frame of the PiP window.
+class PipFfi {
+  PipFfi._(DynamicLibrary library)
+      : _setText = library
+            .lookupFunction<_TextNative, _Text>('pip_plugin_ffi_set_text'),
+        _appendText = library
+            .lookupFunction<_TextNative, _Text>('pip_plugin_ffi_append_text'),
+        _requestRedraw = library.lookupFunction<_RedrawNative, _Redraw>(
+            'pip_plugin_ffi_request_redraw'),
+        _library = library;
+
+  static PipFfi? _instance;
+
+  /// The binding, or `null` on platforms without the C ABI.
+  static PipFfi? get instance {
+    if (_instance == null) {
+      if (Platform.isLinux) {
+        _instance = PipFfi._(DynamicLibrary.open('libpip_plugin_plugin.so'));
+      } else if (Platform.isWindows) {
+        _instance = PipFfi._(DynamicLibrary.open('pip_plugin_plugin.dll'));
+      }
+    }
+    return _instance;
+  }
+
+  final _Text _setText;
+  final _Text _appendText;
+  final _Redraw _requestRedraw;
+  final DynamicLibrary _library;
+  PipTextRing? _ring;
+
+  // The native side copies the text before returning, so one buffer is
+  // reused for every call and only grows.
+  Pointer<Uint8> _buffer = nullptr;
+  int _capacity = 0;
+
+  /// Replaces the text shown in PiP.
+  void setText(String text) => _setText(_encode(text));
+
+  /// Appends [text] to the text shown in PiP.
+  void appendText(String text) => _appendText(_encode(text));
+
+  /// Re-renders the whole PiP window.
+  void requestRedraw() => _requestRedraw();
+
+  /// The process-wide ring for streaming updates, created with [capacity]
+  /// bytes (rounded up to a power of two) on first use. A single update
+  /// carries at most [PipTextRing.maxTextBytes], half of that.
+  PipTextRing openRing({int capacity = 1 << 16}) {
+    return _ring ??= PipTextRing._(_library, capacity);
+  }
+
+  Pointer<Utf8> _encode(String text) {
+    final Uint8List bytes = utf8.encode(text);
+    if (bytes.length + 1 > _capacity) {
+      if (_buffer != nullptr) malloc.free(_buffer);
+      _capacity = max(256, (bytes.length + 1) * 2);
+      _buffer = malloc<Uint8>(_capacity);
+    }
+    _buffer.asTypedList(_capacity)
+      ..setAll(0, bytes)
+      ..[bytes.length] = 0;
+    return _buffer.cast<Utf8>();
+  }
+}
+
+/// Streams text updates to the PiP window through a lock-free
+/// single-producer/single-consumer ring in native memory.
+///
+/// Writes go straight into the ring and never wait for the native side. The
+/// PiP window drains the ring at most once per frame and renders only the
+/// resulting text, so a producer may write far faster than the display
+/// refreshes. Only one isolate may write to the ring.
+class PipTextRing {
+  PipTextRing._(DynamicLibrary library, int capacity)
+      : _readIndexOf = library.lookupFunction<_RingIndexNative, _RingIndex>(
+            'pip_plugin_ffi_ring_read_index',
+            isLeaf: true),
+        _publish = library.lookupFunction<_RingPublishNative, _RingPublish>(
+            'pip_plugin_ffi_ring_publish',
+            isLeaf: true) {
+    final data = library
+        .lookupFunction<_RingOpenNative, _RingOpen>('pip_plugin_ffi_ring_open')(
+      capacity,
+    );
+    _capacity = library.lookupFunction<_RingCapacityNative, _RingIndex>(
+        'pip_plugin_ffi_ring_capacity')();
+    _data = data.asTypedList(_capacity);
+    _header = ByteData.sublistView(_data);
+    _writeIndex = library.lookupFunction<_RingIndexNative, _RingIndex>(
+        'pip_plugin_ffi_ring_write_index')();
+    _readIndex = _readIndexOf();
+  }
+
+  static const int _headerSize = 8;
+  static const int _kindWrap = 0;
+  static const int _kindSetText = 1;
+  static const int _kindAppendText = 2;
+
+  final _RingIndex _readIndexOf;
+  final _RingPublish _publish;
+  late final int _capacity;
+  late final Uint8List _data;
+  late final ByteData _header;
+  late int _writeIndex;
+  // Consumer position as last read; only refreshed when the ring looks full.
+  late int _readIndex;
+
+  /// The longest text in UTF-8 bytes a single update may carry: half the
+  /// ring less the record header. As records never wrap, a larger one
+  /// might not fit even once the PiP window has caught up.
+  int get maxTextBytes => _capacity ~/ 2 - _headerSize;
+
+  /// Replaces the text shown in PiP. Returns `false` if the ring is full
+  /// because the PiP window is a whole ring behind, or if [text] is longer
+  /// than [maxTextBytes]; the update is dropped.
+  bool setText(String text) => _write(_kindSetText, text);
+
+  /// Appends [text] to the text shown in PiP. Returns `false` if the ring
+  /// is full or [text] is longer than [maxTextBytes]; the update is
+  /// dropped.
+  bool appendText(String text) => _write(_kindAppendText, text);
+
+  bool _write(int kind, String text) {
+    final Uint8List bytes = utf8.encode(text);
+    if (bytes.length > maxTextBytes) return false;
+    final size = (_headerSize + bytes.length + 7) & ~7;
+
+    // Records never wrap; the rest of the ring is skipped instead.
+    var offset = _writeIndex & (_capacity - 1);
+    final padding = _capacity - offset < size ? _capacity - offset : 0;
+    final end = _writeIndex + padding + size;
+    if (end - _readIndex > _capacity) {
+      _readIndex = _readIndexOf();
+      if (end - _readIndex > _capacity) return false;
+    }
+
+    if (padding > 0) {
+      _header.setUint32(offset, _kindWrap, Endian.host);
+      offset = 0;
+    }
+    _header
+      ..setUint32(offset, kind, Endian.host)
+      ..setUint32(offset + 4, bytes.length, Endian.host);
+    _data.setRange(offset + _headerSize, offset + _headerSize + bytes.length,
+        bytes);
+    _writeIndex = end;
+    _publish(_writeIndex);
+    return true;
+  }
+}
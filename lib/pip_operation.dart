@@ -0,0 +1,95 @@
+import 'dart:math';
+
+import 'package:flutter/material.dart';
+import 'package:pip_plugin/pip_configuration.dart';
+
+/// One step of a [PipPlugin.applyBatch] call.
+sealed class PipOperation {
+  const PipOperation();
+}
+
+/// Changes the style. Fields left `null` keep their current value.
+class PipStyleOperation extends PipOperation {
+  final Color? backgroundColor;
+  final Color? textColor;
+  final double? textSize;
+  final TextAlign? textAlign;
+  final (int, int)? ratio;
+  final double? speed;
+
+  const PipStyleOperation({
+    this.backgroundColor,
+    this.textColor,
+    this.textSize,
+    this.textAlign,
+    this.ratio,
+    this.speed,
+  });
+
+  PipConfiguration applyTo(PipConfiguration configuration) {
+    return configuration.copyWith(
+      backgroundColor: backgroundColor,
+      textColor: textColor,
+      textSize: textSize,
+      textAlign: textAlign,
+      ratio: ratio,
+      speed: speed,
+    );
+  }
+}
+
+/// Replaces the whole text.
+class PipSetTextOperation extends PipOperation {
+  final String text;
+
+  const PipSetTextOperation(this.text);
+}
+
+/// Appends [text] to the current text.
+class PipAppendTextOperation extends PipOperation {
+  final String text;
+
+  const PipAppendTextOperation(this.text);
+}
+
+/// Replaces the text from [start] to [end], like [String.replaceRange].
+class PipReplaceRangeOperation extends PipOperation {
+  final int start;
+  final int end;
+  final String text;
+
+  const PipReplaceRangeOperation(this.start, this.end, this.text);
+
+  /// Throws a [RangeError] unless `0 <= start <= end`. Offsets past the end
+  /// of the text are clamped when applied, as on Linux and Windows only the
+  /// native side knows its length.
+  static void checkRange(int start, int end) =>
+      RangeError.checkValidRange(start, end, max(start, end));
+
+  /// [current] with [start] to [end] replaced by [text], the offsets clamped
+  /// to its length, for the platforms that keep the text in Dart.
+  static String applyTo(String current, int start, int end, String text) {
+    final from = start.clamp(0, current.length);
+    return current.replaceRange(from, end.clamp(from, current.length), text);
+  }
+}
+
+/// Clears the text.
+class PipClearTextOperation extends PipOperation {
+  const PipClearTextOperation();
+}
+
+/// Starts or pauses scrolling, see [PipPlugin.controlScroll].
+class PipScrollOperation extends PipOperation {
+  final bool isScrolling;
+  final double? speed;
+
+  const PipScrollOperation({required this.isScrolling, this.speed});
+}
+
+/// Shows ([visible] `true`) or hides the PiP window.
+class PipVisibilityOperation extends PipOperation {
+  final bool visible;
+
+  const PipVisibilityOperation(this.visible);
+}
@@ -1,6 +1,11 @@
 import 'dart:ui';
 
 import 'package:pip_plugin/pip_configuration.dart';
+import 'package:pip_plugin/pip_cue.dart';
+import 'package:pip_plugin/pip_curve.dart';
+import 'package:pip_plugin/pip_operation.dart';
+import 'package:pip_plugin/pip_stats.dart';
+import 'package:pip_plugin/pip_window.dart';
 import 'package:simple_pip_mode/actions/pip_action.dart';
 
 import 'src/contracts/pip_plugin_platform_interface.dart';
@@ -15,14 +20,21 @@ class PipPlugin {
   }
 
   /// On **desktop platforms**, you can optionally set a [windowTitle].
+  ///
+  /// With [prewarm] on Linux and Windows the hidden window is created and
+  /// its first frame rendered right away, and closing it only hides it, so
+  /// [startPip] shows it within a frame. [getStats] reports the time to
+  /// that frame.
   Future<bool> setupPip({
     String? windowTitle,
     PipConfiguration? configuration,
+    bool prewarm = false,
   }) {
     _ensureNotDisposed();
     return PipPluginPlatform.instance.setupPip(
       configuration: configuration,
       windowTitle: windowTitle,
+      prewarm: prewarm,
     );
   }
 
@@ -74,9 +86,242 @@ class PipPlugin {
     return PipPluginPlatform.instance.updateText(text);
   }
 
+  /// Appends [text] to the text shown in PiP.
+  ///
+  /// On Linux and Windows only [text] is sent to the native side, so
+  /// streaming output into a long text stays cheap.
+  Future<bool> appendText(String text) {
+    _ensureNotDisposed();
+    return PipPluginPlatform.instance.appendText(text);
+  }
+
+  /// Replaces the text from [start] (inclusive) to [end] (exclusive) with
+  /// [text], like [String.replaceRange]. Throws a [RangeError] if [start] is
+  /// negative or after [end]; offsets past the end of the text are clamped.
+  Future<bool> replaceRange(int start, int end, String text) {
+    _ensureNotDisposed();
+    PipReplaceRangeOperation.checkRange(start, end);
+    return PipPluginPlatform.instance.replaceRange(start, end, text);
+  }
+
+  /// Clears the text shown in PiP.
+  Future<bool> clearText() {
+    _ensureNotDisposed();
+    return PipPluginPlatform.instance.clearText();
+  }
+
+  /// Replaces the text with the contents of the UTF-8 file at [path].
+  /// Returns `false` if the file cannot be read.
+  ///
+  /// On Linux and Windows the file is memory-mapped natively instead of
+  /// being read in Dart and sent over the platform channel. Both render
+  /// straight from the mapping until the text is edited, so the file must
+  /// not be truncated meanwhile, and lay out only the paragraphs on
+  /// screen, so a large script shows as fast as a short one. Elsewhere on
+  /// native platforms the file is read in Dart.
+  Future<bool> loadTextFile(String path) {
+    _ensureNotDisposed();
+    return PipPluginPlatform.instance.loadTextFile(path);
+  }
+
+  /// Applies [operations] in order as a single update.
+  ///
+  /// On Linux and Windows the batch is one platform call and the window
+  /// repaints once, after the last operation, so no intermediate state is
+  /// ever shown. Every operation is checked first; if any cannot be
+  /// applied, none is and this returns `false`. A [PipScrollOperation] has
+  /// no effect on Windows. Elsewhere the operations are applied one by one
+  /// and `false` means one of them failed. Throws a [RangeError] for a
+  /// [PipReplaceRangeOperation] with an invalid range before anything is
+  /// applied.
+  Future<bool> applyBatch(List<PipOperation> operations) {
+    _ensureNotDisposed();
+    for (final operation in operations.whereType<PipReplaceRangeOperation>()) {
+      PipReplaceRangeOperation.checkRange(operation.start, operation.end);
+    }
+    return PipPluginPlatform.instance.applyBatch(operations);
+  }
+
+  /// Update counters of the PiP window on Linux and Windows, `null`
+  /// elsewhere or before [setupPip].
+  ///
+  /// Both platforms keep only the newest pending state and render it once
+  /// per display refresh; [PipStats.superseded] tells how many updates
+  /// never reached the screen on their own.
+  Future<PipStats?> getStats() {
+    _ensureNotDisposed();
+    return PipPluginPlatform.instance.getStats();
+  }
+
+  /// Shows a stopwatch, or with [countdown] a timer counting down from
+  /// [start], instead of the text on Linux and Windows. Returns `false`
+  /// elsewhere.
+  ///
+  /// The clock is advanced natively on every frame from a monotonic clock,
+  /// so it neither drifts nor needs an update per tick from Dart. [format]
+  /// is made of runs of `h`, `m` and `s`, and `S` for fractions of a
+  /// second, e.g. `'hh:mm:ss.SS'`. A countdown stops at zero.
+  Future<bool> startClock({
+    bool countdown = false,
+    Duration start = Duration.zero,
+    String format = 'mm:ss',
+  }) {
+    _ensureNotDisposed();
+    return PipPluginPlatform.instance
+        .startClock(countdown: countdown, start: start, format: format);
+  }
+
+  /// Stops the clock and shows the text again. Returns `false` if no clock
+  /// was running.
+  Future<bool> stopClock() {
+    _ensureNotDisposed();
+    return PipPluginPlatform.instance.stopClock();
+  }
+
+  /// Loads timed lines, given as [cues] or read from the SRT, WebVTT or
+  /// LRC file at [path], and with [play] starts playing them. Linux and
+  /// Windows only; returns `false` elsewhere, when the file cannot be read
+  /// or when there is no cue.
+  ///
+  /// The native side switches the text to each cue on the frame it is due,
+  /// against a monotonic clock, so no call crosses the platform channel
+  /// during playback. Between cues the text is empty.
+  Future<bool> loadCueTrack({
+    List<PipCue>? cues,
+    String? path,
+    bool play = true,
+  }) {
+    _ensureNotDisposed();
+    return PipPluginPlatform.instance
+        .loadCueTrack(cues: cues, path: path, play: play);
+  }
+
+  /// Plays or pauses the cue track, seeks it to [position] and sets its
+  /// playback [rate] (1 is real time). Omitted values are kept.
+  Future<bool> controlCueTrack({
+    bool? playing,
+    Duration? position,
+    double? rate,
+  }) {
+    _ensureNotDisposed();
+    return PipPluginPlatform.instance
+        .controlCueTrack(playing: playing, position: position, rate: rate);
+  }
+
+  /// Stops the cue track and clears the text.
+  Future<bool> unloadCueTrack() {
+    _ensureNotDisposed();
+    return PipPluginPlatform.instance.unloadCueTrack();
+  }
+
+  /// Shows the last [maxLines] lines of the growing file at [path], like
+  /// `tail -f`. Linux and Windows watch the file natively and only lay out
+  /// the lines appended to it; Dart is not involved after this call. A
+  /// truncated or replaced file is followed from its start. Setting the text
+  /// otherwise while tailing shows it only until the file grows. Returns
+  /// `false` if the file cannot be opened or watched.
+  Future<bool> tailFile(String path, {int maxLines = 200}) {
+    _ensureNotDisposed();
+    return PipPluginPlatform.instance.tailFile(path, maxLines: maxLines);
+  }
+
+  /// Stops following the file of [tailFile]; the text shown stays.
+  Future<bool> stopTail() {
+    _ensureNotDisposed();
+    return PipPluginPlatform.instance.stopTail();
+  }
+
+  /// Shows the text frames another process writes, without passing them
+  /// through Dart: PiP listens on the Unix domain socket at [path] on Linux,
+  /// or serves the named pipe [path] (`\\.\pipe\` is prepended to a bare
+  /// name) on Windows. Frames are lines, or with [lengthPrefixed] preceded by
+  /// their length in bytes as a 32-bit big-endian integer. Only the newest
+  /// frame is shown each display refresh. One writer is read at a time.
+  /// Returns `false` if the socket or pipe cannot be created.
+  Future<bool> openSource(String path, {bool lengthPrefixed = false}) {
+    _ensureNotDisposed();
+    return PipPluginPlatform.instance
+        .openSource(path, lengthPrefixed: lengthPrefixed);
+  }
+
+  /// Closes the source of [openSource]; the text shown stays.
+  Future<bool> closeSource() {
+    _ensureNotDisposed();
+    return PipPluginPlatform.instance.closeSource();
+  }
+
+  /// Animates the style to the given targets on Linux and Windows,
+  /// interpolated natively on every display refresh over [duration] along
+  /// [curve]. Colors include their alpha. The animation runs [repeat]
+  /// times, or until the style is changed for `0`; with [reverse] every
+  /// other run goes back, as for a pulse. A new animation or [updatePip]
+  /// starts from the values shown at that moment. Throws an [ArgumentError]
+  /// if [repeat] is negative.
+  Future<bool> animate({
+    Color? backgroundColor,
+    Color? textColor,
+    double? textSize,
+    required Duration duration,
+    PipCurve curve = PipCurve.easeInOut,
+    int repeat = 1,
+    bool reverse = false,
+  }) {
+    _ensureNotDisposed();
+    if (repeat < 0) {
+      throw ArgumentError.value(repeat, 'repeat', 'must not be negative');
+    }
+    return PipPluginPlatform.instance.animate(
+      backgroundColor: backgroundColor,
+      textColor: textColor,
+      textSize: textSize,
+      duration: duration,
+      curve: curve,
+      repeat: repeat,
+      reverse: reverse,
+    );
+  }
+
+  /// Sizes the text on Linux and Windows to the largest size in [minSize]
+  /// to [maxSize] pixels at which it fits the window, wrapped as it is
+  /// drawn, fitted again whenever the text or the window size changes.
+  /// While the window is being resized the size is kept until the drag
+  /// ends, and a file shown by [loadTextFile] keeps the size it got. With
+  /// [enabled] `false` the text size from before is shown again. Returns
+  /// `false` unless `1 <= minSize <= maxSize`.
+  Future<bool> autoFit({
+    bool enabled = true,
+    double minSize = 8,
+    double maxSize = 512,
+  }) {
+    _ensureNotDisposed();
+    return PipPluginPlatform.instance
+        .autoFit(enabled: enabled, minSize: minSize, maxSize: maxSize);
+  }
+
+  /// Opens an additional PiP window on Linux and Windows; `null` elsewhere
+  /// or before [setupPip].
+  ///
+  /// The window is controlled through the returned handle, while the
+  /// methods of this class keep acting on the window of [setupPip]. All
+  /// windows share fonts and, on Windows, the Direct2D device.
+  Future<PipWindow?> createWindow({
+    String? windowTitle,
+    PipConfiguration? configuration,
+  }) {
+    _ensureNotDisposed();
+    return PipPluginPlatform.instance.createWindow(
+      windowTitle: windowTitle,
+      configuration: configuration,
+    );
+  }
+
   /// Controls the automatic scrolling of the text in the PiP window.
   ///
-  /// This is currently only supported on iOS.
+  /// This is currently supported on iOS and Linux. On Linux the first call
+  /// switches the window to a top-aligned teleprompter layout; [speed] is in
+  /// logical pixels per second. Only the paragraphs around the visible part
+  /// are laid out and drawn, so scripts of megabytes scroll as smoothly as
+  /// short ones.
   Future<void> controlScroll({
     required bool isScrolling,
     double? speed,
@@ -0,0 +1,40 @@
+/// Update counters of the native PiP window, see [PipPlugin.getStats].
+class PipStats {
+  /// Updates received: text and style calls, batches, and `PipFfi` and
+  /// `PipTextRing` writes.
+  final int updates;
+
+  /// Updates merged into a frame together with a newer one. Their own
+  /// state was never rendered, so a producer sending much more often than
+  /// [frames] grows can lower its rate without visible difference.
+  final int superseded;
+
+  /// Repaints actually rendered.
+  final int frames;
+
+  /// Time from the last [PipPlugin.startPip] showing the window to its
+  /// first frame, `null` until measured.
+  final Duration? firstFrame;
+
+  const PipStats({
+    required this.updates,
+    required this.superseded,
+    required this.frames,
+    this.firstFrame,
+  });
+
+  factory PipStats.fromMap(Map<Object?, Object?> map) => PipStats(
+        updates: map['updates'] as int? ?? 0,
+        superseded: map['superseded'] as int? ?? 0,
+        frames: map['frames'] as int? ?? 0,
+        firstFrame: switch (map['firstFrameUs']) {
+          final int us => Duration(microseconds: us),
+          _ => null,
+        },
+      );
+
+  @override
+  String toString() =>
+      'PipStats(updates: $updates, superseded: $superseded, frames: $frames, '
+      'firstFrame: $firstFrame)';
+}
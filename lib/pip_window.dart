@@ -0,0 +1,95 @@
+import 'dart:ui';
+
+import 'package:pip_plugin/pip_configuration.dart';
+import 'package:pip_plugin/pip_cue.dart';
+import 'package:pip_plugin/pip_curve.dart';
+import 'package:pip_plugin/pip_operation.dart';
+import 'package:pip_plugin/pip_stats.dart';
+
+/// An additional PiP window, created with [PipPlugin.createWindow].
+///
+/// Each window has its own text, style and visibility. The [PipPlugin]
+/// methods keep acting on the window created by [PipPlugin.setupPip]; the
+/// FFI fast path also targets that one.
+abstract class PipWindow {
+  /// Identifies the window on the native side.
+  int get id;
+
+  PipConfiguration get configuration;
+
+  /// Emits `true` when the window is shown and `false` when it is stopped
+  /// or closed by the user.
+  Stream<bool> get activeStream;
+
+  Future<bool> start();
+  Future<bool> stop();
+
+  /// Closes the window for good. The handle cannot be used afterwards.
+  Future<bool> destroy();
+
+  Future<bool> update(PipConfiguration configuration);
+  Future<bool> updateText(String text);
+  Future<bool> appendText(String text);
+  Future<bool> replaceRange(int start, int end, String text);
+  Future<bool> clearText();
+
+  /// Shows the UTF-8 file at [path], see [PipPlugin.loadTextFile].
+  Future<bool> loadTextFile(String path);
+
+  /// Applies [operations] with a single repaint, see [PipPlugin.applyBatch].
+  Future<bool> applyBatch(List<PipOperation> operations);
+
+  Future<PipStats?> getStats();
+
+  /// Shows a clock instead of the text, see [PipPlugin.startClock].
+  Future<bool> startClock({
+    bool countdown = false,
+    Duration start = Duration.zero,
+    String format = 'mm:ss',
+  });
+
+  Future<bool> stopClock();
+
+  /// Plays timed lines natively, see [PipPlugin.loadCueTrack].
+  Future<bool> loadCueTrack({
+    List<PipCue>? cues,
+    String? path,
+    bool play = true,
+  });
+
+  Future<bool> controlCueTrack({
+    bool? playing,
+    Duration? position,
+    double? rate,
+  });
+
+  Future<bool> unloadCueTrack();
+
+  /// Follows a growing file natively, see [PipPlugin.tailFile].
+  Future<bool> tailFile(String path, {int maxLines = 200});
+
+  Future<bool> stopTail();
+
+  /// Shows frames written by another process, see [PipPlugin.openSource].
+  Future<bool> openSource(String path, {bool lengthPrefixed = false});
+
+  Future<bool> closeSource();
+
+  /// Animates the style natively, see [PipPlugin.animate].
+  Future<bool> animate({
+    Color? backgroundColor,
+    Color? textColor,
+    double? textSize,
+    required Duration duration,
+    PipCurve curve = PipCurve.easeInOut,
+    int repeat = 1,
+    bool reverse = false,
+  });
+
+  /// Sizes the text to fit the window, see [PipPlugin.autoFit].
+  Future<bool> autoFit({
+    bool enabled = true,
+    double minSize = 8,
+    double maxSize = 512,
+  });
+}
@@ -1,6 +1,12 @@
 import 'dart:async';
+import 'dart:ui';
 
 import 'package:pip_plugin/pip_configuration.dart';
+import 'package:pip_plugin/pip_cue.dart';
+import 'package:pip_plugin/pip_curve.dart';
+import 'package:pip_plugin/pip_operation.dart';
+import 'package:pip_plugin/pip_stats.dart';
+import 'package:pip_plugin/pip_window.dart';
 import 'package:pip_plugin/src/contracts/pip_plugin_platform_interface.dart';
 import 'package:simple_pip_mode/actions/pip_action.dart';
 
@@ -40,12 +46,129 @@ abstract class BasePipPlugin extends PipPluginPlatform {
   Future<bool> setupPip({
     String? windowTitle,
     PipConfiguration? configuration,
+    bool prewarm = false,
   }) async {
-    return performSetup(windowTitle, configuration);
+    return performSetup(windowTitle, configuration, prewarm: prewarm);
   }
 
   Future<bool> performSetup(
-      String? windowTitle, PipConfiguration? configuration);
+      String? windowTitle, PipConfiguration? configuration,
+      {bool prewarm = false});
+
+  /// Applies [operations] one after another. Platforms that can apply a
+  /// batch natively override this.
+  @override
+  Future<bool> applyBatch(List<PipOperation> operations) async {
+    var success = true;
+    for (final operation in operations) {
+      success = await applyOperation(operation) && success;
+    }
+    return success;
+  }
+
+  Future<bool> applyOperation(PipOperation operation) async {
+    switch (operation) {
+      case PipStyleOperation():
+        return update(operation.applyTo(configuration));
+      case PipSetTextOperation(:final text):
+        return updateText(text);
+      case PipAppendTextOperation(:final text):
+        return appendText(text);
+      case PipReplaceRangeOperation(:final start, :final end, :final text):
+        return replaceRange(start, end, text);
+      case PipClearTextOperation():
+        return clearText();
+      case PipScrollOperation(:final isScrolling, :final speed):
+        await controlScroll(isScrolling: isScrolling, speed: speed);
+        return true;
+      case PipVisibilityOperation(:final visible):
+        return visible ? startPip() : stopPip();
+    }
+  }
+
+  /// Only the desktop platforms read files for the text.
+  @override
+  Future<bool> loadTextFile(String path) async => false;
+
+  /// Platforms without a native update coalescer have no stats.
+  @override
+  Future<PipStats?> getStats() async => null;
+
+  /// Platforms without a native frame clock have no clock mode.
+  @override
+  Future<bool> startClock({
+    bool countdown = false,
+    Duration start = Duration.zero,
+    String format = 'mm:ss',
+  }) async =>
+      false;
+
+  @override
+  Future<bool> stopClock() async => false;
+
+  /// Platforms without a native frame clock cannot play cue tracks.
+  @override
+  Future<bool> loadCueTrack({
+    List<PipCue>? cues,
+    String? path,
+    bool play = true,
+  }) async =>
+      false;
+
+  @override
+  Future<bool> controlCueTrack({
+    bool? playing,
+    Duration? position,
+    double? rate,
+  }) async =>
+      false;
+
+  @override
+  Future<bool> unloadCueTrack() async => false;
+
+  /// Only the desktop platforms follow files natively.
+  @override
+  Future<bool> tailFile(String path, {int maxLines = 200}) async => false;
+
+  @override
+  Future<bool> stopTail() async => false;
+
+  /// Only the desktop platforms read sockets and pipes natively.
+  @override
+  Future<bool> openSource(String path, {bool lengthPrefixed = false}) async =>
+      false;
+
+  @override
+  Future<bool> closeSource() async => false;
+
+  /// Only the desktop platforms animate the style natively.
+  @override
+  Future<bool> animate({
+    Color? backgroundColor,
+    Color? textColor,
+    double? textSize,
+    required Duration duration,
+    PipCurve curve = PipCurve.easeInOut,
+    int repeat = 1,
+    bool reverse = false,
+  }) async =>
+      false;
+
+  @override
+  Future<bool> autoFit({
+    bool enabled = true,
+    double minSize = 8,
+    double maxSize = 512,
+  }) async =>
+      false;
+
+  /// Platforms with a single PiP window cannot create more.
+  @override
+  Future<PipWindow?> createWindow({
+    String? windowTitle,
+    PipConfiguration? configuration,
+  }) async =>
+      null;
 
   @override
   void dispose() {
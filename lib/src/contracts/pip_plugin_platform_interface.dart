@@ -1,6 +1,12 @@
 import 'dart:io';
+import 'dart:ui';
 
 import 'package:pip_plugin/pip_configuration.dart';
+import 'package:pip_plugin/pip_cue.dart';
+import 'package:pip_plugin/pip_curve.dart';
+import 'package:pip_plugin/pip_operation.dart';
+import 'package:pip_plugin/pip_stats.dart';
+import 'package:pip_plugin/pip_window.dart';
 import 'package:pip_plugin/src/pip_plugin_android.dart';
 import 'package:plugin_platform_interface/plugin_platform_interface.dart';
 import 'package:simple_pip_mode/actions/pip_action.dart';
@@ -32,6 +38,7 @@ abstract class PipPluginPlatform extends PlatformInterface {
   Future<bool> setupPip({
     String? windowTitle,
     PipConfiguration? configuration,
+    bool prewarm = false,
   });
 
   Future<bool> isPipSupported();
@@ -41,6 +48,66 @@ abstract class PipPluginPlatform extends PlatformInterface {
 
   Future<bool> update(PipConfiguration configuration);
   Future<bool> updateText(String text);
+  Future<bool> appendText(String text);
+  Future<bool> replaceRange(int start, int end, String text);
+  Future<bool> clearText();
+
+  Future<bool> applyBatch(List<PipOperation> operations);
+
+  Future<bool> loadTextFile(String path);
+
+  Future<PipStats?> getStats();
+
+  Future<bool> startClock({
+    bool countdown = false,
+    Duration start = Duration.zero,
+    String format = 'mm:ss',
+  });
+
+  Future<bool> stopClock();
+
+  Future<bool> loadCueTrack({
+    List<PipCue>? cues,
+    String? path,
+    bool play = true,
+  });
+
+  Future<bool> controlCueTrack({
+    bool? playing,
+    Duration? position,
+    double? rate,
+  });
+
+  Future<bool> unloadCueTrack();
+
+  Future<bool> tailFile(String path, {int maxLines = 200});
+
+  Future<bool> stopTail();
+
+  Future<bool> openSource(String path, {bool lengthPrefixed = false});
+
+  Future<bool> closeSource();
+
+  Future<bool> animate({
+    Color? backgroundColor,
+    Color? textColor,
+    double? textSize,
+    required Duration duration,
+    PipCurve curve = PipCurve.easeInOut,
+    int repeat = 1,
+    bool reverse = false,
+  });
+
+  Future<bool> autoFit({
+    bool enabled = true,
+    double minSize = 8,
+    double maxSize = 512,
+  });
+
+  Future<PipWindow?> createWindow({
+    String? windowTitle,
+    PipConfiguration? configuration,
+  });
 
   Future<void> controlScroll({
     required bool isScrolling,
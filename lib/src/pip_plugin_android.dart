@@ -1,6 +1,7 @@
 import 'package:flutter/foundation.dart';
 import 'package:flutter/material.dart';
 import 'package:pip_plugin/pip_configuration.dart';
+import 'package:pip_plugin/pip_operation.dart';
 import 'package:pip_plugin/src/contracts/base_pip_plugin.dart';
 import 'package:simple_pip_mode/simple_pip.dart';
 
@@ -27,7 +28,8 @@ class PipPluginAndroid extends BasePipPlugin {
 
   @override
   Future<bool> performSetup(
-      String? windowTitle, PipConfiguration? configuration) async {
+      String? windowTitle, PipConfiguration? configuration,
+      {bool prewarm = false}) async {
     try {
       _configuration = ValueNotifier(configuration ?? PipConfiguration.initial);
       text = ValueNotifier('');
@@ -93,6 +95,34 @@ class PipPluginAndroid extends BasePipPlugin {
     }
   }
 
+  @override
+  Future<bool> appendText(String text) async {
+    checkInitialized();
+    try {
+      this.text.value += text;
+      return true;
+    } catch (e, st) {
+      debugPrint('PipPluginAndroid.appendText error: $e\n$st');
+      return false;
+    }
+  }
+
+  @override
+  Future<bool> replaceRange(int start, int end, String text) async {
+    checkInitialized();
+    try {
+      this.text.value = PipReplaceRangeOperation.applyTo(
+          this.text.value, start, end, text);
+      return true;
+    } catch (e, st) {
+      debugPrint('PipPluginAndroid.replaceRange error: $e\n$st');
+      return false;
+    }
+  }
+
+  @override
+  Future<bool> clearText() => updateText('');
+
   @override
   Future<void> controlScroll({
     required bool isScrolling,
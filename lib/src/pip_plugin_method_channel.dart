@@ -1,9 +1,15 @@
 import 'dart:async';
 import 'dart:developer';
+import 'dart:io';
 
 import 'package:flutter/material.dart';
 import 'package:flutter/services.dart';
 import 'package:pip_plugin/pip_configuration.dart';
+import 'package:pip_plugin/pip_cue.dart';
+import 'package:pip_plugin/pip_curve.dart';
+import 'package:pip_plugin/pip_operation.dart';
+import 'package:pip_plugin/pip_stats.dart';
+import 'package:pip_plugin/pip_window.dart';
 import 'package:pip_plugin/src/contracts/base_pip_plugin.dart';
 
 class LoggedMethodChannel extends MethodChannel {
@@ -20,29 +26,56 @@ class MethodChannelPipPlugin extends BasePipPlugin {
   final MethodChannel methodChannel = const LoggedMethodChannel('pip_plugin');
   late PipConfiguration _configuration;
 
+  /// Linux and Windows edit their text and apply batches natively.
+  /// Elsewhere text edits are applied to [_text] and the result is sent with
+  /// `updateText`, and batches are sent one operation at a time.
+  static final bool _isLinuxOrWindows = Platform.isLinux || Platform.isWindows;
+  String _text = '';
+
+  /// Windows opened with [createWindow], by native id. Calls without an id
+  /// act on the window of [setupPip].
+  final Map<int, _MethodChannelPipWindow> _windows = {};
+
   @override
   PipConfiguration get configuration => _configuration;
 
   List<int> _colorToIntList(Color color) =>
       [color.red, color.green, color.blue, color.alpha];
 
+  Map<String, Object?> _configurationArgs(PipConfiguration configuration) => {
+        'backgroundColor': _colorToIntList(configuration.backgroundColor),
+        'textColor': _colorToIntList(configuration.textColor),
+        'textSize': configuration.textSize,
+        'ratio': [configuration.ratio.$1, configuration.ratio.$2],
+        'textAlign': configuration.textAlign.name,
+        'speed': configuration.speed,
+      };
+
+  Map<String, Object?> _setupArgs(
+          String? windowTitle, PipConfiguration configuration) =>
+      {
+        'windowTitle': windowTitle,
+        'ratio': [configuration.ratio.$1, configuration.ratio.$2],
+        'backgroundColor': _colorToIntList(configuration.backgroundColor),
+        'textColor': _colorToIntList(configuration.textColor),
+        'textSize': configuration.textSize,
+        'textAlign': configuration.textAlign.name,
+      };
+
   @override
   Future<bool> performSetup(
-      String? windowTitle, PipConfiguration? configuration) async {
+      String? windowTitle, PipConfiguration? configuration,
+      {bool prewarm = false}) async {
     try {
       _configuration = configuration ?? PipConfiguration.initial;
-      final args = {
-        'windowTitle': windowTitle,
-        'ratio': [_configuration.ratio.$1, _configuration.ratio.$2],
-        'backgroundColor': _colorToIntList(_configuration.backgroundColor),
-        'textColor': _colorToIntList(_configuration.textColor),
-        'textSize': _configuration.textSize,
-        'textAlign': _configuration.textAlign.name,
-      };
-      final result = await methodChannel.invokeMethod<bool>('setupPip', args);
+      // Linux and Windows answer with the id of the window.
+      final result = await methodChannel.invokeMethod<Object>('setupPip', {
+        ..._setupArgs(windowTitle, _configuration),
+        if (prewarm) 'prewarm': true,
+      });
       methodChannel.setMethodCallHandler(_handleMethodCall);
       markInitialized();
-      return result ?? false;
+      return result == true || result is int;
     } catch (e, st) {
       debugPrint('MethodChannelPipPlugin.performSetup error: $e\n$st');
       return false;
@@ -51,7 +84,35 @@ class MethodChannelPipPlugin extends BasePipPlugin {
 
   Future<void> _handleMethodCall(MethodCall call) async {
     if (call.method == 'pipStopped') {
-      handlePipExited();
+      final arguments = call.arguments;
+      final window = arguments is Map ? _windows[arguments['id']] : null;
+      if (window != null) {
+        window._handleStopped();
+      } else {
+        handlePipExited();
+      }
+    }
+  }
+
+  @override
+  Future<PipWindow?> createWindow({
+    String? windowTitle,
+    PipConfiguration? configuration,
+  }) async {
+    checkInitialized();
+    if (!_isLinuxOrWindows) return null;
+    try {
+      final windowConfiguration = configuration ?? PipConfiguration.initial;
+      final id = await methodChannel.invokeMethod<int>('setupPip', {
+        ..._setupArgs(windowTitle, windowConfiguration),
+        'newWindow': true,
+      });
+      if (id == null) return null;
+      return _windows[id] =
+          _MethodChannelPipWindow(this, id, windowConfiguration);
+    } catch (e, st) {
+      debugPrint('MethodChannelPipPlugin.createWindow error: $e\n$st');
+      return null;
     }
   }
 
@@ -110,16 +171,9 @@ class MethodChannelPipPlugin extends BasePipPlugin {
   Future<bool> update(PipConfiguration configuration) async {
     checkInitialized();
     try {
-      final args = {
-        'backgroundColor': _colorToIntList(configuration.backgroundColor),
-        'textColor': _colorToIntList(configuration.textColor),
-        'textSize': configuration.textSize,
-        'ratio': [configuration.ratio.$1, configuration.ratio.$2],
-        'textAlign': configuration.textAlign.name,
-        'speed': configuration.speed,
-      };
-      final success =
-          await methodChannel.invokeMethod<bool>('updatePip', args) ?? false;
+      final success = await methodChannel.invokeMethod<bool>(
+              'updatePip', _configurationArgs(configuration)) ??
+          false;
       if (success) _configuration = configuration;
       return success;
     } catch (e, st) {
@@ -132,15 +186,406 @@ class MethodChannelPipPlugin extends BasePipPlugin {
   Future<bool> updateText(String text) async {
     checkInitialized();
     try {
-      return await methodChannel
+      final success = await methodChannel
               .invokeMethod<bool>('updateText', {'text': text}) ??
           false;
+      if (success && !_isLinuxOrWindows) _text = text;
+      return success;
     } catch (e, st) {
       debugPrint('MethodChannelPipPlugin.updateText error: $e\n$st');
       return false;
     }
   }
 
+  @override
+  Future<bool> appendText(String text) async {
+    checkInitialized();
+    if (!_isLinuxOrWindows) return updateText(_text + text);
+    try {
+      return await methodChannel
+              .invokeMethod<bool>('appendText', {'text': text}) ??
+          false;
+    } catch (e, st) {
+      debugPrint('MethodChannelPipPlugin.appendText error: $e\n$st');
+      return false;
+    }
+  }
+
+  @override
+  Future<bool> replaceRange(int start, int end, String text) async {
+    checkInitialized();
+    if (!_isLinuxOrWindows) {
+      return updateText(
+          PipReplaceRangeOperation.applyTo(_text, start, end, text));
+    }
+    try {
+      return await methodChannel.invokeMethod<bool>('replaceRange', {
+            'start': start,
+            'end': end,
+            'text': text,
+          }) ??
+          false;
+    } catch (e, st) {
+      debugPrint('MethodChannelPipPlugin.replaceRange error: $e\n$st');
+      return false;
+    }
+  }
+
+  @override
+  Future<bool> clearText() async {
+    checkInitialized();
+    if (!_isLinuxOrWindows) return updateText('');
+    try {
+      return await methodChannel.invokeMethod<bool>('clearText') ?? false;
+    } catch (e, st) {
+      debugPrint('MethodChannelPipPlugin.clearText error: $e\n$st');
+      return false;
+    }
+  }
+
+  Map<String, Object?> _batchCall(
+      PipOperation operation, PipConfiguration configuration) {
+    return switch (operation) {
+      PipStyleOperation() => {
+          'method': 'updatePip',
+          'args': _configurationArgs(configuration),
+        },
+      PipSetTextOperation(:final text) => {
+          'method': 'updateText',
+          'args': {'text': text},
+        },
+      PipAppendTextOperation(:final text) => {
+          'method': 'appendText',
+          'args': {'text': text},
+        },
+      PipReplaceRangeOperation(:final start, :final end, :final text) => {
+          'method': 'replaceRange',
+          'args': {'start': start, 'end': end, 'text': text},
+        },
+      PipClearTextOperation() => {'method': 'clearText'},
+      PipScrollOperation(:final isScrolling, :final speed) => {
+          'method': 'controlScroll',
+          'args': {'isScrolling': isScrolling, 'speed': speed},
+        },
+      PipVisibilityOperation(:final visible) => {
+          'method': visible ? 'startPip' : 'stopPip',
+        },
+    };
+  }
+
+  /// The platform calls of [operations] and the configuration they leave
+  /// behind, starting from [configuration].
+  (List<Map<String, Object?>>, PipConfiguration) _batchCalls(
+      List<PipOperation> operations, PipConfiguration configuration) {
+    final calls = <Map<String, Object?>>[];
+    for (final operation in operations) {
+      if (operation is PipStyleOperation) {
+        configuration = operation.applyTo(configuration);
+      }
+      calls.add(_batchCall(operation, configuration));
+    }
+    return (calls, configuration);
+  }
+
+  @override
+  Future<bool> loadTextFile(String path) async {
+    checkInitialized();
+    try {
+      if (!_isLinuxOrWindows) {
+        return updateText(await File(path).readAsString());
+      }
+      return await methodChannel
+              .invokeMethod<bool>('loadTextFile', {'path': path}) ??
+          false;
+    } catch (e, st) {
+      debugPrint('MethodChannelPipPlugin.loadTextFile error: $e\n$st');
+      return false;
+    }
+  }
+
+  @override
+  Future<bool> applyBatch(List<PipOperation> operations) async {
+    checkInitialized();
+    if (!_isLinuxOrWindows) return super.applyBatch(operations);
+    try {
+      // The whole batch is one platform call, applied natively with a
+      // single repaint or, on failure, not at all, so the configuration
+      // only changes on success.
+      final (calls, configuration) = _batchCalls(operations, _configuration);
+      final success =
+          await methodChannel.invokeMethod<bool>('applyBatch', calls) ??
+              false;
+      if (success) {
+        _configuration = configuration;
+        final visibility =
+            operations.whereType<PipVisibilityOperation>().lastOrNull;
+        if (visibility != null) {
+          visibility.visible ? handlePipEntered() : handlePipExited();
+        }
+      }
+      return success;
+    } catch (e, st) {
+      debugPrint('MethodChannelPipPlugin.applyBatch error: $e\n$st');
+      return false;
+    }
+  }
+
+  @override
+  Future<PipStats?> getStats() async {
+    if (!_isLinuxOrWindows) return null;
+    try {
+      final stats = await methodChannel
+          .invokeMethod<Map<Object?, Object?>>('getStats');
+      return stats == null ? null : PipStats.fromMap(stats);
+    } catch (e, st) {
+      debugPrint('MethodChannelPipPlugin.getStats error: $e\n$st');
+      return null;
+    }
+  }
+
+  Map<String, Object?> _clockArgs(
+          bool countdown, Duration start, String format) =>
+      {
+        'countdown': countdown,
+        'startMs': start.inMilliseconds,
+        'format': format,
+      };
+
+  @override
+  Future<bool> startClock({
+    bool countdown = false,
+    Duration start = Duration.zero,
+    String format = 'mm:ss',
+  }) async {
+    checkInitialized();
+    if (!_isLinuxOrWindows) return false;
+    try {
+      return await methodChannel.invokeMethod<bool>(
+              'startClock', _clockArgs(countdown, start, format)) ??
+          false;
+    } catch (e, st) {
+      debugPrint('MethodChannelPipPlugin.startClock error: $e\n$st');
+      return false;
+    }
+  }
+
+  @override
+  Future<bool> stopClock() async {
+    checkInitialized();
+    if (!_isLinuxOrWindows) return false;
+    try {
+      return await methodChannel.invokeMethod<bool>('stopClock') ?? false;
+    } catch (e, st) {
+      debugPrint('MethodChannelPipPlugin.stopClock error: $e\n$st');
+      return false;
+    }
+  }
+
+  Map<String, Object?> _cueTrackArgs(
+          List<PipCue>? cues, String? path, bool play) =>
+      {
+        if (path != null) 'path': path,
+        if (cues != null) 'cues': [for (final cue in cues) cue.toMap()],
+        'play': play,
+      };
+
+  Map<String, Object?> _animateArgs(
+          Color? backgroundColor,
+          Color? textColor,
+          double? textSize,
+          Duration duration,
+          PipCurve curve,
+          int repeat,
+          bool reverse) =>
+      {
+        if (backgroundColor != null)
+          'backgroundColor': _colorToIntList(backgroundColor),
+        if (textColor != null) 'textColor': _colorToIntList(textColor),
+        if (textSize != null) 'textSize': textSize,
+        'durationMs': duration.inMilliseconds,
+        'curve': curve.name,
+        'repeat': repeat,
+        'reverse': reverse,
+      };
+
+  /// The configuration once an animation has ended: at its targets, unless
+  /// it runs forever or ends back where it started.
+  static PipConfiguration _animatedConfiguration(
+      PipConfiguration configuration,
+      Color? backgroundColor,
+      Color? textColor,
+      double? textSize,
+      int repeat,
+      bool reverse) {
+    if (repeat <= 0 || (reverse && repeat.isEven)) return configuration;
+    return configuration.copyWith(
+      backgroundColor: backgroundColor,
+      textColor: textColor,
+      textSize: textSize,
+    );
+  }
+
+  Map<String, Object?> _cueControlArgs(
+          bool? playing, Duration? position, double? rate) =>
+      {
+        if (playing != null) 'playing': playing,
+        if (position != null) 'positionMs': position.inMilliseconds,
+        if (rate != null) 'rate': rate,
+      };
+
+  @override
+  Future<bool> loadCueTrack({
+    List<PipCue>? cues,
+    String? path,
+    bool play = true,
+  }) async {
+    checkInitialized();
+    if (!_isLinuxOrWindows) return false;
+    try {
+      return await methodChannel.invokeMethod<bool>(
+              'loadCueTrack', _cueTrackArgs(cues, path, play)) ??
+          false;
+    } catch (e, st) {
+      debugPrint('MethodChannelPipPlugin.loadCueTrack error: $e\n$st');
+      return false;
+    }
+  }
+
+  @override
+  Future<bool> controlCueTrack({
+    bool? playing,
+    Duration? position,
+    double? rate,
+  }) async {
+    checkInitialized();
+    if (!_isLinuxOrWindows) return false;
+    try {
+      return await methodChannel.invokeMethod<bool>('controlCueTrack',
+              _cueControlArgs(playing, position, rate)) ??
+          false;
+    } catch (e, st) {
+      debugPrint('MethodChannelPipPlugin.controlCueTrack error: $e\n$st');
+      return false;
+    }
+  }
+
+  @override
+  Future<bool> unloadCueTrack() async {
+    checkInitialized();
+    if (!_isLinuxOrWindows) return false;
+    try {
+      return await methodChannel.invokeMethod<bool>('unloadCueTrack') ??
+          false;
+    } catch (e, st) {
+      debugPrint('MethodChannelPipPlugin.unloadCueTrack error: $e\n$st');
+      return false;
+    }
+  }
+
+  @override
+  Future<bool> tailFile(String path, {int maxLines = 200}) async {
+    checkInitialized();
+    if (!_isLinuxOrWindows) return false;
+    try {
+      return await methodChannel.invokeMethod<bool>(
+              'tailFile', {'path': path, 'maxLines': maxLines}) ??
+          false;
+    } catch (e, st) {
+      debugPrint('MethodChannelPipPlugin.tailFile error: $e\n$st');
+      return false;
+    }
+  }
+
+  @override
+  Future<bool> stopTail() async {
+    checkInitialized();
+    if (!_isLinuxOrWindows) return false;
+    try {
+      return await methodChannel.invokeMethod<bool>('stopTail') ?? false;
+    } catch (e, st) {
+      debugPrint('MethodChannelPipPlugin.stopTail error: $e\n$st');
+      return false;
+    }
+  }
+
+  @override
+  Future<bool> openSource(String path, {bool lengthPrefixed = false}) async {
+    checkInitialized();
+    if (!_isLinuxOrWindows) return false;
+    try {
+      return await methodChannel.invokeMethod<bool>('openSource', {
+            'path': path,
+            'lengthPrefixed': lengthPrefixed,
+          }) ??
+          false;
+    } catch (e, st) {
+      debugPrint('MethodChannelPipPlugin.openSource error: $e\n$st');
+      return false;
+    }
+  }
+
+  @override
+  Future<bool> closeSource() async {
+    checkInitialized();
+    if (!_isLinuxOrWindows) return false;
+    try {
+      return await methodChannel.invokeMethod<bool>('closeSource') ?? false;
+    } catch (e, st) {
+      debugPrint('MethodChannelPipPlugin.closeSource error: $e\n$st');
+      return false;
+    }
+  }
+
+  @override
+  Future<bool> animate({
+    Color? backgroundColor,
+    Color? textColor,
+    double? textSize,
+    required Duration duration,
+    PipCurve curve = PipCurve.easeInOut,
+    int repeat = 1,
+    bool reverse = false,
+  }) async {
+    checkInitialized();
+    if (!_isLinuxOrWindows) return false;
+    try {
+      final success = await methodChannel.invokeMethod<bool>(
+              'animate',
+              _animateArgs(backgroundColor, textColor, textSize, duration,
+                  curve, repeat, reverse)) ??
+          false;
+      if (success) {
+        _configuration = _animatedConfiguration(_configuration,
+            backgroundColor, textColor, textSize, repeat, reverse);
+      }
+      return success;
+    } catch (e, st) {
+      debugPrint('MethodChannelPipPlugin.animate error: $e\n$st');
+      return false;
+    }
+  }
+
+  @override
+  Future<bool> autoFit({
+    bool enabled = true,
+    double minSize = 8,
+    double maxSize = 512,
+  }) async {
+    checkInitialized();
+    if (!_isLinuxOrWindows) return false;
+    try {
+      return await methodChannel.invokeMethod<bool>('autoFit', {
+            'enabled': enabled,
+            'minSize': minSize,
+            'maxSize': maxSize,
+          }) ??
+          false;
+    } catch (e, st) {
+      debugPrint('MethodChannelPipPlugin.autoFit error: $e\n$st');
+      return false;
+    }
+  }
+
   @override
   Future<void> controlScroll({
     required bool isScrolling,
@@ -159,7 +604,246 @@ class MethodChannelPipPlugin extends BasePipPlugin {
 
   @override
   void dispose() {
+    for (final window in _windows.values.toList()) {
+      window.destroy().ignore();
+    }
     super.dispose();
     _configuration = PipConfiguration.initial;
+    _text = '';
   }
 }
+
+class _MethodChannelPipWindow implements PipWindow {
+  _MethodChannelPipWindow(this._plugin, this.id, this._configuration);
+
+  final MethodChannelPipPlugin _plugin;
+  final StreamController<bool> _activeController =
+      StreamController<bool>.broadcast();
+  bool _destroyed = false;
+
+  @override
+  final int id;
+
+  PipConfiguration _configuration;
+  @override
+  PipConfiguration get configuration => _configuration;
+
+  @override
+  Stream<bool> get activeStream => _activeController.stream;
+
+  void _handleStopped() {
+    if (!_activeController.isClosed) _activeController.add(false);
+  }
+
+  void _checkNotDestroyed() {
+    if (_destroyed) {
+      throw StateError('PipWindow $id has been destroyed.');
+    }
+  }
+
+  Future<T?> _invoke<T>(String method, [Object? args]) async {
+    _checkNotDestroyed();
+    try {
+      return await _plugin.methodChannel.invokeMethod<T>(
+          method, args ?? {'id': id});
+    } catch (e, st) {
+      debugPrint('MethodChannelPipWindow.$method error: $e\n$st');
+      return null;
+    }
+  }
+
+  @override
+  Future<bool> start() async {
+    final started = await _invoke<bool>('startPip') ?? false;
+    if (started) _activeController.add(true);
+    return started;
+  }
+
+  @override
+  Future<bool> stop() async {
+    final stopped = await _invoke<bool>('stopPip') ?? false;
+    if (stopped) _handleStopped();
+    return stopped;
+  }
+
+  @override
+  Future<bool> destroy() async {
+    final destroyed = await _invoke<bool>('destroyPip') ?? false;
+    if (destroyed) {
+      _destroyed = true;
+      _plugin._windows.remove(id);
+      await _activeController.close();
+    }
+    return destroyed;
+  }
+
+  @override
+  Future<bool> update(PipConfiguration configuration) async {
+    final success = await _invoke<bool>('updatePip', {
+          'id': id,
+          ..._plugin._configurationArgs(configuration),
+        }) ??
+        false;
+    if (success) _configuration = configuration;
+    return success;
+  }
+
+  @override
+  Future<bool> updateText(String text) async =>
+      await _invoke<bool>('updateText', {'id': id, 'text': text}) ?? false;
+
+  @override
+  Future<bool> appendText(String text) async =>
+      await _invoke<bool>('appendText', {'id': id, 'text': text}) ?? false;
+
+  @override
+  Future<bool> replaceRange(int start, int end, String text) async {
+    PipReplaceRangeOperation.checkRange(start, end);
+    return await _invoke<bool>('replaceRange', {
+          'id': id,
+          'start': start,
+          'end': end,
+          'text': text,
+        }) ??
+        false;
+  }
+
+  @override
+  Future<bool> clearText() async =>
+      await _invoke<bool>('clearText') ?? false;
+
+  @override
+  Future<bool> loadTextFile(String path) async =>
+      await _invoke<bool>('loadTextFile', {'id': id, 'path': path}) ?? false;
+
+  @override
+  Future<bool> applyBatch(List<PipOperation> operations) async {
+    for (final operation in operations.whereType<PipReplaceRangeOperation>()) {
+      PipReplaceRangeOperation.checkRange(operation.start, operation.end);
+    }
+    final (calls, configuration) =
+        _plugin._batchCalls(operations, _configuration);
+    final success = await _invoke<bool>(
+            'applyBatch', {'id': id, 'operations': calls}) ??
+        false;
+    if (success) {
+      _configuration = configuration;
+      final visibility =
+          operations.whereType<PipVisibilityOperation>().lastOrNull;
+      if (visibility != null) {
+        visibility.visible ? _activeController.add(true) : _handleStopped();
+      }
+    }
+    return success;
+  }
+
+  @override
+  Future<PipStats?> getStats() async {
+    final stats = await _invoke<Map<Object?, Object?>>('getStats');
+    return stats == null ? null : PipStats.fromMap(stats);
+  }
+
+  @override
+  Future<bool> startClock({
+    bool countdown = false,
+    Duration start = Duration.zero,
+    String format = 'mm:ss',
+  }) async =>
+      await _invoke<bool>('startClock', {
+        'id': id,
+        ..._plugin._clockArgs(countdown, start, format),
+      }) ??
+      false;
+
+  @override
+  Future<bool> stopClock() async =>
+      await _invoke<bool>('stopClock') ?? false;
+
+  @override
+  Future<bool> loadCueTrack({
+    List<PipCue>? cues,
+    String? path,
+    bool play = true,
+  }) async =>
+      await _invoke<bool>('loadCueTrack', {
+        'id': id,
+        ..._plugin._cueTrackArgs(cues, path, play),
+      }) ??
+      false;
+
+  @override
+  Future<bool> controlCueTrack({
+    bool? playing,
+    Duration? position,
+    double? rate,
+  }) async =>
+      await _invoke<bool>('controlCueTrack', {
+        'id': id,
+        ..._plugin._cueControlArgs(playing, position, rate),
+      }) ??
+      false;
+
+  @override
+  Future<bool> unloadCueTrack() async =>
+      await _invoke<bool>('unloadCueTrack') ?? false;
+
+  @override
+  Future<bool> tailFile(String path, {int maxLines = 200}) async =>
+      await _invoke<bool>(
+          'tailFile', {'id': id, 'path': path, 'maxLines': maxLines}) ??
+      false;
+
+  @override
+  Future<bool> stopTail() async => await _invoke<bool>('stopTail') ?? false;
+
+  @override
+  Future<bool> openSource(String path, {bool lengthPrefixed = false}) async =>
+      await _invoke<bool>('openSource', {
+        'id': id,
+        'path': path,
+        'lengthPrefixed': lengthPrefixed,
+      }) ??
+      false;
+
+  @override
+  Future<bool> closeSource() async =>
+      await _invoke<bool>('closeSource') ?? false;
+
+  @override
+  Future<bool> animate({
+    Color? backgroundColor,
+    Color? textColor,
+    double? textSize,
+    required Duration duration,
+    PipCurve curve = PipCurve.easeInOut,
+    int repeat = 1,
+    bool reverse = false,
+  }) async {
+    final success = await _invoke<bool>('animate', {
+          'id': id,
+          ..._plugin._animateArgs(backgroundColor, textColor, textSize,
+              duration, curve, repeat, reverse),
+        }) ??
+        false;
+    if (success) {
+      _configuration = MethodChannelPipPlugin._animatedConfiguration(
+          _configuration, backgroundColor, textColor, textSize, repeat,
+          reverse);
+    }
+    return success;
+  }
+
+  @override
+  Future<bool> autoFit({
+    bool enabled = true,
+    double minSize = 8,
+    double maxSize = 512,
+  }) async =>
+      await _invoke<bool>('autoFit', {
+        'id': id,
+        'enabled': enabled,
+        'minSize': minSize,
+        'maxSize': maxSize,
+      }) ??
+      false;
+}
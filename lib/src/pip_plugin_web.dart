@@ -4,6 +4,7 @@ import 'dart:ui';
 import 'package:flutter/foundation.dart';
 import 'package:flutter_web_plugins/flutter_web_plugins.dart';
 import 'package:pip_plugin/pip_configuration.dart';
+import 'package:pip_plugin/pip_operation.dart';
 import 'package:pip_plugin/src/contracts/base_pip_plugin.dart';
 import 'package:pip_plugin/src/contracts/pip_plugin_platform_interface.dart';
 import 'package:web/web.dart' as web;
@@ -12,6 +13,7 @@ class PipPluginWeb extends BasePipPlugin {
   web.HTMLVideoElement? _video;
   web.HTMLCanvasElement? _canvas;
   late PipConfiguration _configuration;
+  String _text = '';
 
   @override
   PipConfiguration get configuration => _configuration;
@@ -36,7 +38,8 @@ class PipPluginWeb extends BasePipPlugin {
 
   @override
   Future<bool> performSetup(
-      String? windowTitle, PipConfiguration? configuration) async {
+      String? windowTitle, PipConfiguration? configuration,
+      {bool prewarm = false}) async {
     try {
       _configuration = configuration ?? PipConfiguration.initial;
       _initializeCanvasAndVideo();
@@ -131,6 +134,7 @@ class PipPluginWeb extends BasePipPlugin {
     checkInitialized();
     try {
       _updateCanvas(text: text);
+      _text = text;
       return true;
     } catch (e, st) {
       debugPrint('PipPluginWeb.updateText error: $e\n$st');
@@ -138,6 +142,18 @@ class PipPluginWeb extends BasePipPlugin {
     }
   }
 
+  @override
+  Future<bool> appendText(String text) => updateText(_text + text);
+
+  @override
+  Future<bool> replaceRange(int start, int end, String text) {
+    return updateText(
+        PipReplaceRangeOperation.applyTo(_text, start, end, text));
+  }
+
+  @override
+  Future<bool> clearText() => updateText('');
+
   void _updateCanvas({String text = ''}) {
     final ctx = _canvas?.getContext('2d') as web.CanvasRenderingContext2D?;
     if (ctx == null) {
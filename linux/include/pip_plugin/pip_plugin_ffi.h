@@ -0,0 +1,51 @@
+#ifndef FLUTTER_PLUGIN_PIP_PLUGIN_FFI_H_
+#define FLUTTER_PLUGIN_PIP_PLUGIN_FFI_H_
+
+#include <stdint.h>
+
+#include "pip_plugin.h"
+
+G_BEGIN_DECLS
+
+// C ABI for the Dart PipFfi binding. These may be called from any thread,
+// including the Dart UI thread; they copy their arguments, keep only the
+// newest state and apply it on the GTK main thread before the next frame.
+// Setup and lifecycle still go through the "pip_plugin" method channel.
+
+// Replaces the text shown in the PiP window with the UTF-8 |text|.
+FLUTTER_PLUGIN_EXPORT void pip_plugin_ffi_set_text(const char* text);
+
+// Appends the UTF-8 |text| to the text shown in the PiP window.
+FLUTTER_PLUGIN_EXPORT void pip_plugin_ffi_append_text(const char* text);
+
+// Re-renders the whole PiP window.
+FLUTTER_PLUGIN_EXPORT void pip_plugin_ffi_request_redraw();
+
+// Single-producer/single-consumer ring for streaming updates without a call
+// per update. The producer writes records straight into the ring memory:
+// at 8-byte aligned offsets, a uint32 kind (1 = set text, 2 = append text,
+// 0 = skip to the start of the ring), a uint32 byte length and the UTF-8
+// payload. Records never wrap and take at most half the capacity, so one
+// always fits once the ring is drained, wherever the last one ended. The
+// PiP window drains the ring at most once per frame and renders only the
+// resulting text.
+
+// Creates the ring on first use, with |capacity| rounded up to a power of
+// two, and returns its memory. The ring lives as long as the process.
+FLUTTER_PLUGIN_EXPORT uint8_t* pip_plugin_ffi_ring_open(uint32_t capacity);
+
+FLUTTER_PLUGIN_EXPORT uint32_t pip_plugin_ffi_ring_capacity();
+
+// Everything before this index has been consumed and may be overwritten.
+FLUTTER_PLUGIN_EXPORT uint64_t pip_plugin_ffi_ring_read_index();
+
+// Index after the last published record, where a new producer (e.g. after
+// a hot restart) continues writing.
+FLUTTER_PLUGIN_EXPORT uint64_t pip_plugin_ffi_ring_write_index();
+
+// Makes the records before |write_index| visible to the consumer.
+FLUTTER_PLUGIN_EXPORT void pip_plugin_ffi_ring_publish(uint64_t write_index);
+
+G_END_DECLS
+
+#endif  // FLUTTER_PLUGIN_PIP_PLUGIN_FFI_H_
@@ -1,12 +1,42 @@
 #include "include/pip_plugin/pip_plugin.h"
+#include "include/pip_plugin/pip_plugin_ffi.h"
 
 #include <flutter_linux/flutter_linux.h>
 #include <gtk/gtk.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <sys/utsname.h>
 #include <cairo.h>
+#include <fcntl.h>
+#include <glib-unix.h>
+#include <unistd.h>
+#include <pango/pangocairo.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <map>
 #include <string>
+#include <vector>
 
+#include "cue_track.h"
+#include "frame_reader.h"
+#include "line_tail.h"
+#include "pip_animation.h"
+#include "pip_clock.h"
 #include "pip_plugin_private.h"
+#include "text_fit.h"
+#include "text_ring.h"
+
+using pip_plugin::Cue;
+using pip_plugin::CueTrack;
+using pip_plugin::FrameReader;
+using pip_plugin::LineTail;
+using pip_plugin::PipAnimation;
+using pip_plugin::PipClock;
+using pip_plugin::TextFit;
+using pip_plugin::TextRing;
 
 #define PIP_PLUGIN(obj) \
   (G_TYPE_CHECK_INSTANCE_CAST((obj), pip_plugin_get_type(), \
@@ -18,391 +48,2963 @@ struct _PipPlugin {
 
 G_DEFINE_TYPE(PipPlugin, pip_plugin, g_object_get_type())
 
-enum TextAlign { ALIGN_LEFT, ALIGN_CENTER, ALIGN_RIGHT };
+static const char kPipFontFamily[] = "Monospace";
+static const int kTextPadding = 10;
+
+// One '\n'-separated paragraph of the current text with its own shaped
+// PangoLayout. Paragraphs before an edit keep their layouts untouched.
+struct TextParagraph {
+  size_t start;
+  size_t length;
+  // Created on first use, see paragraph_layout(). In teleprompter mode it
+  // is released again once scrolled out of view; the measurements stay.
+  PangoLayout* layout;
+  int top;
+  int height;
+  PangoRectangle ink;
+  // False until the layout has been shaped with the current text and style.
+  bool measured;
+};
+
+// Shaped and positioned text, reused across exposes until the text, the
+// style or the allocated size changes.
+struct TextLayoutCache {
+  bool valid;
+  // Font, alignment or size changed, so every paragraph must be re-wrapped.
+  bool style_dirty;
+  int width;
+  int height;
+  double text_size;
+  // Owned by the shared font cache, see shared_font().
+  const PangoFontDescription* font;
+  std::vector<TextParagraph> paragraphs;
+  // Paragraphs [first_positioned, positioned) are measured and stacked,
+  // block_height tall. In teleprompter mode the block starts at the first
+  // paragraph and the rest are only laid out as the viewport approaches
+  // them, see extend_layout(). Otherwise it ends at the last one and
+  // reaches up only as far as the window shows, see fill_layout().
+  size_t first_positioned;
+  size_t positioned;
+  int block_height;
+  // Top of the text block in drawing area coordinates.
+  int y;
+};
+
+// One pre-rendered cell per character of the clock text, drawn with the
+// style it was created for. Cells are as wide as the widest digit, so a
+// changed digit is redrawn by copying its cell over the old one.
+struct ClockGlyphs {
+  std::map<char, cairo_surface_t*> cells;
+  int cell_width;
+  int cell_height;
+  double text_size;
+  GdkRGBA bg_color;
+  GdkRGBA text_color;
+  int scale;
+};
+
+struct PipStats {
+  // Updates received: method calls, FFI calls and ring records.
+  guint64 updates;
+  // Updates merged into a frame together with a newer one, so their own
+  // state was never rendered.
+  guint64 superseded;
+  // Repaints actually rendered.
+  guint64 frames;
+  // Microseconds from the last startPip showing the window to its first
+  // drawn frame, 0 until measured.
+  guint64 first_frame_us;
+};
 
 struct PipWindow {
+  // Addresses the window in method calls and pipStopped.
+  int64_t id;
   GtkWidget* window;
   GtkWidget* drawing_area;
   GtkWidget* menu_bar;
+  // The text shown, unless mapped_text is set: a file opened by
+  // loadTextFile is shown straight from its mapping until it is edited.
   std::string current_text;
-  GdkRGBA bg_color;
-  GdkRGBA text_color;
-  TextAlign     text_align;
-  double text_size; 
+  GMappedFile* mapped_text;
+  // Bumped by every change of the text.
+  uint64_t text_generation;
+  PipStyle style;
   FlMethodChannel* method_channel;
+  TextLayoutCache layout;
+  // Retained copy of the drawing area contents. Exposes only blit it.
+  // backing_width/backing_height are the allocation it was rendered for.
+  cairo_surface_t* backing;
+  int backing_width;
+  int backing_height;
+  bool backing_dirty;
+  // Teleprompter mode: the text block is scrolled by style.scroll_speed
+  // pixels per second from the frame clock. Instead of the backing, it is
+  // rasterized in bands as tall as the window, by index; only the bands
+  // around the viewport are kept, so memory and frame cost follow the
+  // window size rather than the document size.
+  std::map<int, cairo_surface_t*> tiles;
+  bool teleprompter;
+  bool scrolling;
+  double scroll_offset;
+  gint64 scroll_last_time;
+  guint scroll_tick_id;
+  // Frame clock tick draining the FFI text ring while it receives records.
+  guint ring_tick_id;
+  // Repaint owed to the window. While batch_depth is non-zero refreshes
+  // only record what changed; pip_window_flush() renders it all at once.
+  int batch_depth;
+  bool refresh_full;
+  bool refresh_text;
+  GdkRectangle text_damage;
+  // Newest updateText not applied yet. Only the last text of a burst is
+  // spliced in, right before the frame that shows it.
+  bool text_pending;
+  std::string pending_text;
+  // Frame clock tick rendering the owed repaint, at most once per frame.
+  guint flush_tick_id;
+  // Counters reported by getStats.
+  PipStats stats;
+  // Monotonic time startPip showed the window at, 0 once its first frame
+  // was drawn.
+  gint64 show_time;
+  // Clock content mode: instead of the text, the clock is rendered from
+  // the frame clock. clock_text is what the backing shows.
+  PipClock clock;
+  std::string clock_text;
+  guint clock_tick_id;
+  ClockGlyphs glyphs;
+  // Cue track switching the text natively while it plays. cue_index is
+  // the cue the text shows, CueTrack::kNoCue for none; cue_timeout_id
+  // fires when the next cue starts or ends.
+  CueTrack cues;
+  size_t cue_index;
+  guint cue_timeout_id;
+  // File tail mode: the text is the last lines of the file at tail_path.
+  // The monitor reports changes through inotify; the bytes from
+  // tail_offset on are then read from tail_fd, -1 while not tailing.
+  // tail_generation is the text_generation the tail's text was shown at.
+  LineTail tail;
+  uint64_t tail_generation;
+  std::string tail_path;
+  GFileMonitor* tail_monitor;
+  int tail_fd;
+  gint64 tail_offset;
+  // Socket source: the newest frame a client writes to the Unix domain
+  // socket at source_path replaces the text. One client is read at a time;
+  // the fds are watched from the main loop, -1 and 0 while not open.
+  FrameReader frames;
+  FrameReader::Framing source_framing;
+  std::string source_path;
+  int source_fd;
+  guint source_watch;
+  int client_fd;
+  guint client_watch;
+  // Style transition of animate, sampled on the frame clock. During a
+  // size tween style.text_size is the larger of the two sizes and the
+  // contents are drawn scaled by text_scale, so the text is laid out once
+  // rather than every frame.
+  PipAnimation animation;
+  guint animation_tick_id;
+  double text_scale;
+  // Auto-fit mode: style.text_size is the largest size in [fit_min_size,
+  // fit_max_size] at which the wrapped text fits the drawing area, and
+  // fit_base_size is restored when the mode is turned off. fit_layout
+  // measures the text; fit_width x fit_height is the area last fitted.
+  bool fit_enabled;
+  TextFit fit;
+  double fit_min_size;
+  double fit_max_size;
+  double fit_base_size;
+  PangoLayout* fit_layout;
+  int fit_width;
+  int fit_height;
+  // Interactive resizing: every configure-event with a new size restarts
+  // the settle timeout, and until it fires the window is being resized.
+  int configure_width;
+  int configure_height;
+  guint resize_settle_id;
 };
 
+// Every open window by id. pip_instance is the default window: the one
+// addressed without an id and the target of the FFI entry points.
+static std::map<int64_t, PipWindow*> pip_windows;
 static PipWindow* pip_instance = nullptr;
+static int64_t next_window_id = 1;
 
-// Cairo drawing callback
-static gboolean draw_callback(GtkWidget *widget, cairo_t *cr, gpointer data) {
-  PipWindow* pip = static_cast<PipWindow*>(data);
+// Font descriptions by size, shared by every window's layouts.
+static std::map<double, PangoFontDescription*> font_cache;
 
-  // Draw background
-  cairo_set_source_rgba(cr,
-                      pip->bg_color.red,
-                      pip->bg_color.green,
-                      pip->bg_color.blue,
-                      pip->bg_color.alpha);
-  cairo_paint(cr);
+// Teleprompter bands kept: two visible, one prefetched and one behind.
+static const size_t kMaxTextTiles = 4;
 
-  // Draw text
-  cairo_set_source_rgba(cr,
-    pip->text_color.red,
-    pip->text_color.green,
-    pip->text_color.blue,
-    pip->text_color.alpha);
-  cairo_select_font_face(cr, "Monospace", CAIRO_FONT_SLANT_NORMAL,
-                      CAIRO_FONT_WEIGHT_BOLD);
-  cairo_set_font_size(cr, pip->text_size);
-
-  cairo_text_extents_t extents;
-  cairo_text_extents(cr, pip->current_text.c_str(), &extents);
-  int w = gtk_widget_get_allocated_width(widget);
-  int h = gtk_widget_get_allocated_height(widget);
+// Forces every paragraph to be re-wrapped, e.g. after a style change. The
+// shaped text itself is kept.
+static void invalidate_layout(PipWindow* pip) {
+  pip->layout.valid = false;
+  pip->layout.style_dirty = true;
+}
+
+static const char* text_data(PipWindow* pip) {
+  if (pip->mapped_text != nullptr) {
+    // An empty file has no contents at all.
+    const char* contents = g_mapped_file_get_contents(pip->mapped_text);
+    return contents != nullptr ? contents : "";
+  }
+  return pip->current_text.c_str();
+}
+
+static size_t text_size(PipWindow* pip) {
+  if (pip->mapped_text != nullptr) {
+    return g_mapped_file_get_length(pip->mapped_text);
+  }
+  return pip->current_text.size();
+}
+
+// Drops the mapping of loadTextFile, first copying the file into
+// current_text if |keep| is set.
+static void unmap_text(PipWindow* pip, bool keep) {
+  if (pip->mapped_text == nullptr) {
+    return;
+  }
+  if (keep) {
+    pip->current_text.assign(text_data(pip), text_size(pip));
+  }
+  g_mapped_file_unref(pip->mapped_text);
+  pip->mapped_text = nullptr;
+}
+
+static void clear_tiles(PipWindow* pip) {
+  for (auto& tile : pip->tiles) {
+    cairo_surface_destroy(tile.second);
+  }
+  pip->tiles.clear();
+}
+
+static void clear_layout(PipWindow* pip) {
+  for (TextParagraph& paragraph : pip->layout.paragraphs) {
+    g_clear_object(&paragraph.layout);
+  }
+  clear_tiles(pip);
+  pip->layout.paragraphs.clear();
+  pip->layout.font = nullptr;
+  invalidate_layout(pip);
+  if (pip->backing != nullptr) {
+    cairo_surface_destroy(pip->backing);
+    pip->backing = nullptr;
+  }
+}
+
+// Length of the common head of |a| and the |b_length| bytes at |b|.
+static size_t common_prefix_length(const std::string& a, const char* b,
+                                   size_t b_length) {
+  size_t limit = MIN(a.size(), b_length);
+  size_t i = 0;
+  while (i < limit && a[i] == b[i]) {
+    i++;
+  }
+  return i;
+}
+
+// Length of the common tail of |a| and the |b_length| bytes at |b|, not
+// reaching into the first |prefix| bytes of either.
+static size_t common_suffix_length(const std::string& a, const char* b,
+                                   size_t b_length, size_t prefix) {
+  size_t limit = MIN(a.size(), b_length) - prefix;
+  size_t i = 0;
+  while (i < limit && a[a.size() - 1 - i] == b[b_length - 1 - i]) {
+    i++;
+  }
+  return i;
+}
+
+size_t utf16_index_to_byte_offset(const std::string& text, int64_t index) {
+  size_t offset = 0;
+  int64_t units = 0;
+  while (offset < text.size()) {
+    unsigned char c = static_cast<unsigned char>(text[offset]);
+    size_t length = 1;
+    if ((c & 0xE0) == 0xC0) {
+      length = 2;
+    } else if ((c & 0xF0) == 0xE0) {
+      length = 3;
+    } else if ((c & 0xF8) == 0xF0) {
+      length = 4;
+    }
+    // Characters outside the BMP are a surrogate pair in UTF-16.
+    int64_t char_units = length == 4 ? 2 : 1;
+    if (units + char_units > index) {
+      break;
+    }
+    units += char_units;
+    offset = MIN(offset + length, text.size());
+  }
+  return offset;
+}
 
-  // 4) Pick X based on alignment
-  double x;
-  switch (pip->text_align) {
+// The PiP font at |size| pixels. Created on first use and kept until the
+// plugin is disposed.
+static const PangoFontDescription* shared_font(double size) {
+  PangoFontDescription*& font = font_cache[size];
+  if (font == nullptr) {
+    font = pango_font_description_new();
+    pango_font_description_set_family(font, kPipFontFamily);
+    pango_font_description_set_weight(font, PANGO_WEIGHT_BOLD);
+    pango_font_description_set_absolute_size(font, size * PANGO_SCALE);
+  }
+  return font;
+}
+
+static void apply_paragraph_style(PipWindow* pip, TextParagraph* paragraph) {
+  TextLayoutCache* layout = &pip->layout;
+  PangoLayout* pango = paragraph->layout;
+  pango_layout_set_font_description(pango, layout->font);
+  pango_layout_set_width(pango,
+      MAX(layout->width - 2 * kTextPadding, 1) * PANGO_SCALE);
+  pango_layout_set_wrap(pango, PANGO_WRAP_WORD_CHAR);
+  if (pip->teleprompter) {
+    pango_layout_set_height(pango, -1);
+    pango_layout_set_ellipsize(pango, PANGO_ELLIPSIZE_NONE);
+  } else {
+    // A single paragraph never grows past the window; overflowing lines are
+    // ellipsized.
+    pango_layout_set_height(pango, MAX(layout->height, 1) * PANGO_SCALE);
+    pango_layout_set_ellipsize(pango, PANGO_ELLIPSIZE_END);
+  }
+  switch (pip->style.text_align) {
     case ALIGN_LEFT:
-      x = 10;  // left + padding
+      pango_layout_set_alignment(pango, PANGO_ALIGN_LEFT);
       break;
     case ALIGN_RIGHT:
-      x = w - extents.width - 10;
+      pango_layout_set_alignment(pango, PANGO_ALIGN_RIGHT);
       break;
     case ALIGN_CENTER:
     default:
-      x = (w - extents.width) / 2;
+      pango_layout_set_alignment(pango, PANGO_ALIGN_CENTER);
   }
+}
 
-  // 5) Vertically center
-  double y = (h + extents.height) / 2;
+static PangoLayout* paragraph_layout(PipWindow* pip,
+                                     TextParagraph* paragraph) {
+  if (paragraph->layout == nullptr) {
+    paragraph->layout =
+        pango_layout_new(gtk_widget_get_pango_context(pip->drawing_area));
+    pango_layout_set_text(paragraph->layout,
+                          text_data(pip) + paragraph->start,
+                          static_cast<int>(paragraph->length));
+    if (pip->layout.font != nullptr) {
+      apply_paragraph_style(pip, paragraph);
+    }
+  }
+  return paragraph->layout;
+}
 
-  // 6) Draw
-  cairo_move_to(cr, x, y);
-  cairo_show_text(cr, pip->current_text.c_str());
+static void measure_paragraph(PipWindow* pip, TextParagraph* paragraph) {
+  PangoRectangle logical;
+  pango_layout_get_pixel_extents(paragraph_layout(pip, paragraph),
+                                 &paragraph->ink, &logical);
+  paragraph->height = logical.height;
+  paragraph->measured = true;
+}
 
-  return FALSE;
+// Re-splits the paragraphs touched by an edit that replaced bytes
+// [|start|, |old_end|) of the text with what is now [|start|, |new_end|).
+// Paragraphs outside the edit keep their shaped layouts and are only
+// shifted; the touched ones are re-shaped when next laid out.
+// With no paragraphs yet the whole text is split.
+static void splice_paragraphs(PipWindow* pip, size_t start, size_t old_end,
+                              size_t new_end) {
+  TextLayoutCache* layout = &pip->layout;
+  std::vector<TextParagraph>& paragraphs = layout->paragraphs;
+  const char* text = text_data(pip);
+  layout->valid = false;
+  if (!pip->clock.active()) {
+    pip->fit.Reset();
+  }
+
+  // Paragraphs [first, last) overlap the edit. One ending exactly at
+  // |start| is included, as the edit may remove its line break.
+  size_t first = 0;
+  while (first < paragraphs.size() &&
+         paragraphs[first].start + paragraphs[first].length < start) {
+    first++;
+  }
+  size_t last = first;
+  while (last < paragraphs.size() && paragraphs[last].start <= old_end) {
+    last++;
+  }
+
+  size_t region_start = 0;
+  size_t region_end = text_size(pip);
+  if (first < last) {
+    const TextParagraph& tail = paragraphs[last - 1];
+    region_start = paragraphs[first].start;
+    region_end = tail.start + tail.length + new_end - old_end;
+  }
+
+  std::vector<TextParagraph> pieces;
+  size_t piece_start = region_start;
+  while (true) {
+    const void* line_break =
+        memchr(text + piece_start, '\n', region_end - piece_start);
+    size_t end = line_break != nullptr
+                     ? static_cast<const char*>(line_break) - text
+                     : region_end;
+    TextParagraph piece = {};
+    piece.start = piece_start;
+    piece.length = end - piece_start;
+    size_t reuse = first + pieces.size();
+    if (reuse < last && paragraphs[reuse].layout != nullptr) {
+      piece.layout = paragraphs[reuse].layout;
+      paragraphs[reuse].layout = nullptr;
+      pango_layout_set_text(piece.layout, text + piece.start,
+                            static_cast<int>(piece.length));
+    }
+    pieces.push_back(piece);
+    if (end == region_end) {
+      break;
+    }
+    piece_start = end + 1;
+  }
+
+  for (size_t i = first; i < last; i++) {
+    g_clear_object(&paragraphs[i].layout);
+  }
+  for (size_t i = last; i < paragraphs.size(); i++) {
+    paragraphs[i].start = paragraphs[i].start + new_end - old_end;
+  }
+  paragraphs.erase(paragraphs.begin() + first, paragraphs.begin() + last);
+  paragraphs.insert(paragraphs.begin() + first, pieces.begin(), pieces.end());
 }
 
-// Create menu bar
-static GtkWidget* create_menu_bar() {
-  GtkWidget* menu_bar = gtk_menu_bar_new();
-  return menu_bar;
+// Measures and stacks paragraphs until the block reaches |bottom|.
+static void extend_layout(PipWindow* pip, int bottom) {
+  TextLayoutCache* layout = &pip->layout;
+  while (layout->positioned < layout->paragraphs.size() &&
+         layout->block_height < bottom) {
+    TextParagraph& paragraph = layout->paragraphs[layout->positioned++];
+    if (!paragraph.measured) {
+      measure_paragraph(pip, &paragraph);
+    }
+    paragraph.top = layout->block_height;
+    layout->block_height += paragraph.height;
+  }
 }
 
-// Handler for window close event
-static gboolean on_window_close(GtkWidget* widget, GdkEvent* event, gpointer data) {
-  PipWindow* pip = static_cast<PipWindow*>(data);
-  
-  // Notify Flutter that PiP was closed
-  if (pip->method_channel != nullptr) {
-    g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
-    fl_method_channel_invoke_method(pip->method_channel, "pipStopped", result, nullptr, nullptr, nullptr);
+// Measures and stacks paragraphs from the last one up until the block
+// fills |h| rows. Anything above is outside a bottom-anchored window, so a
+// long text, e.g. a mapped file, is shaped only where it is visible.
+static void fill_layout(PipWindow* pip, int h) {
+  TextLayoutCache* layout = &pip->layout;
+  std::vector<TextParagraph>& paragraphs = layout->paragraphs;
+  layout->first_positioned = paragraphs.size();
+  layout->positioned = paragraphs.size();
+  while (layout->first_positioned > 0 && layout->block_height < h) {
+    TextParagraph& paragraph = paragraphs[--layout->first_positioned];
+    if (!paragraph.measured) {
+      measure_paragraph(pip, &paragraph);
+    }
+    layout->block_height += paragraph.height;
+  }
+  int top = 0;
+  for (size_t i = layout->first_positioned; i < layout->positioned; i++) {
+    paragraphs[i].top = top;
+    top += paragraphs[i].height;
+  }
+  // Paragraphs pushed out of view by the text below them, e.g. appended
+  // lines, drop their layouts back to the first one already released.
+  for (size_t i = layout->first_positioned;
+       i > 0 && paragraphs[i - 1].layout != nullptr; i--) {
+    g_clear_object(&paragraphs[i - 1].layout);
   }
-  
-  // Hide window instead of destroying it
-  gtk_widget_hide(widget);
-  
-  // Return TRUE to prevent the window from being destroyed automatically
-  return TRUE;
 }
 
-FlMethodResponse* setup_pip(FlValue* args, FlMethodChannel* method_channel) {
-  if (!pip_instance) {
-    pip_instance = new PipWindow();
-    pip_instance->method_channel = method_channel;
-    
-    // Create main window
-    pip_instance->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
-    gtk_window_set_title(GTK_WINDOW(pip_instance->window), "PiP Window");
-    gtk_window_set_default_size(GTK_WINDOW(pip_instance->window), 320, 240);
-    gtk_window_set_keep_above(GTK_WINDOW(pip_instance->window), TRUE);
-    
-    // Connect the delete-event signal to handle window close
-    g_signal_connect(pip_instance->window, "delete-event", 
-        G_CALLBACK(on_window_close), pip_instance);
-    
-    // Create container
-    GtkWidget* box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
-    
-    // Add menu bar
-    pip_instance->menu_bar = create_menu_bar();
-    gtk_box_pack_start(GTK_BOX(box), pip_instance->menu_bar, FALSE, FALSE, 0);
-    
-    // Add drawing area
-    pip_instance->drawing_area = gtk_drawing_area_new();
-    gtk_box_pack_start(GTK_BOX(box), pip_instance->drawing_area, TRUE, TRUE, 0);
-    g_signal_connect(pip_instance->drawing_area, "draw", 
-        G_CALLBACK(draw_callback), pip_instance);
-    
-    gtk_container_add(GTK_CONTAINER(pip_instance->window), box);
-    
-    // Default background color (black with 80% opacity)
-    pip_instance->bg_color = {0, 0, 0, 0.8};
+// Index of the first positioned paragraph reaching below row |y| of the
+// drawing area.
+static size_t first_paragraph_below(PipWindow* pip, int y) {
+  const TextLayoutCache& layout = pip->layout;
+  auto begin = layout.paragraphs.begin() + layout.first_positioned;
+  auto end = layout.paragraphs.begin() + layout.positioned;
+  return std::partition_point(begin, end,
+                              [&](const TextParagraph& paragraph) {
+                                return layout.y + paragraph.top +
+                                           paragraph.height <=
+                                       y;
+                              }) -
+         layout.paragraphs.begin();
+}
 
-    pip_instance->text_color = {1, 1, 1, 1.0};
+// Teleprompter mode: drops the layouts of the paragraphs scrolled out above
+// row |y|. Everything above the first one already released is released.
+static void release_layouts_above(PipWindow* pip, int y) {
+  std::vector<TextParagraph>& paragraphs = pip->layout.paragraphs;
+  for (size_t i = first_paragraph_below(pip, y);
+       i > 0 && paragraphs[i - 1].layout != nullptr; i--) {
+    g_clear_object(&paragraphs[i - 1].layout);
+  }
+}
 
-    pip_instance->text_size = 32.0;
-    
-    // Get parameters
-    if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
-      FlValue* window_title = fl_value_lookup_string(args, "windowTitle");
-      if (window_title != nullptr && fl_value_get_type(window_title) == FL_VALUE_TYPE_STRING) {
-        gtk_window_set_title(GTK_WINDOW(pip_instance->window), fl_value_get_string(window_title));
-      }
+// The clock text with every digit replaced by 0. The auto-fit size only
+// depends on this shape, as the clock cells are as wide as the widest
+// digit.
+static std::string clock_shape(const std::string& text) {
+  std::string shape = text;
+  for (char& c : shape) {
+    if (c >= '0' && c <= '9') {
+      c = '0';
+    }
+  }
+  return shape;
+}
 
-      // Set text
-      FlValue* text_value = fl_value_lookup_string(args, "text");
-      if (text_value != nullptr && fl_value_get_type(text_value) == FL_VALUE_TYPE_STRING) {
-        pip_instance->current_text = fl_value_get_string(text_value);
-      }
-      
-      // Set background color if provided
-      FlValue* bg_color = fl_value_lookup_string(args, "backgroundColor");
-      if (bg_color != nullptr && fl_value_get_type(bg_color) == FL_VALUE_TYPE_LIST) {
-        int r = fl_value_get_int(fl_value_get_list_value(bg_color, 0));
-        int g = fl_value_get_int(fl_value_get_list_value(bg_color, 1));
-        int b = fl_value_get_int(fl_value_get_list_value(bg_color, 2));
-        int a = 255;
-        if (fl_value_get_length(bg_color) > 3) {
-          a = fl_value_get_int(fl_value_get_list_value(bg_color, 3));
+// Auto-fit mode: sets the text size to the largest that fits a |w| x |h|
+// area. While the window is being resized, or a size tween runs, the size
+// fitted last is kept. Sizes are measured once per text, see TextFit.
+static void pip_window_fit(PipWindow* pip, int w, int h) {
+  // A mapped file is too large to measure whole; it keeps its size.
+  if (!pip->fit_enabled || pip->teleprompter || pip->text_scale != 1 ||
+      pip->resize_settle_id != 0 || pip->mapped_text != nullptr) {
+    return;
+  }
+  if (pip->fit_layout == nullptr) {
+    pip->fit_layout =
+        pango_layout_new(gtk_widget_get_pango_context(pip->drawing_area));
+  }
+  PangoLayout* layout = pip->fit_layout;
+  int width = MAX(w - 2 * kTextPadding, 1);
+  bool clock = pip->clock.active();
+  bool text_set = false;
+  int fitted = pip->fit.Fit(
+      width, h, static_cast<int>(std::ceil(pip->fit_min_size)),
+      static_cast<int>(pip->fit_max_size), [&](int size) {
+        if (!text_set) {
+          if (clock) {
+            // The clock is never wrapped.
+            std::string shape = clock_shape(pip->clock_text);
+            pango_layout_set_text(layout, shape.data(),
+                                  static_cast<int>(shape.size()));
+            pango_layout_set_width(layout, -1);
+          } else {
+            // Wrapped as the paragraphs are drawn.
+            pango_layout_set_text(layout, text_data(pip),
+                                  static_cast<int>(text_size(pip)));
+            pango_layout_set_width(layout, width * PANGO_SCALE);
+            pango_layout_set_wrap(layout, PANGO_WRAP_WORD_CHAR);
+          }
+          text_set = true;
         }
-        
-        pip_instance->bg_color.red = r / 255.0;
-        pip_instance->bg_color.green = g / 255.0;
-        pip_instance->bg_color.blue = b / 255.0;
-        pip_instance->bg_color.alpha = a / 255.0;
+        pango_layout_set_font_description(layout, shared_font(size));
+        PangoRectangle logical;
+        pango_layout_get_pixel_extents(layout, nullptr, &logical);
+        if (clock && logical.width > width) return HUGE_VAL;
+        return static_cast<double>(logical.height);
+      });
+  pip->style.text_size = fitted;
+  pip->fit_width = w;
+  pip->fit_height = h;
+}
+
+// Shapes and positions the current text for a |w| x |h| area. Paragraphs
+// are wrapped to the window width and stacked; a block taller than the
+// window is anchored to the bottom so the newest text stays visible, and
+// only the paragraphs it shows are laid out. In teleprompter mode the
+// block always starts at the top, and only the paragraphs down to a window
+// below the viewport are laid out.
+static void ensure_layout(PipWindow* pip, int w, int h) {
+  TextLayoutCache* layout = &pip->layout;
+  if (layout->valid && layout->width == w && layout->height == h) {
+    return;
+  }
+
+  if (layout->paragraphs.empty()) {
+    splice_paragraphs(pip, 0, 0, text_size(pip));
+  }
+  pip_window_fit(pip, w, h);
+
+  if (layout->font == nullptr || layout->text_size != pip->style.text_size) {
+    layout->font = shared_font(pip->style.text_size);
+    layout->text_size = pip->style.text_size;
+    layout->style_dirty = true;
+  }
+
+  if (layout->width != w || layout->height != h) {
+    layout->width = w;
+    layout->height = h;
+    layout->style_dirty = true;
+  }
+
+  if (layout->style_dirty) {
+    for (TextParagraph& paragraph : layout->paragraphs) {
+      if (paragraph.layout != nullptr) {
+        apply_paragraph_style(pip, &paragraph);
       }
+      paragraph.measured = false;
+    }
+    layout->style_dirty = false;
+  }
 
-      FlValue* fg_list = fl_value_lookup_string(args, "textColor");
-    if (fg_list && fl_value_get_type(fg_list) == FL_VALUE_TYPE_LIST
-        && fl_value_get_length(fg_list) >= 4) {
-      int r = fl_value_get_int(fl_value_get_list_value(fg_list, 0));
-      int g = fl_value_get_int(fl_value_get_list_value(fg_list, 1));
-      int b = fl_value_get_int(fl_value_get_list_value(fg_list, 2));
-      int a = fl_value_get_int(fl_value_get_list_value(fg_list, 3));
-      pip_instance->text_color.red   = r / 255.0;
-      pip_instance->text_color.green = g / 255.0;
-      pip_instance->text_color.blue  = b / 255.0;
-      pip_instance->text_color.alpha = a / 255.0;
-    }
-
-    // Text alignment
-    FlValue* al = fl_value_lookup_string(args, "textAlign");
-
-if (al && fl_value_get_type(al) == FL_VALUE_TYPE_STRING) {
-  const char* s = fl_value_get_string(al);
-
-  if (strcmp(s, "left") == 0) {
-    pip_instance->text_align = ALIGN_LEFT;
-  } else if (strcmp(s, "right") == 0) {
-    pip_instance->text_align = ALIGN_RIGHT;
+  layout->first_positioned = 0;
+  layout->positioned = 0;
+  layout->block_height = 0;
+  if (pip->teleprompter) {
+    layout->y = 0;
+    extend_layout(pip, static_cast<int>(pip->scroll_offset) + 2 * h);
+    size_t above =
+        first_paragraph_below(pip, static_cast<int>(pip->scroll_offset) - h);
+    for (size_t i = 0; i < above; i++) {
+      g_clear_object(&layout->paragraphs[i].layout);
+    }
   } else {
-    pip_instance->text_align = ALIGN_CENTER;
-  }
-}
-
-    // Font size
-    FlValue* size_val = fl_value_lookup_string(args, "textSize");
-    if (size_val && fl_value_get_type(size_val) == FL_VALUE_TYPE_FLOAT) {
-      pip_instance->text_size = fl_value_get_float(size_val);
-    }
-      
-      // Set ratio if provided
-      FlValue* ratio = fl_value_lookup_string(args, "ratio");
-      if (ratio != nullptr && fl_value_get_type(ratio) == FL_VALUE_TYPE_LIST &&
-          fl_value_get_length(ratio) >= 2) {
-        int r1 = fl_value_get_int(fl_value_get_list_value(ratio, 0));
-        int r2 = fl_value_get_int(fl_value_get_list_value(ratio, 1));
-        if (r1 > 0 && r2 > 0) {
-          int height = 180;
-          int width = height * r1 / r2;          
-          gtk_window_set_default_size(GTK_WINDOW(pip_instance->window), width, height);
-        }
-      }
+    fill_layout(pip, h);
+    int top = layout->block_height;
+    layout->y = top <= h ? (h - top) / 2 : h - top;
+  }
+  layout->valid = true;
+}
+
+// Drawing area bounds of the laid out text, with a pixel of slack for
+// antialiasing.
+static GdkRectangle text_ink_rect(const TextLayoutCache* layout) {
+  GdkRectangle rect = {0, 0, 0, 0};
+  bool first = true;
+  for (size_t i = layout->first_positioned; i < layout->positioned; i++) {
+    const TextParagraph& paragraph = layout->paragraphs[i];
+    GdkRectangle ink = {kTextPadding + paragraph.ink.x - 1,
+                        layout->y + paragraph.top + paragraph.ink.y - 1,
+                        paragraph.ink.width + 2, paragraph.ink.height + 2};
+    if (first) {
+      rect = ink;
+      first = false;
+    } else {
+      gdk_rectangle_union(&rect, &ink, &rect);
     }
-    
-    // Window controls
-    gtk_window_set_deletable(GTK_WINDOW(pip_instance->window), TRUE);
-    gtk_window_set_resizable(GTK_WINDOW(pip_instance->window), TRUE);
-    gtk_window_set_skip_taskbar_hint(GTK_WINDOW(pip_instance->window), FALSE);
   }
-  
-  g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
-  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  return rect;
 }
 
-FlMethodResponse* update_pip(FlValue* args) {
-  if (!pip_instance || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
-    auto result = fl_value_new_bool(FALSE);
-    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+static void clear_clock_glyphs(PipWindow* pip) {
+  for (auto& cell : pip->glyphs.cells) {
+    cairo_surface_destroy(cell.second);
   }
-  
+  pip->glyphs.cells.clear();
+}
 
-  // 2) Update background color if provided
-  FlValue* bg_list = fl_value_lookup_string(args, "backgroundColor");
-  if (bg_list && fl_value_get_type(bg_list) == FL_VALUE_TYPE_LIST
-      && fl_value_get_length(bg_list) >= 4) {
-    int r = fl_value_get_int(fl_value_get_list_value(bg_list, 0));
-    int g = fl_value_get_int(fl_value_get_list_value(bg_list, 1));
-    int b = fl_value_get_int(fl_value_get_list_value(bg_list, 2));
-    int a = fl_value_get_int(fl_value_get_list_value(bg_list, 3));
-    pip_instance->bg_color.red   = r / 255.0;
-    pip_instance->bg_color.green = g / 255.0;
-    pip_instance->bg_color.blue  = b / 255.0;
-    pip_instance->bg_color.alpha = a / 255.0;
-  }
-
-  FlValue* fg_list = fl_value_lookup_string(args, "textColor");
-  GdkRGBA fg = pip_instance->bg_color;
-  if (fg_list && fl_value_get_type(fg_list) == FL_VALUE_TYPE_LIST
-      && fl_value_get_length(fg_list) >= 4) {
-    int r = fl_value_get_int(fl_value_get_list_value(fg_list, 0));
-    int g = fl_value_get_int(fl_value_get_list_value(fg_list, 1));
-    int b = fl_value_get_int(fl_value_get_list_value(fg_list, 2));
-    int a = fl_value_get_int(fl_value_get_list_value(fg_list, 3));
-    fg.red   = r / 255.0;
-    fg.green = g / 255.0;
-    fg.blue  = b / 255.0;
-    fg.alpha = a / 255.0;
-  }
-  pip_instance->text_color = fg;  
+// Returns the cell of |c|, rendering it on first use. The cache is dropped
+// when the style it was rendered with changes.
+static cairo_surface_t* clock_glyph(PipWindow* pip, char c) {
+  ClockGlyphs* glyphs = &pip->glyphs;
+  const PipStyle& style = pip->style;
+  int scale = gtk_widget_get_scale_factor(pip->drawing_area);
+  if (glyphs->text_size != style.text_size || glyphs->scale != scale ||
+      !gdk_rgba_equal(&glyphs->bg_color, &style.bg_color) ||
+      !gdk_rgba_equal(&glyphs->text_color, &style.text_color)) {
+    clear_clock_glyphs(pip);
+    glyphs->text_size = style.text_size;
+    glyphs->bg_color = style.bg_color;
+    glyphs->text_color = style.text_color;
+    glyphs->scale = scale;
 
-  FlValue* size_val = fl_value_lookup_string(args, "textSize");
-  if (size_val && fl_value_get_type(size_val) == FL_VALUE_TYPE_FLOAT) {
-    pip_instance->text_size = fl_value_get_float(size_val);
+    PangoLayout* digits =
+        pango_layout_new(gtk_widget_get_pango_context(pip->drawing_area));
+    pango_layout_set_font_description(digits, shared_font(style.text_size));
+    glyphs->cell_width = 0;
+    for (char digit = '0'; digit <= '9'; digit++) {
+      PangoRectangle logical;
+      pango_layout_set_text(digits, &digit, 1);
+      pango_layout_get_pixel_extents(digits, nullptr, &logical);
+      glyphs->cell_width = MAX(glyphs->cell_width, logical.width);
+      glyphs->cell_height = logical.height;
+    }
+    g_object_unref(digits);
   }
 
-  // Text alignment
-  FlValue* al = fl_value_lookup_string(args, "textAlign");
+  cairo_surface_t*& cell = glyphs->cells[c];
+  if (cell == nullptr) {
+    PangoLayout* layout =
+        pango_layout_new(gtk_widget_get_pango_context(pip->drawing_area));
+    pango_layout_set_font_description(layout, shared_font(style.text_size));
+    pango_layout_set_text(layout, &c, 1);
+    PangoRectangle logical;
+    pango_layout_get_pixel_extents(layout, nullptr, &logical);
 
-  if (al && fl_value_get_type(al) == FL_VALUE_TYPE_STRING) {
-    const char* s = fl_value_get_string(al);
-  
-    if (strcmp(s, "left") == 0) {
-      pip_instance->text_align = ALIGN_LEFT;
-    } else if (strcmp(s, "right") == 0) {
-      pip_instance->text_align = ALIGN_RIGHT;
-    } else {
-      pip_instance->text_align = ALIGN_CENTER;
-    }
+    cell = gdk_window_create_similar_image_surface(
+        gtk_widget_get_window(pip->drawing_area), CAIRO_FORMAT_ARGB32,
+        glyphs->cell_width, glyphs->cell_height, scale);
+    cairo_t* cr = cairo_create(cell);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    gdk_cairo_set_source_rgba(cr, &style.bg_color);
+    cairo_paint(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+    gdk_cairo_set_source_rgba(cr, &style.text_color);
+    cairo_move_to(cr, (glyphs->cell_width - logical.width) / 2, 0);
+    pango_cairo_show_layout(cr, layout);
+    cairo_destroy(cr);
+    g_object_unref(layout);
   }
+  return cell;
+}
 
-  FlValue* ratio_val = fl_value_lookup_string(args, "ratio");
-  if (ratio_val && fl_value_get_type(ratio_val) == FL_VALUE_TYPE_LIST
-      && fl_value_get_length(ratio_val) >= 2) {
-        int r1 = fl_value_get_int(fl_value_get_list_value(ratio_val, 0));
-        int r2 = fl_value_get_int(fl_value_get_list_value(ratio_val, 1));
-        if (r1 > 0 && r2 > 0) {
-          int height = 180;
-          int width = height * r1 / r2;          
-          gtk_window_resize(GTK_WINDOW(pip_instance->window), width, height);
-        }
+// Drawing area bounds of clock cells [|first|, |last|).
+static GdkRectangle clock_cells_rect(PipWindow* pip, size_t first,
+                                     size_t last) {
+  const ClockGlyphs& glyphs = pip->glyphs;
+  int w = gtk_widget_get_allocated_width(pip->drawing_area);
+  int h = gtk_widget_get_allocated_height(pip->drawing_area);
+  int total = glyphs.cell_width * static_cast<int>(pip->clock_text.size());
+  int x;
+  switch (pip->style.text_align) {
+    case ALIGN_LEFT:
+      x = kTextPadding;
+      break;
+    case ALIGN_RIGHT:
+      x = w - kTextPadding - total;
+      break;
+    case ALIGN_CENTER:
+    default:
+      x = (w - total) / 2;
+  }
+  GdkRectangle rect = {x + glyphs.cell_width * static_cast<int>(first),
+                       (h - glyphs.cell_height) / 2,
+                       glyphs.cell_width * static_cast<int>(last - first),
+                       glyphs.cell_height};
+  return rect;
+}
+
+// Copies the cells [|first|, |last|) of the clock text onto |cr|.
+static void paint_clock_cells(PipWindow* pip, cairo_t* cr, size_t first,
+                              size_t last) {
+  const std::string& text = pip->clock_text;
+  if (first >= last) {
+    return;
+  }
+  clock_glyph(pip, text[first]);
+  GdkRectangle cells = clock_cells_rect(pip, first, last);
+  cairo_save(cr);
+  cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+  for (size_t i = first; i < last; i++) {
+    int x = cells.x + pip->glyphs.cell_width * static_cast<int>(i - first);
+    cairo_set_source_surface(cr, clock_glyph(pip, text[i]), x, cells.y);
+    cairo_rectangle(cr, x, cells.y, pip->glyphs.cell_width, cells.height);
+    cairo_fill(cr);
   }
+  cairo_restore(cr);
+}
+
+// Paints the background and the paragraphs intersecting rows
+// [|clip_top|, |clip_bottom|) of the surface behind |cr|.
+static void paint_contents(PipWindow* pip, cairo_t* cr, int clip_top,
+                           int clip_bottom) {
+  // Draw background
+  cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+  cairo_set_source_rgba(cr,
+                      pip->style.bg_color.red,
+                      pip->style.bg_color.green,
+                      pip->style.bg_color.blue,
+                      pip->style.bg_color.alpha);
+  cairo_paint(cr);
+  cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
 
-  gtk_widget_queue_draw(pip_instance->drawing_area);
+  double scale = pip->text_scale;
+  if (scale != 1) {
+    // Scaled about the center, as the text block is centered.
+    double cx = pip->layout.width / 2.0;
+    double cy = pip->layout.height / 2.0;
+    cairo_translate(cr, cx, cy);
+    cairo_scale(cr, scale, scale);
+    cairo_translate(cr, -cx, -cy);
+    clip_top = static_cast<int>(std::floor(cy + (clip_top - cy) / scale));
+    clip_bottom =
+        static_cast<int>(std::ceil(cy + (clip_bottom - cy) / scale));
+  }
 
-  auto result = fl_value_new_bool(TRUE);
-  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  if (pip->clock.active()) {
+    paint_clock_cells(pip, cr, 0, pip->clock_text.size());
+    return;
+  }
+
+  // Draw the paragraphs that intersect the repainted area
+  cairo_set_source_rgba(cr,
+    pip->style.text_color.red,
+    pip->style.text_color.green,
+    pip->style.text_color.blue,
+    pip->style.text_color.alpha);
+  TextLayoutCache* layout = &pip->layout;
+  for (size_t i = first_paragraph_below(pip, clip_top);
+       i < layout->positioned; i++) {
+    TextParagraph* paragraph = &layout->paragraphs[i];
+    int top = layout->y + paragraph->top;
+    if (top >= clip_bottom) {
+      break;
+    }
+    cairo_move_to(cr, kTextPadding, top);
+    pango_cairo_show_layout(cr, paragraph_layout(pip, paragraph));
+  }
 }
 
+// Teleprompter mode: band |index| of the text block, rasterized on first
+// use. The band farthest from it is evicted when the cache is full.
+static cairo_surface_t* text_tile(PipWindow* pip, int index) {
+  auto it = pip->tiles.find(index);
+  if (it != pip->tiles.end()) {
+    return it->second;
+  }
 
-FlMethodResponse* start_pip() {
-  if (pip_instance) {
-    gtk_widget_show_all(pip_instance->window);
-    // Position in center
-    gtk_window_set_position(GTK_WINDOW(pip_instance->window), GTK_WIN_POS_CENTER);
-    g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
-    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  int w = pip->backing_width;
+  int h = pip->backing_height;
+  int top = index * h;
+  extend_layout(pip, top + h);
+  cairo_surface_t* tile = gdk_window_create_similar_image_surface(
+      gtk_widget_get_window(pip->drawing_area), CAIRO_FORMAT_ARGB32, w, h,
+      gtk_widget_get_scale_factor(pip->drawing_area));
+  cairo_t* cr = cairo_create(tile);
+  cairo_translate(cr, 0, -top);
+  paint_contents(pip, cr, top, top + h);
+  cairo_destroy(cr);
+
+  while (pip->tiles.size() >= kMaxTextTiles) {
+    auto farthest = pip->tiles.begin();
+    if (index - farthest->first < pip->tiles.rbegin()->first - index) {
+      farthest = std::prev(pip->tiles.end());
+    }
+    cairo_surface_destroy(farthest->second);
+    pip->tiles.erase(farthest);
   }
-  g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
-  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  pip->tiles[index] = tile;
+  return tile;
 }
 
-FlMethodResponse* stop_pip() {
-  if (pip_instance) {
-    gtk_widget_hide(pip_instance->window);
-    
-    // Notify Flutter that PiP was stopped
-    if (pip_instance->method_channel != nullptr) {
-      g_autoptr(FlValue) notify_result = fl_value_new_bool(TRUE);
-      fl_method_channel_invoke_method(pip_instance->method_channel, "pipStopped", notify_result, nullptr, nullptr, nullptr);
+// Renders background and text into the backing surface, (re)allocating it
+// to match the drawing area. When |clip| is set and the surface is reused,
+// only that area is repainted. Does nothing until the widget is realized;
+// the first expose will render instead.
+static void render_backing(PipWindow* pip, const GdkRectangle* clip) {
+  GdkWindow* gdk_window = gtk_widget_get_window(pip->drawing_area);
+  if (gdk_window == nullptr) {
+    pip->backing_dirty = true;
+    return;
+  }
+
+  int w = gtk_widget_get_allocated_width(pip->drawing_area);
+  int h = gtk_widget_get_allocated_height(pip->drawing_area);
+  int scale = gtk_widget_get_scale_factor(pip->drawing_area);
+  ensure_layout(pip, w, h);
+
+  if (pip->teleprompter) {
+    // The bands are rasterized again as the viewport reaches them.
+    clear_tiles(pip);
+    if (pip->backing != nullptr) {
+      cairo_surface_destroy(pip->backing);
+      pip->backing = nullptr;
     }
-    
-    g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
-    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    pip->backing_width = w;
+    pip->backing_height = h;
+    pip->backing_dirty = false;
+    return;
   }
-  g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
-  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+
+  if (pip->backing == nullptr || pip->backing_width != w ||
+      pip->backing_height != h) {
+    if (pip->backing != nullptr) {
+      cairo_surface_destroy(pip->backing);
+    }
+    pip->backing = gdk_window_create_similar_image_surface(
+        gdk_window, CAIRO_FORMAT_ARGB32, w, h, scale);
+    pip->backing_width = w;
+    pip->backing_height = h;
+    clip = nullptr;
+  }
+
+  cairo_t* cr = cairo_create(pip->backing);
+  if (clip != nullptr) {
+    gdk_cairo_rectangle(cr, clip);
+    cairo_clip(cr);
+  }
+  paint_contents(pip, cr, clip != nullptr ? clip->y : 0,
+                 clip != nullptr ? clip->y + clip->height : h);
+  cairo_destroy(cr);
+  pip->backing_dirty = false;
 }
 
-FlMethodResponse* is_pip_supported() {
-  // PiP is supported on Linux
-  g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
-  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+static void pip_window_set_text(PipWindow* pip, const char* text,
+                                size_t length);
+static void pip_window_set_text(PipWindow* pip, const char* text);
+
+// Splices in the text of a pending updateText without rendering it.
+static void apply_pending_text(PipWindow* pip) {
+  if (!pip->text_pending) {
+    return;
+  }
+  std::string text;
+  text.swap(pip->pending_text);
+  pip->text_pending = false;
+  pip->batch_depth++;
+  pip_window_set_text(pip, text.data(), text.size());
+  pip->batch_depth--;
 }
 
-FlMethodResponse* update_text(FlValue* args) {
-  if (pip_instance && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
-    FlValue* text_value = fl_value_lookup_string(args, "text");
-    if (text_value != nullptr && fl_value_get_type(text_value) == FL_VALUE_TYPE_STRING) {
-      pip_instance->current_text = fl_value_get_string(text_value);
-      gtk_widget_queue_draw(pip_instance->drawing_area);
-      g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
-      return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+// Counts |count| updates for getStats, before they are applied. All but
+// the first share a frame, and so does the first if one is still owed.
+static void pip_window_note_updates(PipWindow* pip, guint64 count) {
+  if (count == 0 || pip->batch_depth > 0) {
+    return;
+  }
+  bool owed = pip->refresh_full || pip->refresh_text || pip->text_pending;
+  pip->stats.updates += count;
+  pip->stats.superseded += owed ? count : count - 1;
+}
+
+// Renders the refresh owed to the window. A text-only change repaints and
+// invalidates just the union of the previous and new text ink extents.
+static void pip_window_render_pending(PipWindow* pip) {
+  if (pip->flush_tick_id != 0) {
+    gtk_widget_remove_tick_callback(pip->drawing_area, pip->flush_tick_id);
+    pip->flush_tick_id = 0;
+  }
+  apply_pending_text(pip);
+  if (pip->refresh_full || pip->refresh_text) {
+    pip->stats.frames++;
+  }
+  // The ink rects of the text do not account for a size tween's scale.
+  if (pip->refresh_full || (pip->refresh_text && pip->text_scale != 1)) {
+    render_backing(pip, nullptr);
+    gtk_widget_queue_draw(pip->drawing_area);
+  } else if (pip->refresh_text) {
+    int w = gtk_widget_get_allocated_width(pip->drawing_area);
+    int h = gtk_widget_get_allocated_height(pip->drawing_area);
+    ensure_layout(pip, w, h);
+    GdkRectangle damage;
+    GdkRectangle new_rect = text_ink_rect(&pip->layout);
+    gdk_rectangle_union(&pip->text_damage, &new_rect, &damage);
+
+    GdkRectangle bounds = {0, 0, w, h};
+    if (gdk_rectangle_intersect(&damage, &bounds, &damage)) {
+      render_backing(pip, &damage);
+      gtk_widget_queue_draw_area(pip->drawing_area, damage.x, damage.y,
+                                 damage.width, damage.height);
     }
   }
-  g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
-  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  pip->refresh_full = false;
+  pip->refresh_text = false;
 }
 
-FlMethodResponse* get_platform_version() {
-  struct utsname uname_data = {};
-  uname(&uname_data);
-  g_autofree gchar *version = g_strdup_printf("Linux %s", uname_data.version);
-  g_autoptr(FlValue) result = fl_value_new_string(version);
-  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+static gboolean flush_tick_callback(GtkWidget* widget,
+                                    GdkFrameClock* frame_clock,
+                                    gpointer data) {
+  PipWindow* pip = static_cast<PipWindow*>(data);
+  pip->flush_tick_id = 0;
+  pip_window_render_pending(pip);
+  return G_SOURCE_REMOVE;
 }
 
-// Called when a method call is received from Flutter.
-static void pip_plugin_handle_method_call(
-    PipPlugin* self,
-    FlMethodCall* method_call,
-    FlMethodChannel* channel) {
-  g_autoptr(FlMethodResponse) response = nullptr;
+// Schedules the refresh owed to the window, unless a batch is still open.
+// A mapped window renders it in the update phase of its next frame, so a
+// burst of updates between two frames is rendered once; without frames
+// it is rendered right away.
+static void pip_window_flush(PipWindow* pip) {
+  if (pip->batch_depth > 0 || pip->flush_tick_id != 0) {
+    return;
+  }
+  if (!pip->refresh_full && !pip->refresh_text && !pip->text_pending) {
+    return;
+  }
+  if (gtk_widget_get_mapped(pip->drawing_area)) {
+    pip->flush_tick_id = gtk_widget_add_tick_callback(
+        pip->drawing_area, flush_tick_callback, pip, nullptr);
+  } else {
+    pip_window_render_pending(pip);
+  }
+}
 
-  const gchar* method = fl_method_call_get_name(method_call);
-  FlValue* args = fl_method_call_get_args(method_call);
+// Re-renders the backing surface after a style change and schedules the
+// whole window to pick it up.
+static void pip_window_refresh(PipWindow* pip) {
+  invalidate_layout(pip);
+  pip->refresh_full = true;
+  pip_window_flush(pip);
+}
 
-  if (strcmp(method, "getPlatformVersion") == 0) {
-    response = get_platform_version();
-  } else if (strcmp(method, "setupPip") == 0) {
-    response = setup_pip(args, channel);
-  } else if (strcmp(method, "startPip") == 0) {
-    response = start_pip();
-  } else if (strcmp(method, "stopPip") == 0) {
-    response = stop_pip();
-  } else if (strcmp(method, "isPipSupported") == 0) {
-    response = is_pip_supported();
-  } else if (strcmp(method, "updateText") == 0) {
-    response = update_text(args);
-  } else if (strcmp(method, "updatePip") == 0) {
-    response = update_pip(args);
-  } else {
-    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+// Re-renders after bytes [|start|, |old_end|) of the text were replaced
+// with [|start|, |new_end|).
+static void pip_window_refresh_text(PipWindow* pip, size_t start,
+                                    size_t old_end, size_t new_end) {
+  // The first edit since the last flush records the extents the backing
+  // still shows; later edits in the same batch only move the new extents.
+  if (!pip->refresh_full && !pip->refresh_text) {
+    int w = gtk_widget_get_allocated_width(pip->drawing_area);
+    int h = gtk_widget_get_allocated_height(pip->drawing_area);
+    bool partial = pip->backing != nullptr && !pip->backing_dirty &&
+                   !pip->teleprompter && pip->layout.valid &&
+                   pip->backing_width == w && pip->backing_height == h;
+    if (partial) {
+      pip->text_damage = text_ink_rect(&pip->layout);
+      pip->refresh_text = true;
+    } else {
+      pip->refresh_full = true;
+    }
   }
+  pip->text_generation++;
+  splice_paragraphs(pip, start, old_end, new_end);
+  pip_window_flush(pip);
+}
 
-  fl_method_call_respond(method_call, response, nullptr);
+// Replaces bytes [|start|, |end|) of the text with the |length| bytes at
+// |text| and repaints the affected area.
+static void pip_window_replace_text(PipWindow* pip, size_t start, size_t end,
+                                    const char* text, size_t length) {
+  // Replacing a mapped file as a whole needs no copy of it.
+  unmap_text(pip, start > 0 || end < text_size(pip));
+  pip->current_text.replace(start, end - start, text, length);
+  pip_window_refresh_text(pip, start, end, start + length);
 }
 
-static void pip_plugin_dispose(GObject* object) {
-  // Clean up PiP window if it exists
-  if (pip_instance) {
-    gtk_widget_destroy(pip_instance->window);
-    delete pip_instance;
-    pip_instance = nullptr;
+// Sets the whole text. Only the span between the unchanged head and tail
+// is replaced.
+static void pip_window_set_text(PipWindow* pip, const char* text,
+                                size_t length) {
+  pip->text_pending = false;
+  if (pip->mapped_text != nullptr) {
+    pip_window_replace_text(pip, 0, text_size(pip), text, length);
+    return;
+  }
+  const std::string& current = pip->current_text;
+  size_t prefix = common_prefix_length(current, text, length);
+  size_t suffix = common_suffix_length(current, text, length, prefix);
+  pip_window_replace_text(pip, prefix, current.size() - suffix,
+                          text + prefix, length - prefix - suffix);
+}
+
+static void pip_window_set_text(PipWindow* pip, const char* text) {
+  pip_window_set_text(pip, text, strlen(text));
+}
+
+// Live resize: while the window is being resized, the frame rendered last
+// is scaled to fit the |w| x |h| drawing area, keeping its aspect ratio,
+// and the bars around it are filled with the background. It is rendered
+// at the final size once the resize is over, see on_resize_settled().
+static void paint_scaled_backing(PipWindow* pip, cairo_t* cr, int w, int h) {
+  double scale = MIN(w / static_cast<double>(pip->backing_width),
+                     h / static_cast<double>(pip->backing_height));
+  double x = (w - pip->backing_width * scale) / 2;
+  double y = (h - pip->backing_height * scale) / 2;
+  cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+  gdk_cairo_set_source_rgba(cr, &pip->style.bg_color);
+  cairo_paint(cr);
+  cairo_translate(cr, x, y);
+  cairo_scale(cr, scale, scale);
+  cairo_set_source_surface(cr, pip->backing, 0, 0);
+  // Cheaper than the default filter, which averages when shrinking.
+  cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_BILINEAR);
+  cairo_rectangle(cr, 0, 0, pip->backing_width, pip->backing_height);
+  cairo_fill(cr);
+}
+
+// Cairo drawing callback
+static gboolean draw_callback(GtkWidget *widget, cairo_t *cr, gpointer data) {
+  PipWindow* pip = static_cast<PipWindow*>(data);
+
+  int w = gtk_widget_get_allocated_width(widget);
+  int h = gtk_widget_get_allocated_height(widget);
+  if (pip->teleprompter) {
+    if (pip->backing_dirty || pip->backing_width != w ||
+        pip->backing_height != h) {
+      render_backing(pip, nullptr);
+    }
+    // The scroll offset is fractional; cairo filters the pre-rendered
+    // bands so motion stays smooth below one pixel per frame. Padding the
+    // edges keeps the filter from blending the seams with transparency.
+    for (int i = static_cast<int>(pip->scroll_offset) / MAX(h, 1);
+         h > 0 && i * h < pip->scroll_offset + h; i++) {
+      double y = i * h - pip->scroll_offset;
+      cairo_set_source_surface(cr, text_tile(pip, i), 0, y);
+      cairo_pattern_set_extend(cairo_get_source(cr), CAIRO_EXTEND_PAD);
+      cairo_rectangle(cr, 0, y, w, h);
+      cairo_fill(cr);
+    }
+  } else if (pip->resize_settle_id != 0 && pip->backing != nullptr &&
+             !pip->backing_dirty && pip->backing_width > 0 &&
+             pip->backing_height > 0 &&
+             (pip->backing_width != w || pip->backing_height != h)) {
+    paint_scaled_backing(pip, cr, w, h);
+  } else {
+    if (pip->backing_dirty || pip->backing == nullptr ||
+        pip->backing_width != w || pip->backing_height != h) {
+      render_backing(pip, nullptr);
+    }
+    cairo_set_source_surface(cr, pip->backing, 0, 0);
+    cairo_paint(cr);
+  }
+
+  if (pip->show_time != 0) {
+    pip->stats.first_frame_us = g_get_monotonic_time() - pip->show_time;
+    pip->show_time = 0;
+  }
+
+  return FALSE;
+}
+
+// Frame clock tick advancing the teleprompter. Moves the offset, lays out
+// the paragraphs coming into view and rasterizes the band below the
+// viewport ahead of the frame that shows it.
+static gboolean scroll_tick_callback(GtkWidget* widget,
+                                     GdkFrameClock* frame_clock,
+                                     gpointer data) {
+  PipWindow* pip = static_cast<PipWindow*>(data);
+  gint64 now = gdk_frame_clock_get_frame_time(frame_clock);
+  int w = gtk_widget_get_allocated_width(widget);
+  int h = gtk_widget_get_allocated_height(widget);
+  ensure_layout(pip, w, h);
+  if (pip->scroll_last_time != 0) {
+    double dt = (now - pip->scroll_last_time) / (double)G_USEC_PER_SEC;
+    pip->scroll_offset += pip->style.scroll_speed * dt;
+    extend_layout(pip, static_cast<int>(pip->scroll_offset) + 2 * h);
+    // The end is known once the whole block is laid out.
+    TextLayoutCache* layout = &pip->layout;
+    if (layout->positioned == layout->paragraphs.size() &&
+        pip->scroll_offset > MAX(layout->block_height - h, 0)) {
+      pip->scroll_offset = 0;
+    }
+    release_layouts_above(pip, static_cast<int>(pip->scroll_offset) - h);
+  }
+  pip->scroll_last_time = now;
+  if (h > 0 && !pip->backing_dirty && pip->backing_width == w &&
+      pip->backing_height == h) {
+    text_tile(pip, static_cast<int>(pip->scroll_offset) / h + 2);
+  }
+  gtk_widget_queue_draw(widget);
+  return G_SOURCE_CONTINUE;
+}
+
+static void start_scrolling(PipWindow* pip) {
+  if (pip->scroll_tick_id != 0) {
+    return;
+  }
+  pip->scroll_last_time = 0;
+  pip->scroll_tick_id = gtk_widget_add_tick_callback(
+      pip->drawing_area, scroll_tick_callback, pip, nullptr);
+}
+
+static void stop_scrolling(PipWindow* pip) {
+  if (pip->scroll_tick_id == 0) {
+    return;
+  }
+  gtk_widget_remove_tick_callback(pip->drawing_area, pip->scroll_tick_id);
+  pip->scroll_tick_id = 0;
+}
+
+// Updates staged by the pip_plugin_ffi_* entry points, which may run on
+// any thread. A burst of calls only rewrites this state; a single idle
+// callback applies the newest one on the main thread. The two strings
+// swap buffers so steady streaming does not allocate.
+struct FfiUpdate {
+  GMutex mutex;
+  bool scheduled;
+  // Calls staged since the last apply, for getStats.
+  guint64 staged;
+  // |text| replaces the current text rather than being appended to it.
+  bool replace;
+  bool redraw;
+  std::string text;
+  std::string applying;
+};
+
+static FfiUpdate ffi_update;
+
+// Applies an update coalesced on the FFI side with a single repaint: |text|
+// replaces the current text if |replace| is set and is appended otherwise.
+static void apply_coalesced_update(PipWindow* pip, const std::string& text,
+                                   bool replace, bool redraw) {
+  pip->batch_depth++;
+  if (replace) {
+    pip_window_set_text(pip, text.c_str());
+  } else if (!text.empty()) {
+    apply_pending_text(pip);
+    size_t end = text_size(pip);
+    pip_window_replace_text(pip, end, end, text.data(), text.size());
+  }
+  if (redraw) {
+    invalidate_layout(pip);
+    pip->refresh_full = true;
+  }
+  pip->batch_depth--;
+  pip_window_flush(pip);
+}
+
+static gboolean apply_ffi_update(gpointer data) {
+  g_mutex_lock(&ffi_update.mutex);
+  ffi_update.applying.swap(ffi_update.text);
+  bool replace = ffi_update.replace;
+  bool redraw = ffi_update.redraw;
+  guint64 staged = ffi_update.staged;
+  ffi_update.replace = false;
+  ffi_update.redraw = false;
+  ffi_update.scheduled = false;
+  ffi_update.staged = 0;
+  g_mutex_unlock(&ffi_update.mutex);
+
+  if (pip_instance != nullptr) {
+    pip_window_note_updates(pip_instance, staged);
+    apply_coalesced_update(pip_instance, ffi_update.applying, replace, redraw);
+  }
+  ffi_update.applying.clear();
+  return G_SOURCE_REMOVE;
+}
+
+// Must be called with the mutex held. Runs ahead of GDK's redraw so the
+// update lands in the next frame.
+static void schedule_ffi_update() {
+  ffi_update.staged++;
+  if (!ffi_update.scheduled) {
+    ffi_update.scheduled = true;
+    g_idle_add_full(G_PRIORITY_DEFAULT, apply_ffi_update, nullptr, nullptr);
+  }
+}
+
+void pip_plugin_ffi_set_text(const char* text) {
+  g_mutex_lock(&ffi_update.mutex);
+  ffi_update.text.assign(text);
+  ffi_update.replace = true;
+  schedule_ffi_update();
+  g_mutex_unlock(&ffi_update.mutex);
+}
+
+void pip_plugin_ffi_append_text(const char* text) {
+  g_mutex_lock(&ffi_update.mutex);
+  ffi_update.text.append(text);
+  schedule_ffi_update();
+  g_mutex_unlock(&ffi_update.mutex);
+}
+
+void pip_plugin_ffi_request_redraw() {
+  g_mutex_lock(&ffi_update.mutex);
+  ffi_update.redraw = true;
+  schedule_ffi_update();
+  g_mutex_unlock(&ffi_update.mutex);
+}
+
+// Created by the producer's first pip_plugin_ffi_ring_open(). The consumer
+// only touches it after a wake-up, which happens after creation.
+static std::atomic<TextRing*> text_ring{nullptr};
+static std::string ring_text;
+
+// Drains the ring and applies what it held. Returns false once the ring is
+// empty and the consumer went idle.
+static bool drain_text_ring() {
+  TextRing* ring = text_ring.load();
+  bool replace = false;
+  size_t records = ring->Drain(&ring_text, &replace);
+  if (records == 0) {
+    return !ring->Sleep();
+  }
+  if (pip_instance != nullptr) {
+    pip_window_note_updates(pip_instance, records);
+    apply_coalesced_update(pip_instance, ring_text, replace, false);
+  }
+  ring_text.clear();
+  return true;
+}
+
+static gboolean ring_tick_callback(GtkWidget* widget,
+                                   GdkFrameClock* frame_clock,
+                                   gpointer data) {
+  PipWindow* pip = static_cast<PipWindow*>(data);
+  if (drain_text_ring()) {
+    // Already in this frame's update phase; render without waiting for
+    // the next one.
+    pip_window_render_pending(pip);
+    return G_SOURCE_CONTINUE;
+  }
+  pip->ring_tick_id = 0;
+  return G_SOURCE_REMOVE;
+}
+
+// Without a mapped window there are no frames to pace by, so the ring is
+// drained right away.
+static void drain_text_ring_now(PipWindow* pip) {
+  if (pip != nullptr && pip->ring_tick_id != 0) {
+    gtk_widget_remove_tick_callback(pip->drawing_area, pip->ring_tick_id);
+    pip->ring_tick_id = 0;
+  }
+  while (drain_text_ring()) {
+  }
+}
+
+static gboolean wake_ring_consumer(gpointer data) {
+  if (pip_instance != nullptr &&
+      gtk_widget_get_mapped(pip_instance->drawing_area)) {
+    if (pip_instance->ring_tick_id == 0) {
+      pip_instance->ring_tick_id = gtk_widget_add_tick_callback(
+          pip_instance->drawing_area, ring_tick_callback, pip_instance,
+          nullptr);
+    }
+  } else {
+    drain_text_ring_now(pip_instance);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+// Hiding the window stops its frame clock; finish draining and render
+// the owed repaint without it.
+static void on_drawing_area_unmap(GtkWidget* widget, gpointer data) {
+  PipWindow* pip = static_cast<PipWindow*>(data);
+  if (pip->ring_tick_id != 0) {
+    drain_text_ring_now(pip);
+  }
+  if (pip->flush_tick_id != 0) {
+    pip_window_render_pending(pip);
+  }
+}
+
+uint8_t* pip_plugin_ffi_ring_open(uint32_t capacity) {
+  g_mutex_lock(&ffi_update.mutex);
+  if (text_ring.load() == nullptr) {
+    text_ring.store(new TextRing(capacity));
+  }
+  g_mutex_unlock(&ffi_update.mutex);
+  return text_ring.load()->data();
+}
+
+uint32_t pip_plugin_ffi_ring_capacity() {
+  TextRing* ring = text_ring.load();
+  return ring != nullptr ? ring->capacity() : 0;
+}
+
+uint64_t pip_plugin_ffi_ring_read_index() {
+  TextRing* ring = text_ring.load();
+  return ring != nullptr ? ring->read_index() : 0;
+}
+
+uint64_t pip_plugin_ffi_ring_write_index() {
+  TextRing* ring = text_ring.load();
+  return ring != nullptr ? ring->write_index() : 0;
+}
+
+void pip_plugin_ffi_ring_publish(uint64_t write_index) {
+  TextRing* ring = text_ring.load();
+  if (ring != nullptr && ring->Publish(write_index)) {
+    g_idle_add_full(G_PRIORITY_DEFAULT, wake_ring_consumer, nullptr, nullptr);
+  }
+}
+
+// Create menu bar
+static GtkWidget* create_menu_bar() {
+  GtkWidget* menu_bar = gtk_menu_bar_new();
+  return menu_bar;
+}
+
+// Tells Flutter that the window |pip| was closed or stopped.
+static void notify_pip_stopped(PipWindow* pip) {
+  if (pip->method_channel != nullptr) {
+    g_autoptr(FlValue) args = fl_value_new_map();
+    fl_value_set_string_take(args, "id", fl_value_new_int(pip->id));
+    fl_method_channel_invoke_method(pip->method_channel, "pipStopped", args,
+                                    nullptr, nullptr, nullptr);
+  }
+}
+
+// Handler for window close event
+static gboolean on_window_close(GtkWidget* widget, GdkEvent* event, gpointer data) {
+  PipWindow* pip = static_cast<PipWindow*>(data);
+  
+  // Notify Flutter that PiP was closed
+  notify_pip_stopped(pip);
+  
+  // Hide window instead of destroying it
+  gtk_widget_hide(widget);
+  
+  // Return TRUE to prevent the window from being destroyed automatically
+  return TRUE;
+}
+
+// A resize counts as over once no configure-event changed the size for
+// this long; an interactive drag sends one per pointer motion. Until then
+// draw_callback() only scales the last frame.
+static const guint kResizeSettleMs = 150;
+
+// Renders the frame scaled during the resize at the final size, fitted to
+// it in auto-fit mode.
+static gboolean on_resize_settled(gpointer data) {
+  PipWindow* pip = static_cast<PipWindow*>(data);
+  pip->resize_settle_id = 0;
+  int w = gtk_widget_get_allocated_width(pip->drawing_area);
+  int h = gtk_widget_get_allocated_height(pip->drawing_area);
+  if (pip->fit_enabled && (w != pip->fit_width || h != pip->fit_height)) {
+    pip_window_refresh(pip);
+  } else if (w != pip->backing_width || h != pip->backing_height) {
+    pip->refresh_full = true;
+    pip_window_flush(pip);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+// Handler for configure events of the window. Moves keep the size and are
+// ignored, as is the first size, which the window is created with.
+static gboolean on_window_configure(GtkWidget* widget,
+                                    GdkEventConfigure* event, gpointer data) {
+  PipWindow* pip = static_cast<PipWindow*>(data);
+  if (event->width == pip->configure_width &&
+      event->height == pip->configure_height) {
+    return FALSE;
+  }
+  bool first = pip->configure_width == 0 && pip->configure_height == 0;
+  pip->configure_width = event->width;
+  pip->configure_height = event->height;
+  if (first) {
+    return FALSE;
+  }
+  if (pip->resize_settle_id != 0) {
+    g_source_remove(pip->resize_settle_id);
+  }
+  pip->resize_settle_id =
+      g_timeout_add(kResizeSettleMs, on_resize_settled, pip);
+  return FALSE;
+}
+
+// Reads an [r, g, b] or [r, g, b, a] list; alpha defaults to opaque.
+static bool lookup_color(FlValue* args, const char* key, GdkRGBA* color) {
+  FlValue* list = fl_value_lookup_string(args, key);
+  if (list == nullptr || fl_value_get_type(list) != FL_VALUE_TYPE_LIST ||
+      fl_value_get_length(list) < 3) {
+    return false;
+  }
+  int channels[4] = {0, 0, 0, 255};
+  for (size_t i = 0; i < 4 && i < fl_value_get_length(list); i++) {
+    FlValue* channel = fl_value_get_list_value(list, i);
+    if (fl_value_get_type(channel) != FL_VALUE_TYPE_INT) {
+      return false;
+    }
+    channels[i] = fl_value_get_int(channel);
+  }
+  color->red = channels[0] / 255.0;
+  color->green = channels[1] / 255.0;
+  color->blue = channels[2] / 255.0;
+  color->alpha = channels[3] / 255.0;
+  return true;
+}
+
+unsigned parse_style(FlValue* args, PipStyle* style) {
+  unsigned dirty = 0;
+  if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return dirty;
+  }
+
+  GdkRGBA color;
+  if (lookup_color(args, "backgroundColor", &color) &&
+      !gdk_rgba_equal(&color, &style->bg_color)) {
+    style->bg_color = color;
+    dirty |= STYLE_BG_COLOR;
+  }
+  if (lookup_color(args, "textColor", &color) &&
+      !gdk_rgba_equal(&color, &style->text_color)) {
+    style->text_color = color;
+    dirty |= STYLE_TEXT_COLOR;
+  }
+
+  FlValue* size_val = fl_value_lookup_string(args, "textSize");
+  if (size_val && fl_value_get_type(size_val) == FL_VALUE_TYPE_FLOAT &&
+      fl_value_get_float(size_val) != style->text_size) {
+    style->text_size = fl_value_get_float(size_val);
+    dirty |= STYLE_TEXT_SIZE;
+  }
+
+  FlValue* al = fl_value_lookup_string(args, "textAlign");
+  if (al && fl_value_get_type(al) == FL_VALUE_TYPE_STRING) {
+    const char* s = fl_value_get_string(al);
+    TextAlign align = ALIGN_CENTER;
+    if (strcmp(s, "left") == 0) {
+      align = ALIGN_LEFT;
+    } else if (strcmp(s, "right") == 0) {
+      align = ALIGN_RIGHT;
+    }
+    if (align != style->text_align) {
+      style->text_align = align;
+      dirty |= STYLE_TEXT_ALIGN;
+    }
+  }
+
+  FlValue* speed_val = fl_value_lookup_string(args, "speed");
+  if (speed_val && fl_value_get_type(speed_val) == FL_VALUE_TYPE_FLOAT &&
+      fl_value_get_float(speed_val) != style->scroll_speed) {
+    style->scroll_speed = fl_value_get_float(speed_val);
+    dirty |= STYLE_SPEED;
+  }
+
+  FlValue* ratio_val = fl_value_lookup_string(args, "ratio");
+  if (ratio_val && fl_value_get_type(ratio_val) == FL_VALUE_TYPE_LIST &&
+      fl_value_get_length(ratio_val) >= 2) {
+    FlValue* r1 = fl_value_get_list_value(ratio_val, 0);
+    FlValue* r2 = fl_value_get_list_value(ratio_val, 1);
+    if (fl_value_get_type(r1) == FL_VALUE_TYPE_INT &&
+        fl_value_get_type(r2) == FL_VALUE_TYPE_INT &&
+        fl_value_get_int(r1) > 0 && fl_value_get_int(r2) > 0 &&
+        (fl_value_get_int(r1) != style->ratio_width ||
+         fl_value_get_int(r2) != style->ratio_height)) {
+      style->ratio_width = fl_value_get_int(r1);
+      style->ratio_height = fl_value_get_int(r2);
+      dirty |= STYLE_RATIO;
+    }
+  }
+
+  return dirty;
+}
+
+// Updates only what the StyleField bits |dirty| invalidate. Colors are
+// applied when painting, so a color change repaints with the existing
+// layouts; only size and alignment re-wrap the text.
+static void pip_window_apply_style(PipWindow* pip, unsigned dirty) {
+  if (dirty & STYLE_RATIO) {
+    int height = 180;
+    int width = height * pip->style.ratio_width / pip->style.ratio_height;
+    gtk_window_resize(GTK_WINDOW(pip->window), width, height);
+  }
+  if (dirty & (STYLE_TEXT_SIZE | STYLE_TEXT_ALIGN)) {
+    pip_window_refresh(pip);
+  } else if (dirty & (STYLE_BG_COLOR | STYLE_TEXT_COLOR)) {
+    pip->refresh_full = true;
+    pip_window_flush(pip);
+  }
+}
+
+// Creates a window configured from the setupPip |args| and registers it.
+static PipWindow* pip_window_new(FlValue* args,
+                                 FlMethodChannel* method_channel) {
+  PipWindow* pip = new PipWindow();
+  pip->id = next_window_id++;
+  pip->method_channel = method_channel;
+  pip->cue_index = CueTrack::kNoCue;
+  pip->tail_fd = -1;
+  pip->source_fd = -1;
+  pip->client_fd = -1;
+  pip->text_scale = 1;
+  pip_windows[pip->id] = pip;
+  
+  // Create main window
+  pip->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+  gtk_window_set_title(GTK_WINDOW(pip->window), "PiP Window");
+  gtk_window_set_default_size(GTK_WINDOW(pip->window), 320, 240);
+  gtk_window_set_keep_above(GTK_WINDOW(pip->window), TRUE);
+  
+  // Connect the delete-event signal to handle window close
+  g_signal_connect(pip->window, "delete-event", 
+      G_CALLBACK(on_window_close), pip);
+  g_signal_connect(pip->window, "configure-event",
+      G_CALLBACK(on_window_configure), pip);
+  
+  // Create container
+  GtkWidget* box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+  
+  // Add menu bar
+  pip->menu_bar = create_menu_bar();
+  gtk_box_pack_start(GTK_BOX(box), pip->menu_bar, FALSE, FALSE, 0);
+  
+  // Add drawing area
+  pip->drawing_area = gtk_drawing_area_new();
+  gtk_box_pack_start(GTK_BOX(box), pip->drawing_area, TRUE, TRUE, 0);
+  g_signal_connect(pip->drawing_area, "draw", 
+      G_CALLBACK(draw_callback), pip);
+  g_signal_connect(pip->drawing_area, "unmap",
+      G_CALLBACK(on_drawing_area_unmap), pip);
+  
+  gtk_container_add(GTK_CONTAINER(pip->window), box);
+  
+  // Default background color (black with 80% opacity)
+  pip->style.bg_color = {0, 0, 0, 0.8};
+
+  pip->style.text_color = {1, 1, 1, 1.0};
+
+  pip->style.text_align = ALIGN_CENTER;
+
+  pip->style.text_size = 32.0;
+
+  pip->style.scroll_speed = 30.0;
+  
+  // Get parameters
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    FlValue* window_title = fl_value_lookup_string(args, "windowTitle");
+    if (window_title != nullptr && fl_value_get_type(window_title) == FL_VALUE_TYPE_STRING) {
+      gtk_window_set_title(GTK_WINDOW(pip->window), fl_value_get_string(window_title));
+    }
+
+    // Set text
+    FlValue* text_value = fl_value_lookup_string(args, "text");
+    if (text_value != nullptr && fl_value_get_type(text_value) == FL_VALUE_TYPE_STRING) {
+      pip->current_text = fl_value_get_string(text_value);
+    }
+
+    parse_style(args, &pip->style);
+    const PipStyle& style = pip->style;
+    if (style.ratio_width > 0) {
+      int height = 180;
+      int width = height * style.ratio_width / style.ratio_height;
+      gtk_window_set_default_size(GTK_WINDOW(pip->window), width, height);
+    }
+  }
+  
+  // Window controls
+  gtk_window_set_deletable(GTK_WINDOW(pip->window), TRUE);
+  gtk_window_set_resizable(GTK_WINDOW(pip->window), TRUE);
+  gtk_window_set_skip_taskbar_hint(GTK_WINDOW(pip->window), FALSE);
+  return pip;
+}
+
+// Realizes the hidden window at its default size and renders its first
+// frame, so startPip only maps it and blits the backing surface. Closing
+// the window hides it, so it stays warm until destroyPip.
+static void pip_window_prewarm(PipWindow* pip) {
+  if (gtk_widget_get_realized(pip->drawing_area)) {
+    return;
+  }
+  gtk_widget_show_all(gtk_bin_get_child(GTK_BIN(pip->window)));
+  gtk_widget_realize(pip->drawing_area);
+
+  GtkAllocation allocation = {0, 0, 0, 0};
+  gtk_window_get_default_size(GTK_WINDOW(pip->window), &allocation.width,
+                              &allocation.height);
+  gtk_widget_get_preferred_size(pip->window, nullptr, nullptr);
+  gtk_widget_size_allocate(pip->window, &allocation);
+  render_backing(pip, nullptr);
+}
+
+static bool pip_window_stop_tail(PipWindow* pip);
+static bool pip_window_close_source(PipWindow* pip);
+static unsigned pip_window_stop_animation(PipWindow* pip);
+
+// Destroys the window |pip| and forgets it.
+static void pip_window_free(PipWindow* pip) {
+  stop_scrolling(pip);
+  pip_window_stop_tail(pip);
+  pip_window_close_source(pip);
+  pip_window_stop_animation(pip);
+  if (pip->flush_tick_id != 0) {
+    gtk_widget_remove_tick_callback(pip->drawing_area, pip->flush_tick_id);
+    pip->flush_tick_id = 0;
+  }
+  if (pip->ring_tick_id != 0) {
+    gtk_widget_remove_tick_callback(pip->drawing_area, pip->ring_tick_id);
+    pip->ring_tick_id = 0;
+  }
+  if (pip->clock_tick_id != 0) {
+    gtk_widget_remove_tick_callback(pip->drawing_area, pip->clock_tick_id);
+    pip->clock_tick_id = 0;
+  }
+  if (pip->cue_timeout_id != 0) {
+    g_source_remove(pip->cue_timeout_id);
+    pip->cue_timeout_id = 0;
+  }
+  if (pip->resize_settle_id != 0) {
+    g_source_remove(pip->resize_settle_id);
+    pip->resize_settle_id = 0;
+  }
+  g_clear_object(&pip->fit_layout);
+  gtk_widget_destroy(pip->window);
+  clear_layout(pip);
+  unmap_text(pip, false);
+  clear_clock_glyphs(pip);
+  pip_windows.erase(pip->id);
+  if (pip == pip_instance) {
+    pip_instance = nullptr;
+  }
+  delete pip;
+}
+
+bool find_window(FlValue* args, PipWindow** pip) {
+  *pip = pip_instance;
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return true;
+  }
+  FlValue* id_value = fl_value_lookup_string(args, "id");
+  if (id_value == nullptr || fl_value_get_type(id_value) != FL_VALUE_TYPE_INT) {
+    return true;
+  }
+  auto it = pip_windows.find(fl_value_get_int(id_value));
+  *pip = it != pip_windows.end() ? it->second : nullptr;
+  return *pip != nullptr;
+}
+
+FlMethodResponse* setup_pip(FlValue* args, FlMethodChannel* method_channel) {
+  // Without newWindow the default window is created once and reused, so
+  // setupPip stays idempotent across hot restarts.
+  bool new_window = false;
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    FlValue* new_window_value = fl_value_lookup_string(args, "newWindow");
+    new_window = new_window_value != nullptr &&
+                 fl_value_get_type(new_window_value) == FL_VALUE_TYPE_BOOL &&
+                 fl_value_get_bool(new_window_value);
+  }
+  PipWindow* pip = new_window ? nullptr : pip_instance;
+  if (pip == nullptr) {
+    pip = pip_window_new(args, method_channel);
+    if (pip_instance == nullptr) {
+      pip_instance = pip;
+    }
+  }
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    FlValue* prewarm_value = fl_value_lookup_string(args, "prewarm");
+    if (prewarm_value != nullptr &&
+        fl_value_get_type(prewarm_value) == FL_VALUE_TYPE_BOOL &&
+        fl_value_get_bool(prewarm_value)) {
+      pip_window_prewarm(pip);
+    }
+  }
+  
+  g_autoptr(FlValue) result = fl_value_new_int(pip->id);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* destroy_pip(PipWindow* pip) {
+  if (pip) {
+    notify_pip_stopped(pip);
+    pip_window_free(pip);
+    g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* update_pip(PipWindow* pip, FlValue* args) {
+  if (!pip || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    auto result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  pip_window_note_updates(pip, 1);
+  // The values set now replace those of a running animation.
+  unsigned dirty = pip_window_stop_animation(pip);
+  dirty |= parse_style(args, &pip->style);
+  if (pip->fit_enabled && (dirty & STYLE_TEXT_SIZE)) {
+    // Shown again once auto-fit is turned off.
+    pip->fit_base_size = pip->style.text_size;
+  }
+  pip_window_apply_style(pip, dirty);
+
+  auto result = fl_value_new_bool(TRUE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+
+FlMethodResponse* start_pip(PipWindow* pip) {
+  if (pip) {
+    if (!gtk_widget_get_visible(pip->window)) {
+      pip->show_time = g_get_monotonic_time();
+    }
+    gtk_widget_show_all(pip->window);
+    // Position in center
+    gtk_window_set_position(GTK_WINDOW(pip->window), GTK_WIN_POS_CENTER);
+    g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* stop_pip(PipWindow* pip) {
+  if (pip) {
+    gtk_widget_hide(pip->window);
+    
+    // Notify Flutter that PiP was stopped
+    notify_pip_stopped(pip);
+    
+    g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* is_pip_supported() {
+  // PiP is supported on Linux
+  g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* update_text(PipWindow* pip, FlValue* args) {
+  if (pip && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    FlValue* text_value = fl_value_lookup_string(args, "text");
+    if (text_value != nullptr && fl_value_get_type(text_value) == FL_VALUE_TYPE_STRING) {
+      // Stored until the next frame; a newer text replaces it unseen.
+      pip_window_note_updates(pip, 1);
+      pip->pending_text = fl_value_get_string(text_value);
+      pip->text_pending = true;
+      pip_window_flush(pip);
+      g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+      return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    }
+  }
+  g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* append_text(PipWindow* pip, FlValue* args) {
+  if (pip && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    FlValue* text_value = fl_value_lookup_string(args, "text");
+    if (text_value != nullptr && fl_value_get_type(text_value) == FL_VALUE_TYPE_STRING) {
+      const gchar* text = fl_value_get_string(text_value);
+      pip_window_note_updates(pip, 1);
+      apply_pending_text(pip);
+      size_t end = text_size(pip);
+      pip_window_replace_text(pip, end, end, text, strlen(text));
+      g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+      return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    }
+  }
+  g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* replace_range(PipWindow* pip, FlValue* args) {
+  FlValue* start_value = nullptr;
+  FlValue* end_value = nullptr;
+  FlValue* text_value = nullptr;
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    start_value = fl_value_lookup_string(args, "start");
+    end_value = fl_value_lookup_string(args, "end");
+    text_value = fl_value_lookup_string(args, "text");
+  }
+  // The range must satisfy 0 <= start <= end, as RangeError.checkValidRange
+  // enforces on the Dart side; offsets past the text are clamped.
+  if (start_value == nullptr ||
+      fl_value_get_type(start_value) != FL_VALUE_TYPE_INT ||
+      end_value == nullptr ||
+      fl_value_get_type(end_value) != FL_VALUE_TYPE_INT ||
+      text_value == nullptr ||
+      fl_value_get_type(text_value) != FL_VALUE_TYPE_STRING ||
+      fl_value_get_int(start_value) < 0 ||
+      fl_value_get_int(end_value) < fl_value_get_int(start_value)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid_argument", "Expected text and a valid range", nullptr));
+  }
+  if (!pip) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+
+  pip_window_note_updates(pip, 1);
+  apply_pending_text(pip);
+  unmap_text(pip, true);
+  // Dart indexes strings in UTF-16 code units.
+  const std::string& current = pip->current_text;
+  size_t start =
+      utf16_index_to_byte_offset(current, fl_value_get_int(start_value));
+  size_t end = utf16_index_to_byte_offset(current, fl_value_get_int(end_value));
+  const gchar* text = fl_value_get_string(text_value);
+  pip_window_replace_text(pip, start, end, text, strlen(text));
+  g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* load_text_file(PipWindow* pip, FlValue* args) {
+  FlValue* path_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                            ? fl_value_lookup_string(args, "path")
+                            : nullptr;
+  if (!pip || path_value == nullptr ||
+      fl_value_get_type(path_value) != FL_VALUE_TYPE_STRING) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+
+  GMappedFile* file =
+      g_mapped_file_new(fl_value_get_string(path_value), FALSE, nullptr);
+  if (file == nullptr) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+
+  // The file replaces the text as a whole. Only its line breaks are
+  // scanned now; paragraphs are shaped when they are first shown.
+  pip_window_note_updates(pip, 1);
+  pip->text_pending = false;
+  pip->pending_text.clear();
+  size_t old_size = text_size(pip);
+  unmap_text(pip, false);
+  pip->current_text.clear();
+  pip->mapped_text = file;
+  pip_window_refresh_text(pip, 0, old_size, text_size(pip));
+
+  g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* clear_text(PipWindow* pip) {
+  if (pip) {
+    pip_window_note_updates(pip, 1);
+    pip->text_pending = false;
+    pip->pending_text.clear();
+    pip_window_replace_text(pip, 0, text_size(pip), "", 0);
+    g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Shows |text| as the clock. When only digits changed over a current
+// backing, just the span of changed cells is copied from the glyph cache
+// and invalidated; otherwise the whole window is rendered again.
+static void pip_window_set_clock_text(PipWindow* pip, const std::string& text) {
+  int w = gtk_widget_get_allocated_width(pip->drawing_area);
+  int h = gtk_widget_get_allocated_height(pip->drawing_area);
+  // A clock of another shape is fitted again.
+  bool reshaped = pip->fit_enabled &&
+                  clock_shape(text) != clock_shape(pip->clock_text);
+  if (reshaped) {
+    pip->fit.Reset();
+    invalidate_layout(pip);
+  }
+  bool partial = !reshaped && pip->backing != nullptr &&
+                 !pip->backing_dirty && !pip->refresh_full &&
+                 !pip->teleprompter && pip->text_scale == 1 &&
+                 pip->backing_width == w &&
+                 pip->backing_height == h &&
+                 text.size() == pip->clock_text.size();
+  if (!partial) {
+    pip->clock_text = text;
+    pip->refresh_full = true;
+    pip_window_render_pending(pip);
+    return;
+  }
+
+  size_t first = 0;
+  while (first < text.size() && text[first] == pip->clock_text[first]) {
+    first++;
+  }
+  size_t last = text.size();
+  while (last > first && text[last - 1] == pip->clock_text[last - 1]) {
+    last--;
+  }
+  pip->clock_text = text;
+  if (first == last) {
+    return;
+  }
+  cairo_t* cr = cairo_create(pip->backing);
+  paint_clock_cells(pip, cr, first, last);
+  cairo_destroy(cr);
+  GdkRectangle damage = clock_cells_rect(pip, first, last);
+  gtk_widget_queue_draw_area(pip->drawing_area, damage.x, damage.y,
+                             damage.width, damage.height);
+  pip->stats.frames++;
+}
+
+static gboolean clock_tick_callback(GtkWidget* widget,
+                                    GdkFrameClock* frame_clock,
+                                    gpointer data) {
+  PipWindow* pip = static_cast<PipWindow*>(data);
+  std::string text =
+      pip->clock.Text(gdk_frame_clock_get_frame_time(frame_clock));
+  if (text != pip->clock_text) {
+    pip_window_set_clock_text(pip, text);
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+FlMethodResponse* start_clock(PipWindow* pip, FlValue* args) {
+  if (!pip || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+
+  FlValue* countdown_value = fl_value_lookup_string(args, "countdown");
+  FlValue* start_value = fl_value_lookup_string(args, "startMs");
+  FlValue* format_value = fl_value_lookup_string(args, "format");
+  bool countdown = countdown_value != nullptr &&
+                   fl_value_get_type(countdown_value) == FL_VALUE_TYPE_BOOL &&
+                   fl_value_get_bool(countdown_value);
+  int64_t start_ms =
+      start_value != nullptr && fl_value_get_type(start_value) == FL_VALUE_TYPE_INT
+          ? fl_value_get_int(start_value)
+          : 0;
+  const gchar* format =
+      format_value != nullptr && fl_value_get_type(format_value) == FL_VALUE_TYPE_STRING
+          ? fl_value_get_string(format_value)
+          : "";
+
+  // The clock is drawn centered in the window, not scrolled.
+  stop_scrolling(pip);
+  pip->teleprompter = false;
+  pip->scroll_offset = 0;
+
+  pip->clock.Start(countdown, start_ms, format, g_get_monotonic_time());
+  pip->clock_text = pip->clock.Text(g_get_monotonic_time());
+  pip->fit.Reset();
+  pip_window_refresh(pip);
+  if (pip->clock_tick_id == 0) {
+    pip->clock_tick_id = gtk_widget_add_tick_callback(
+        pip->drawing_area, clock_tick_callback, pip, nullptr);
+  }
+
+  g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* stop_clock(PipWindow* pip) {
+  if (!pip || !pip->clock.active()) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  if (pip->clock_tick_id != 0) {
+    gtk_widget_remove_tick_callback(pip->drawing_area, pip->clock_tick_id);
+    pip->clock_tick_id = 0;
+  }
+  pip->clock.Stop();
+  pip->clock_text.clear();
+  clear_clock_glyphs(pip);
+  pip->fit.Reset();
+  pip_window_refresh(pip);
+
+  g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Sets the text to cue |index| of the track, or no text for
+// CueTrack::kNoCue, without rendering it. The cue timeout renders it right
+// away; method calls flush it with the other updates.
+static void pip_window_set_cue(PipWindow* pip, size_t index) {
+  pip->cue_index = index;
+  pip->batch_depth++;
+  pip_window_set_text(pip, index == CueTrack::kNoCue
+                               ? ""
+                               : pip->cues.cue(index).text.c_str());
+  pip->batch_depth--;
+}
+
+// Switches to the cue due at |now_us|, if it is another one. Returns true
+// if the text changed.
+static bool pip_window_show_cue(PipWindow* pip, gint64 now_us) {
+  size_t index = pip->cues.CueAt(pip->cues.PositionMs(now_us));
+  if (index == pip->cue_index) {
+    return false;
+  }
+  pip_window_set_cue(pip, index);
+  return true;
+}
+
+static void update_cue_timeout(PipWindow* pip);
+
+static gboolean on_cue_timeout(gpointer data) {
+  PipWindow* pip = static_cast<PipWindow*>(data);
+  pip->cue_timeout_id = 0;
+  // Rendered with this timeout rather than coalesced into the next frame.
+  if (pip_window_show_cue(pip, g_get_monotonic_time())) {
+    pip_window_render_pending(pip);
+  }
+  update_cue_timeout(pip);
+  return G_SOURCE_REMOVE;
+}
+
+// Arms a one-shot timeout for the next cue start or end at the current
+// rate, so nothing runs between cue changes or after the last cue.
+static void update_cue_timeout(PipWindow* pip) {
+  if (pip->cue_timeout_id != 0) {
+    g_source_remove(pip->cue_timeout_id);
+    pip->cue_timeout_id = 0;
+  }
+  gint64 now = g_get_monotonic_time();
+  int64_t due = pip->cues.NextChangeUs(now);
+  if (due < 0) {
+    return;
+  }
+  // Rounded up, as firing early would only re-arm.
+  guint delay_ms = static_cast<guint>(
+      std::min<int64_t>((due - now + 999) / 1000, G_MAXUINT));
+  pip->cue_timeout_id = g_timeout_add(delay_ms, on_cue_timeout, pip);
+}
+
+// Reads the "cues" list of {startMs, endMs, text} maps in |args|.
+static bool lookup_cues(FlValue* args, std::vector<Cue>* cues) {
+  FlValue* list = fl_value_lookup_string(args, "cues");
+  if (list == nullptr || fl_value_get_type(list) != FL_VALUE_TYPE_LIST) {
+    return false;
+  }
+  for (size_t i = 0; i < fl_value_get_length(list); i++) {
+    FlValue* item = fl_value_get_list_value(list, i);
+    if (fl_value_get_type(item) != FL_VALUE_TYPE_MAP) {
+      return false;
+    }
+    FlValue* start = fl_value_lookup_string(item, "startMs");
+    FlValue* end = fl_value_lookup_string(item, "endMs");
+    FlValue* text = fl_value_lookup_string(item, "text");
+    if (start == nullptr || fl_value_get_type(start) != FL_VALUE_TYPE_INT ||
+        end == nullptr || fl_value_get_type(end) != FL_VALUE_TYPE_INT ||
+        text == nullptr || fl_value_get_type(text) != FL_VALUE_TYPE_STRING) {
+      return false;
+    }
+    cues->push_back({fl_value_get_int(start), fl_value_get_int(end),
+                     fl_value_get_string(text)});
+  }
+  return true;
+}
+
+FlMethodResponse* load_cue_track(PipWindow* pip, FlValue* args) {
+  if (!pip || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+
+  std::vector<Cue> cues;
+  FlValue* path_value = fl_value_lookup_string(args, "path");
+  if (path_value != nullptr &&
+      fl_value_get_type(path_value) == FL_VALUE_TYPE_STRING) {
+    g_autofree gchar* contents = nullptr;
+    gsize length = 0;
+    if (!g_file_get_contents(fl_value_get_string(path_value), &contents,
+                             &length, nullptr)) {
+      g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+      return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    }
+    CueTrack::Parse(std::string(contents, length), &cues);
+  } else if (!lookup_cues(args, &cues)) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  if (cues.empty()) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+
+  pip->cues.Load(std::move(cues));
+  FlValue* play_value = fl_value_lookup_string(args, "play");
+  if (play_value == nullptr ||
+      fl_value_get_type(play_value) != FL_VALUE_TYPE_BOOL ||
+      fl_value_get_bool(play_value)) {
+    pip->cues.Play(g_get_monotonic_time());
+  }
+  pip_window_set_cue(pip, pip->cues.CueAt(0));
+  pip_window_flush(pip);
+  update_cue_timeout(pip);
+
+  g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* control_cue_track(PipWindow* pip, FlValue* args) {
+  if (!pip || !pip->cues.loaded() ||
+      fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+
+  gint64 now = g_get_monotonic_time();
+  FlValue* rate_value = fl_value_lookup_string(args, "rate");
+  if (rate_value != nullptr &&
+      fl_value_get_type(rate_value) == FL_VALUE_TYPE_FLOAT) {
+    pip->cues.SetRate(fl_value_get_float(rate_value), now);
+  }
+  FlValue* position_value = fl_value_lookup_string(args, "positionMs");
+  if (position_value != nullptr &&
+      fl_value_get_type(position_value) == FL_VALUE_TYPE_INT) {
+    pip->cues.Seek(fl_value_get_int(position_value), now);
+  }
+  FlValue* playing_value = fl_value_lookup_string(args, "playing");
+  if (playing_value != nullptr &&
+      fl_value_get_type(playing_value) == FL_VALUE_TYPE_BOOL) {
+    if (fl_value_get_bool(playing_value)) {
+      pip->cues.Play(now);
+    } else {
+      pip->cues.Pause(now);
+    }
+  }
+  if (pip_window_show_cue(pip, now)) {
+    pip_window_flush(pip);
+  }
+  update_cue_timeout(pip);
+
+  g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* unload_cue_track(PipWindow* pip) {
+  if (!pip || !pip->cues.loaded()) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  pip->cues.Clear();
+  update_cue_timeout(pip);
+  pip_window_set_cue(pip, CueTrack::kNoCue);
+  pip_window_flush(pip);
+
+  g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Bytes read from the tailed file at most at once. Anything before them
+// would be dropped from the tail anyway, unless its lines are very short.
+static const gint64 kTailReadLimit = 1 << 20;
+static const int64_t kDefaultTailLines = 200;
+
+// Shows the edit of the tail by replacing only the dropped lines at the
+// head and the new ones at the end, so only those are laid out again. If
+// the text was set otherwise meanwhile it is replaced as a whole.
+static void pip_window_apply_tail(PipWindow* pip, const LineTail::Edit& edit) {
+  if (edit.remove == 0 && edit.append.empty()) {
+    return;
+  }
+  pip_window_note_updates(pip, 1);
+  pip->text_pending = false;
+  pip->batch_depth++;
+  if (pip->text_generation != pip->tail_generation) {
+    std::string text = pip->tail.Text();
+    pip_window_replace_text(pip, 0, text_size(pip), text.data(), text.size());
+  } else {
+    if (edit.remove > 0) {
+      pip_window_replace_text(pip, 0, edit.remove, "", 0);
+    }
+    size_t end = text_size(pip);
+    pip_window_replace_text(pip, end, end, edit.append.data(),
+                            edit.append.size());
+  }
+  pip->tail_generation = pip->text_generation;
+  pip->batch_depth--;
+  pip_window_flush(pip);
+}
+
+// Feeds what was appended to the tailed file since the last read. A file
+// that shrank was truncated and is followed again from its start.
+static void pip_window_read_tail(PipWindow* pip) {
+  struct stat info;
+  if (fstat(pip->tail_fd, &info) != 0) {
+    return;
+  }
+  gint64 size = info.st_size;
+  if (size < pip->tail_offset) {
+    pip->tail.Discard();
+    pip->tail_offset = 0;
+  }
+  bool skipped = size - pip->tail_offset > kTailReadLimit;
+  if (skipped) {
+    pip->tail.Discard();
+    pip->tail_offset = size - kTailReadLimit;
+  }
+  if (size == pip->tail_offset) {
+    return;
+  }
+
+  std::string data(size - pip->tail_offset, '\0');
+  ssize_t length = pread(pip->tail_fd, &data[0], data.size(),
+                         pip->tail_offset);
+  if (length <= 0) {
+    return;
+  }
+  pip->tail_offset += length;
+  // Lines start after a skip only at its first line break.
+  size_t begin = 0;
+  if (skipped) {
+    const void* line_break = memchr(data.data(), '\n', length);
+    begin = line_break != nullptr
+                ? static_cast<const char*>(line_break) - data.data() + 1
+                : length;
+  }
+  pip_window_apply_tail(pip, pip->tail.Feed(data.data() + begin,
+                                            length - begin));
+}
+
+static void on_tail_changed(GFileMonitor* monitor, GFile* file,
+                            GFile* other_file, GFileMonitorEvent event,
+                            gpointer data) {
+  PipWindow* pip = static_cast<PipWindow*>(data);
+  if (event == G_FILE_MONITOR_EVENT_CREATED) {
+    // Replaced, as by log rotation: follow the new file from its start.
+    int fd = open(pip->tail_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+    close(pip->tail_fd);
+    pip->tail_fd = fd;
+    pip->tail_offset = 0;
+    pip->tail.Discard();
+    pip_window_read_tail(pip);
+  } else if (event == G_FILE_MONITOR_EVENT_CHANGED) {
+    pip_window_read_tail(pip);
+  }
+}
+
+// Stops following the file. The text shown stays. Returns false if no
+// file was tailed.
+static bool pip_window_stop_tail(PipWindow* pip) {
+  if (pip->tail_monitor == nullptr) {
+    return false;
+  }
+  g_signal_handlers_disconnect_by_data(pip->tail_monitor, pip);
+  g_file_monitor_cancel(pip->tail_monitor);
+  g_clear_object(&pip->tail_monitor);
+  close(pip->tail_fd);
+  pip->tail_fd = -1;
+  pip->tail_path.clear();
+  return true;
+}
+
+FlMethodResponse* tail_file(PipWindow* pip, FlValue* args) {
+  FlValue* path_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                            ? fl_value_lookup_string(args, "path")
+                            : nullptr;
+  if (!pip || path_value == nullptr ||
+      fl_value_get_type(path_value) != FL_VALUE_TYPE_STRING) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  int64_t max_lines = kDefaultTailLines;
+  FlValue* lines_value = fl_value_lookup_string(args, "maxLines");
+  if (lines_value != nullptr &&
+      fl_value_get_type(lines_value) == FL_VALUE_TYPE_INT) {
+    max_lines = fl_value_get_int(lines_value);
+  }
+
+  const gchar* path = fl_value_get_string(path_value);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  g_autoptr(GFile) file = g_file_new_for_path(path);
+  GFileMonitor* monitor =
+      g_file_monitor_file(file, G_FILE_MONITOR_NONE, nullptr, nullptr);
+  if (monitor == nullptr) {
+    close(fd);
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+
+  pip_window_stop_tail(pip);
+  pip->tail_path = path;
+  pip->tail_fd = fd;
+  pip->tail_offset = 0;
+  pip->tail_monitor = monitor;
+  // Appends are read at most once per frame rather than per write.
+  g_file_monitor_set_rate_limit(monitor, 16);
+  g_signal_connect(monitor, "changed", G_CALLBACK(on_tail_changed), pip);
+
+  pip->tail.Reset(max_lines > 0 ? max_lines : 1);
+  pip->batch_depth++;
+  pip->text_pending = false;
+  pip_window_replace_text(pip, 0, text_size(pip), "", 0);
+  pip->tail_generation = pip->text_generation;
+  pip_window_read_tail(pip);
+  pip->batch_depth--;
+  pip_window_flush(pip);
+
+  g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* stop_tail(PipWindow* pip) {
+  bool stopped = pip && pip_window_stop_tail(pip);
+  g_autoptr(FlValue) result = fl_value_new_bool(stopped);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+static void close_source_client(PipWindow* pip) {
+  if (pip->client_watch != 0) {
+    g_source_remove(pip->client_watch);
+    pip->client_watch = 0;
+  }
+  if (pip->client_fd >= 0) {
+    close(pip->client_fd);
+    pip->client_fd = -1;
+  }
+}
+
+// Reads what the client wrote and shows the newest complete frame with the
+// next frame clock tick. Frames superseded within one read are skipped.
+static gboolean on_source_readable(gint fd, GIOCondition condition,
+                                   gpointer data) {
+  PipWindow* pip = static_cast<PipWindow*>(data);
+  char buffer[65536];
+  bool open = true;
+  for (;;) {
+    ssize_t length = read(fd, buffer, sizeof(buffer));
+    if (length > 0) {
+      if (!pip->frames.Feed(buffer, length)) {
+        open = false;
+        break;
+      }
+      continue;
+    }
+    open = length < 0 && (errno == EAGAIN || errno == EINTR);
+    break;
+  }
+
+  std::string frame;
+  if (pip->frames.TakeFrame(&frame)) {
+    pip_window_note_updates(pip, 1);
+    pip->batch_depth++;
+    pip_window_set_text(pip, frame.data(), frame.size());
+    pip->batch_depth--;
+    pip_window_flush(pip);
+  }
+  if (!open) {
+    // The watch is removed by returning G_SOURCE_REMOVE.
+    pip->client_watch = 0;
+    close_source_client(pip);
+    return G_SOURCE_REMOVE;
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+// A new client replaces the one read so far.
+static gboolean on_source_connection(gint fd, GIOCondition condition,
+                                     gpointer data) {
+  PipWindow* pip = static_cast<PipWindow*>(data);
+  int client = accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (client < 0) {
+    return G_SOURCE_CONTINUE;
+  }
+  close_source_client(pip);
+  pip->frames.Reset(pip->source_framing);
+  pip->client_fd = client;
+  pip->client_watch = g_unix_fd_add(
+      client, static_cast<GIOCondition>(G_IO_IN | G_IO_HUP | G_IO_ERR),
+      on_source_readable, pip);
+  return G_SOURCE_CONTINUE;
+}
+
+// Stops listening and removes the socket. The text shown stays. Returns
+// false if no source was open.
+static bool pip_window_close_source(PipWindow* pip) {
+  if (pip->source_fd < 0) {
+    return false;
+  }
+  close_source_client(pip);
+  g_source_remove(pip->source_watch);
+  pip->source_watch = 0;
+  close(pip->source_fd);
+  pip->source_fd = -1;
+  unlink(pip->source_path.c_str());
+  pip->source_path.clear();
+  return true;
+}
+
+FlMethodResponse* open_source(PipWindow* pip, FlValue* args) {
+  FlValue* path_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                            ? fl_value_lookup_string(args, "path")
+                            : nullptr;
+  if (!pip || path_value == nullptr ||
+      fl_value_get_type(path_value) != FL_VALUE_TYPE_STRING) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  FrameReader::Framing framing = FrameReader::kLines;
+  FlValue* prefixed_value = fl_value_lookup_string(args, "lengthPrefixed");
+  if (prefixed_value != nullptr &&
+      fl_value_get_type(prefixed_value) == FL_VALUE_TYPE_BOOL &&
+      fl_value_get_bool(prefixed_value)) {
+    framing = FrameReader::kLengthPrefixed;
+  }
+
+  const gchar* path = fl_value_get_string(path_value);
+  struct sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  strcpy(address.sun_path, path);
+
+  pip_window_close_source(pip);
+  // A socket left behind by an earlier run would fail the bind; other
+  // files are never removed.
+  struct stat info;
+  if (lstat(path, &info) == 0 && S_ISSOCK(info.st_mode)) {
+    unlink(path);
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0 ||
+      bind(fd, reinterpret_cast<struct sockaddr*>(&address),
+           sizeof(address)) != 0 ||
+      listen(fd, 1) != 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+
+  pip->source_path = path;
+  pip->source_framing = framing;
+  pip->source_fd = fd;
+  pip->source_watch = g_unix_fd_add(fd, G_IO_IN, on_source_connection, pip);
+
+  g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* close_source(PipWindow* pip) {
+  bool closed = pip && pip_window_close_source(pip);
+  g_autoptr(FlValue) result = fl_value_new_bool(closed);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Applies the animation's values at |now_us| and renders them. Returns
+// false once it has ended.
+static bool pip_window_step_animation(PipWindow* pip, gint64 now_us) {
+  unsigned properties = pip->animation.properties();
+  double values[PipAnimation::kPropertyCount];
+  bool running = pip->animation.Sample(now_us, values);
+
+  if (properties & (1u << PipAnimation::kBackgroundRed)) {
+    pip->style.bg_color = {values[PipAnimation::kBackgroundRed],
+                           values[PipAnimation::kBackgroundGreen],
+                           values[PipAnimation::kBackgroundBlue],
+                           values[PipAnimation::kBackgroundAlpha]};
+  }
+  if (properties & (1u << PipAnimation::kTextRed)) {
+    pip->style.text_color = {values[PipAnimation::kTextRed],
+                             values[PipAnimation::kTextGreen],
+                             values[PipAnimation::kTextBlue],
+                             values[PipAnimation::kTextAlpha]};
+  }
+  if (properties & (1u << PipAnimation::kTextSize)) {
+    double size = values[PipAnimation::kTextSize];
+    if (running && !pip->teleprompter) {
+      pip->text_scale = size / pip->style.text_size;
+    } else {
+      pip->text_scale = 1;
+      if (size != pip->style.text_size) {
+        pip->style.text_size = size;
+        invalidate_layout(pip);
+      }
+    }
+  }
+  pip->refresh_full = true;
+  pip_window_render_pending(pip);
+  return running;
+}
+
+static gboolean animation_tick_callback(GtkWidget* widget,
+                                        GdkFrameClock* frame_clock,
+                                        gpointer data) {
+  PipWindow* pip = static_cast<PipWindow*>(data);
+  if (pip_window_step_animation(
+          pip, gdk_frame_clock_get_frame_time(frame_clock))) {
+    return G_SOURCE_CONTINUE;
+  }
+  pip->animation_tick_id = 0;
+  return G_SOURCE_REMOVE;
+}
+
+// Stops the animation where it is. The text laid out for the larger size
+// of a size tween is laid out again for the size shown. Returns the
+// StyleField bits changed.
+static unsigned pip_window_stop_animation(PipWindow* pip) {
+  if (pip->animation_tick_id != 0) {
+    gtk_widget_remove_tick_callback(pip->drawing_area, pip->animation_tick_id);
+    pip->animation_tick_id = 0;
+  }
+  pip->animation.Stop();
+  if (pip->text_scale == 1) {
+    return 0;
+  }
+  pip->style.text_size *= pip->text_scale;
+  pip->text_scale = 1;
+  return STYLE_TEXT_SIZE;
+}
+
+FlMethodResponse* animate(PipWindow* pip, FlValue* args) {
+  if (!pip || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  PipAnimation::Curve curve = PipAnimation::kEaseInOut;
+  FlValue* curve_value = fl_value_lookup_string(args, "curve");
+  if (curve_value != nullptr &&
+      (fl_value_get_type(curve_value) != FL_VALUE_TYPE_STRING ||
+       !PipAnimation::ParseCurve(fl_value_get_string(curve_value), &curve))) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  int64_t duration_ms = 0;
+  FlValue* duration_value = fl_value_lookup_string(args, "durationMs");
+  if (duration_value != nullptr &&
+      fl_value_get_type(duration_value) == FL_VALUE_TYPE_INT) {
+    duration_ms = fl_value_get_int(duration_value);
+  }
+  int64_t repeat = 1;
+  FlValue* repeat_value = fl_value_lookup_string(args, "repeat");
+  if (repeat_value != nullptr &&
+      fl_value_get_type(repeat_value) == FL_VALUE_TYPE_INT) {
+    repeat = fl_value_get_int(repeat_value);
+  }
+  FlValue* reverse_value = fl_value_lookup_string(args, "reverse");
+  bool reverse = reverse_value != nullptr &&
+                 fl_value_get_type(reverse_value) == FL_VALUE_TYPE_BOOL &&
+                 fl_value_get_bool(reverse_value);
+
+  // A new animation starts from the values shown now.
+  unsigned dirty = pip_window_stop_animation(pip);
+  double from[PipAnimation::kPropertyCount];
+  double to[PipAnimation::kPropertyCount];
+  const PipStyle& style = pip->style;
+  const GdkRGBA* colors[] = {&style.bg_color, &style.text_color};
+  for (int i = 0; i < 2; i++) {
+    double* channels = from + (i == 0 ? PipAnimation::kBackgroundRed
+                                      : PipAnimation::kTextRed);
+    channels[0] = colors[i]->red;
+    channels[1] = colors[i]->green;
+    channels[2] = colors[i]->blue;
+    channels[3] = colors[i]->alpha;
+  }
+  from[PipAnimation::kTextSize] = style.text_size;
+  std::copy(from, from + PipAnimation::kPropertyCount, to);
+
+  unsigned properties = 0;
+  GdkRGBA color;
+  if (lookup_color(args, "backgroundColor", &color)) {
+    double* channels = to + PipAnimation::kBackgroundRed;
+    channels[0] = color.red;
+    channels[1] = color.green;
+    channels[2] = color.blue;
+    channels[3] = color.alpha;
+    properties |= 0xFu << PipAnimation::kBackgroundRed;
+  }
+  if (lookup_color(args, "textColor", &color)) {
+    double* channels = to + PipAnimation::kTextRed;
+    channels[0] = color.red;
+    channels[1] = color.green;
+    channels[2] = color.blue;
+    channels[3] = color.alpha;
+    properties |= 0xFu << PipAnimation::kTextRed;
+  }
+  FlValue* size_value = fl_value_lookup_string(args, "textSize");
+  if (size_value != nullptr &&
+      fl_value_get_type(size_value) == FL_VALUE_TYPE_FLOAT &&
+      fl_value_get_float(size_value) > 0) {
+    to[PipAnimation::kTextSize] = fl_value_get_float(size_value);
+    properties |= 1u << PipAnimation::kTextSize;
+    // Laid out once at the larger size, which is then only scaled down.
+    double layout_size = std::max(from[PipAnimation::kTextSize],
+                                  to[PipAnimation::kTextSize]);
+    if (!pip->teleprompter && layout_size != pip->style.text_size) {
+      pip->text_scale = pip->style.text_size / layout_size;
+      pip->style.text_size = layout_size;
+      dirty |= STYLE_TEXT_SIZE;
+    }
+  }
+  if (dirty & STYLE_TEXT_SIZE) {
+    invalidate_layout(pip);
+  }
+
+  pip_window_note_updates(pip, 1);
+  gint64 now = g_get_monotonic_time();
+  pip->animation.Start(from, to, properties, duration_ms * 1000, curve,
+                       repeat, reverse, now);
+  if (pip_window_step_animation(pip, now)) {
+    pip->animation_tick_id = gtk_widget_add_tick_callback(
+        pip->drawing_area, animation_tick_callback, pip, nullptr);
+  }
+
+  g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Default bounds of the auto-fit size, in pixels.
+static const double kDefaultFitMinSize = 8;
+static const double kDefaultFitMaxSize = 512;
+
+FlMethodResponse* auto_fit(PipWindow* pip, FlValue* args) {
+  if (!pip || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  FlValue* enabled_value = fl_value_lookup_string(args, "enabled");
+  bool enabled = enabled_value == nullptr ||
+                 (fl_value_get_type(enabled_value) == FL_VALUE_TYPE_BOOL &&
+                  fl_value_get_bool(enabled_value));
+  if (!enabled) {
+    if (!pip->fit_enabled) {
+      g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+      return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    }
+    pip->fit_enabled = false;
+    pip->style.text_size = pip->fit_base_size;
+    pip->fit.Reset();
+    pip_window_refresh(pip);
+    g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+
+  double min_size = kDefaultFitMinSize;
+  double max_size = kDefaultFitMaxSize;
+  FlValue* min_value = fl_value_lookup_string(args, "minSize");
+  if (min_value != nullptr &&
+      fl_value_get_type(min_value) == FL_VALUE_TYPE_FLOAT) {
+    min_size = fl_value_get_float(min_value);
+  }
+  FlValue* max_value = fl_value_lookup_string(args, "maxSize");
+  if (max_value != nullptr &&
+      fl_value_get_type(max_value) == FL_VALUE_TYPE_FLOAT) {
+    max_size = fl_value_get_float(max_value);
+  }
+  if (min_size < 1 || max_size < min_size) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+
+  if (!pip->fit_enabled) {
+    pip->fit_base_size = pip->style.text_size;
+  }
+  pip->fit_enabled = true;
+  pip->fit_min_size = min_size;
+  pip->fit_max_size = max_size;
+  pip_window_refresh(pip);
+
+  g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* control_scroll(PipWindow* pip, FlValue* args) {
+  if (!pip || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+
+  FlValue* speed_val = fl_value_lookup_string(args, "speed");
+  if (speed_val && fl_value_get_type(speed_val) == FL_VALUE_TYPE_FLOAT) {
+    pip->style.scroll_speed = fl_value_get_float(speed_val);
+  }
+
+  FlValue* scrolling_val = fl_value_lookup_string(args, "isScrolling");
+  if (scrolling_val && fl_value_get_type(scrolling_val) == FL_VALUE_TYPE_BOOL) {
+    // The first controlScroll switches the window to the top-anchored,
+    // unclipped teleprompter layout; pausing keeps the current offset.
+    if (!pip->teleprompter) {
+      pip->teleprompter = true;
+      pip->scroll_offset = 0;
+      pip_window_refresh(pip);
+    }
+    if (fl_value_get_bool(scrolling_val)) {
+      start_scrolling(pip);
+    } else {
+      stop_scrolling(pip);
+    }
+  }
+
+  g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+static FlMethodResponse* handle_window_method(const gchar* method,
+                                              PipWindow* pip, FlValue* args,
+                                              FlMethodChannel* channel);
+
+static bool response_succeeded(FlMethodResponse* response) {
+  if (!FL_IS_METHOD_SUCCESS_RESPONSE(response)) {
+    return false;
+  }
+  FlValue* result = fl_method_success_response_get_result(
+      FL_METHOD_SUCCESS_RESPONSE(response));
+  return fl_value_get_type(result) != FL_VALUE_TYPE_BOOL ||
+         fl_value_get_bool(result);
+}
+
+// Checks one applyBatch operation before any is applied. Only the calls a
+// PipOperation sends are taken, with the arguments their handlers need, so
+// a checked batch cannot fail halfway.
+static bool check_batch_operation(FlValue* operation) {
+  if (fl_value_get_type(operation) != FL_VALUE_TYPE_MAP) {
+    return false;
+  }
+  FlValue* method_value = fl_value_lookup_string(operation, "method");
+  if (method_value == nullptr ||
+      fl_value_get_type(method_value) != FL_VALUE_TYPE_STRING) {
+    return false;
+  }
+  const gchar* method = fl_value_get_string(method_value);
+  FlValue* args = fl_value_lookup_string(operation, "args");
+  if (args != nullptr && fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    args = nullptr;
+  }
+  FlValue* text = args != nullptr ? fl_value_lookup_string(args, "text")
+                                  : nullptr;
+  bool has_text =
+      text != nullptr && fl_value_get_type(text) == FL_VALUE_TYPE_STRING;
+
+  if (strcmp(method, "updatePip") == 0 ||
+      strcmp(method, "controlScroll") == 0) {
+    return args != nullptr;
+  }
+  if (strcmp(method, "updateText") == 0 ||
+      strcmp(method, "appendText") == 0) {
+    return has_text;
+  }
+  if (strcmp(method, "replaceRange") == 0) {
+    FlValue* start = args != nullptr ? fl_value_lookup_string(args, "start")
+                                     : nullptr;
+    FlValue* end = args != nullptr ? fl_value_lookup_string(args, "end")
+                                   : nullptr;
+    // 0 <= start <= end, as replace_range requires.
+    return has_text && start != nullptr &&
+           fl_value_get_type(start) == FL_VALUE_TYPE_INT && end != nullptr &&
+           fl_value_get_type(end) == FL_VALUE_TYPE_INT &&
+           fl_value_get_int(start) >= 0 &&
+           fl_value_get_int(end) >= fl_value_get_int(start);
+  }
+  return strcmp(method, "clearText") == 0 ||
+         strcmp(method, "startPip") == 0 || strcmp(method, "stopPip") == 0;
+}
+
+FlMethodResponse* apply_batch(PipWindow* pip, FlValue* args,
+                              FlMethodChannel* channel) {
+  // A bare list targets the default window; {id, operations} another.
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    args = fl_value_lookup_string(args, "operations");
+  }
+  if (!pip || args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_LIST) {
+    g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+
+  // The batch is applied as a whole or not at all.
+  for (size_t i = 0; i < fl_value_get_length(args); i++) {
+    if (!check_batch_operation(fl_value_get_list_value(args, i))) {
+      g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+      return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    }
+  }
+
+  // Every operation runs through the regular handlers, but nothing is
+  // rendered until the last one has been applied.
+  g_autoptr(FlValue) no_args = fl_value_new_null();
+  bool success = true;
+  pip_window_note_updates(pip, 1);
+  pip->batch_depth++;
+  for (size_t i = 0; i < fl_value_get_length(args); i++) {
+    FlValue* operation = fl_value_get_list_value(args, i);
+    FlValue* method = fl_value_lookup_string(operation, "method");
+    FlValue* op_args = fl_value_lookup_string(operation, "args");
+    g_autoptr(FlMethodResponse) response =
+        handle_window_method(fl_value_get_string(method), pip,
+                             op_args != nullptr ? op_args : no_args, channel);
+    success = response_succeeded(response) && success;
+  }
+  pip->batch_depth--;
+  pip_window_flush(pip);
+
+  g_autoptr(FlValue) result = fl_value_new_bool(success);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* get_stats(PipWindow* pip) {
+  if (!pip) {
+    g_autoptr(FlValue) result = fl_value_new_null();
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  const PipStats& stats = pip->stats;
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(result, "updates",
+                           fl_value_new_int(stats.updates));
+  fl_value_set_string_take(result, "superseded",
+                           fl_value_new_int(stats.superseded));
+  fl_value_set_string_take(result, "frames", fl_value_new_int(stats.frames));
+  if (stats.first_frame_us != 0) {
+    fl_value_set_string_take(result, "firstFrameUs",
+                             fl_value_new_int(stats.first_frame_us));
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* get_platform_version() {
+  struct utsname uname_data = {};
+  uname(&uname_data);
+  g_autofree gchar *version = g_strdup_printf("Linux %s", uname_data.version);
+  g_autoptr(FlValue) result = fl_value_new_string(version);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Dispatches |method| to the handler acting on the window |pip|, which
+// may be null. Shared by method calls and the operations of applyBatch.
+static FlMethodResponse* handle_window_method(const gchar* method,
+                                              PipWindow* pip, FlValue* args,
+                                              FlMethodChannel* channel) {
+  FlMethodResponse* response = nullptr;
+
+  if (strcmp(method, "startPip") == 0) {
+    response = start_pip(pip);
+  } else if (strcmp(method, "stopPip") == 0) {
+    response = stop_pip(pip);
+  } else if (strcmp(method, "destroyPip") == 0) {
+    response = destroy_pip(pip);
+  } else if (strcmp(method, "updateText") == 0) {
+    response = update_text(pip, args);
+  } else if (strcmp(method, "appendText") == 0) {
+    response = append_text(pip, args);
+  } else if (strcmp(method, "replaceRange") == 0) {
+    response = replace_range(pip, args);
+  } else if (strcmp(method, "clearText") == 0) {
+    response = clear_text(pip);
+  } else if (strcmp(method, "loadTextFile") == 0) {
+    response = load_text_file(pip, args);
+  } else if (strcmp(method, "updatePip") == 0) {
+    response = update_pip(pip, args);
+  } else if (strcmp(method, "controlScroll") == 0) {
+    response = control_scroll(pip, args);
+  } else if (strcmp(method, "applyBatch") == 0) {
+    response = apply_batch(pip, args, channel);
+  } else if (strcmp(method, "startClock") == 0) {
+    response = start_clock(pip, args);
+  } else if (strcmp(method, "stopClock") == 0) {
+    response = stop_clock(pip);
+  } else if (strcmp(method, "loadCueTrack") == 0) {
+    response = load_cue_track(pip, args);
+  } else if (strcmp(method, "controlCueTrack") == 0) {
+    response = control_cue_track(pip, args);
+  } else if (strcmp(method, "unloadCueTrack") == 0) {
+    response = unload_cue_track(pip);
+  } else if (strcmp(method, "tailFile") == 0) {
+    response = tail_file(pip, args);
+  } else if (strcmp(method, "stopTail") == 0) {
+    response = stop_tail(pip);
+  } else if (strcmp(method, "animate") == 0) {
+    response = animate(pip, args);
+  } else if (strcmp(method, "autoFit") == 0) {
+    response = auto_fit(pip, args);
+  } else if (strcmp(method, "openSource") == 0) {
+    response = open_source(pip, args);
+  } else if (strcmp(method, "closeSource") == 0) {
+    response = close_source(pip);
+  } else if (strcmp(method, "getStats") == 0) {
+    response = get_stats(pip);
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+
+  return response;
+}
+
+// Dispatches |method| to its handler. Calls on a window take its id in
+// their map arguments and act on the default window without one.
+static FlMethodResponse* handle_method(const gchar* method, FlValue* args,
+                                       FlMethodChannel* channel) {
+  if (strcmp(method, "getPlatformVersion") == 0) {
+    return get_platform_version();
+  } else if (strcmp(method, "setupPip") == 0) {
+    return setup_pip(args, channel);
+  } else if (strcmp(method, "isPipSupported") == 0) {
+    return is_pip_supported();
+  }
+
+  PipWindow* pip = nullptr;
+  if (!find_window(args, &pip)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "unknown_window", "No PiP window with this id", nullptr));
+  }
+  return handle_window_method(method, pip, args, channel);
+}
+
+// Called when a method call is received from Flutter.
+static void pip_plugin_handle_method_call(
+    PipPlugin* self,
+    FlMethodCall* method_call,
+    FlMethodChannel* channel) {
+  g_autoptr(FlMethodResponse) response = handle_method(
+      fl_method_call_get_name(method_call),
+      fl_method_call_get_args(method_call), channel);
+  fl_method_call_respond(method_call, response, nullptr);
+}
+
+static void pip_plugin_dispose(GObject* object) {
+  // Clean up the PiP windows that exist
+  while (!pip_windows.empty()) {
+    pip_window_free(pip_windows.begin()->second);
+  }
+  for (auto& entry : font_cache) {
+    pango_font_description_free(entry.second);
   }
+  font_cache.clear();
   
   G_OBJECT_CLASS(pip_plugin_parent_class)->dispose(object);
 }
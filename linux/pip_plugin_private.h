@@ -3,13 +3,78 @@
 
 #include <flutter_linux/flutter_linux.h>
 
-// Function declarations for plugin methods
+#include <string>
+
+enum TextAlign { ALIGN_LEFT, ALIGN_CENTER, ALIGN_RIGHT };
+
+// Style of the PiP window as set by setupPip and updatePip.
+struct PipStyle {
+  GdkRGBA bg_color;
+  GdkRGBA text_color;
+  TextAlign text_align;
+  double text_size;
+  // Teleprompter speed in pixels per second.
+  double scroll_speed;
+  // Aspect ratio of the window, 0 until one is set.
+  int ratio_width;
+  int ratio_height;
+};
+
+// Dirty bits of the PipStyle fields, grouped by what a change invalidates.
+enum StyleField : unsigned {
+  STYLE_BG_COLOR = 1 << 0,    // rendered frame only
+  STYLE_TEXT_COLOR = 1 << 1,  // rendered frame only
+  STYLE_TEXT_SIZE = 1 << 2,   // font and paragraph layouts
+  STYLE_TEXT_ALIGN = 1 << 3,  // paragraph layouts
+  STYLE_SPEED = 1 << 4,       // nothing rendered
+  STYLE_RATIO = 1 << 5,       // window geometry
+};
+
+// One PiP window, see pip_plugin.cc.
+struct PipWindow;
+
+// Function declarations for plugin methods. Those taking a PipWindow act
+// on the window addressed by the call and fail without one.
 FlMethodResponse* get_platform_version();
-FlMethodResponse* setup_pip(FlValue* args);
-FlMethodResponse* update_pip(FlValue* args);
-FlMethodResponse* start_pip();
-FlMethodResponse* stop_pip();
+FlMethodResponse* setup_pip(FlValue* args, FlMethodChannel* method_channel);
+FlMethodResponse* update_pip(PipWindow* pip, FlValue* args);
+FlMethodResponse* start_pip(PipWindow* pip);
+FlMethodResponse* stop_pip(PipWindow* pip);
+FlMethodResponse* destroy_pip(PipWindow* pip);
 FlMethodResponse* is_pip_supported();
-FlMethodResponse* update_text(FlValue* args);
+FlMethodResponse* update_text(PipWindow* pip, FlValue* args);
+FlMethodResponse* control_scroll(PipWindow* pip, FlValue* args);
+FlMethodResponse* append_text(PipWindow* pip, FlValue* args);
+FlMethodResponse* replace_range(PipWindow* pip, FlValue* args);
+FlMethodResponse* clear_text(PipWindow* pip);
+FlMethodResponse* load_text_file(PipWindow* pip, FlValue* args);
+FlMethodResponse* apply_batch(PipWindow* pip, FlValue* args,
+                              FlMethodChannel* channel);
+FlMethodResponse* get_stats(PipWindow* pip);
+FlMethodResponse* start_clock(PipWindow* pip, FlValue* args);
+FlMethodResponse* stop_clock(PipWindow* pip);
+FlMethodResponse* animate(PipWindow* pip, FlValue* args);
+FlMethodResponse* auto_fit(PipWindow* pip, FlValue* args);
+FlMethodResponse* load_cue_track(PipWindow* pip, FlValue* args);
+FlMethodResponse* control_cue_track(PipWindow* pip, FlValue* args);
+FlMethodResponse* unload_cue_track(PipWindow* pip);
+FlMethodResponse* tail_file(PipWindow* pip, FlValue* args);
+FlMethodResponse* stop_tail(PipWindow* pip);
+FlMethodResponse* open_source(PipWindow* pip, FlValue* args);
+FlMethodResponse* close_source(PipWindow* pip);
+
+// Looks up the window addressed by the "id" of the map |args|, or the
+// default window (null if there is none) when no id is given. Returns
+// false for an id of no open window.
+bool find_window(FlValue* args, PipWindow** pip);
+
+// Reads the style keys present in setupPip/updatePip |args| into |style|.
+// Returns the StyleField bits of the fields whose value changed.
+unsigned parse_style(FlValue* args, PipStyle* style);
+
+// Converts |index|, counted in UTF-16 code units as Dart strings are, to a
+// byte offset into the UTF-8 |text|. Indices past the end clamp to it; an
+// index inside a surrogate pair rounds down to the character start.
+size_t utf16_index_to_byte_offset(const std::string& text, int64_t index);
 
 #endif  // FLUTTER_PLUGIN_PIP_PLUGIN_PRIVATE_H_
\ No newline at end of file
@@ -27,5 +27,67 @@ TEST(PipPlugin, GetPlatformVersion) {
   EXPECT_THAT(fl_value_get_string(result), testing::StartsWith("Linux "));
 }
 
+TEST(PipPlugin, Utf16IndexToByteOffset) {
+  // "a", U+00E9, U+1F600 (a surrogate pair in UTF-16), "b".
+  const std::string text = "a\xC3\xA9\xF0\x9F\x98\x80" "b";
+  EXPECT_EQ(utf16_index_to_byte_offset(text, 0), 0u);
+  EXPECT_EQ(utf16_index_to_byte_offset(text, 1), 1u);
+  EXPECT_EQ(utf16_index_to_byte_offset(text, 2), 3u);
+  EXPECT_EQ(utf16_index_to_byte_offset(text, 3), 3u);
+  EXPECT_EQ(utf16_index_to_byte_offset(text, 4), 7u);
+  EXPECT_EQ(utf16_index_to_byte_offset(text, 5), 8u);
+  EXPECT_EQ(utf16_index_to_byte_offset(text, 100), 8u);
+}
+
+TEST(PipPlugin, ParseStyleReportsChangedFields) {
+  PipStyle style = {};
+  style.text_color = {1, 1, 1, 1};
+  style.text_size = 32.0;
+
+  g_autoptr(FlValue) args = fl_value_new_map();
+  g_autoptr(FlValue) color = fl_value_new_list();
+  fl_value_append_take(color, fl_value_new_int(255));
+  fl_value_append_take(color, fl_value_new_int(0));
+  fl_value_append_take(color, fl_value_new_int(0));
+  fl_value_set_string(args, "backgroundColor", color);
+  fl_value_set_string_take(args, "textSize", fl_value_new_float(32.0));
+  EXPECT_EQ(parse_style(args, &style), STYLE_BG_COLOR);
+  EXPECT_EQ(style.bg_color.red, 1.0);
+  EXPECT_EQ(style.bg_color.alpha, 1.0);
+  // A missing textColor keeps the current one.
+  EXPECT_EQ(style.text_color.green, 1.0);
+
+  // Sending the same style again invalidates nothing.
+  EXPECT_EQ(parse_style(args, &style), 0u);
+}
+
+TEST(PipPlugin, ReplaceRangeRejectsInvalidRange) {
+  g_autoptr(FlValue) args = fl_value_new_map();
+  fl_value_set_string_take(args, "start", fl_value_new_int(3));
+  fl_value_set_string_take(args, "end", fl_value_new_int(1));
+  fl_value_set_string_take(args, "text", fl_value_new_string("abc"));
+  g_autoptr(FlMethodResponse) reversed = replace_range(nullptr, args);
+  ASSERT_TRUE(FL_IS_METHOD_ERROR_RESPONSE(reversed));
+  EXPECT_STREQ(fl_method_error_response_get_code(
+                   FL_METHOD_ERROR_RESPONSE(reversed)),
+               "invalid_argument");
+
+  g_autoptr(FlValue) no_range = fl_value_new_map();
+  fl_value_set_string_take(no_range, "text", fl_value_new_string("abc"));
+  g_autoptr(FlMethodResponse) missing = replace_range(nullptr, no_range);
+  EXPECT_TRUE(FL_IS_METHOD_ERROR_RESPONSE(missing));
+}
+
+TEST(PipPlugin, FindWindowRejectsUnknownId) {
+  PipWindow* pip = nullptr;
+  g_autoptr(FlValue) no_id = fl_value_new_map();
+  EXPECT_TRUE(find_window(no_id, &pip));
+  EXPECT_EQ(pip, nullptr);
+
+  g_autoptr(FlValue) unknown = fl_value_new_map();
+  fl_value_set_string_take(unknown, "id", fl_value_new_int(42));
+  EXPECT_FALSE(find_window(unknown, &pip));
+}
+
 }  // namespace test
 }  // namespace pip_plugin
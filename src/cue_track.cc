@@ -0,0 +1,235 @@
+// cue_track.cc
+#include "cue_track.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace pip_plugin {
+
+namespace {
+
+const int64_t kForever = std::numeric_limits<int64_t>::max();
+
+// Parses "[hh:]mm:ss[.fff]" (also "," as in SRT) at |*pos| into |*ms|
+// and advances |*pos| past it.
+bool ParseTimestamp(const std::string& s, size_t* pos, int64_t* ms) {
+  size_t i = *pos;
+  while (i < s.size() && s[i] == ' ') i++;
+  int64_t fields[3];
+  int count = 0;
+  while (count < 3) {
+    size_t begin = i;
+    int64_t value = 0;
+    while (i < s.size() && s[i] >= '0' && s[i] <= '9' &&
+           i - begin < 9) {
+      value = value * 10 + (s[i] - '0');
+      i++;
+    }
+    if (i == begin) return false;
+    fields[count++] = value;
+    if (i >= s.size() || s[i] != ':') break;
+    i++;
+  }
+  if (count < 2) return false;
+
+  int64_t fraction = 0;
+  if (i < s.size() && (s[i] == '.' || s[i] == ',')) {
+    i++;
+    int64_t scale = 100;
+    while (i < s.size() && s[i] >= '0' && s[i] <= '9') {
+      fraction += (s[i] - '0') * scale;
+      scale /= 10;
+      i++;
+    }
+  }
+  int64_t seconds = 0;
+  for (int f = 0; f < count; f++) seconds = seconds * 60 + fields[f];
+  *ms = seconds * 1000 + fraction;
+  *pos = i;
+  return true;
+}
+
+// Drops "<...>" markup such as <i> or WebVTT voice spans.
+std::string StripTags(const std::string& line) {
+  std::string text;
+  bool in_tag = false;
+  for (char c : line) {
+    if (c == '<') {
+      in_tag = true;
+    } else if (c == '>' && in_tag) {
+      in_tag = false;
+    } else if (!in_tag) {
+      text += c;
+    }
+  }
+  return text;
+}
+
+std::vector<std::string> SplitLines(const std::string& data) {
+  std::vector<std::string> lines;
+  size_t begin = data.compare(0, 3, "\xEF\xBB\xBF") == 0 ? 3 : 0;
+  while (begin <= data.size()) {
+    size_t end = data.find('\n', begin);
+    if (end == std::string::npos) end = data.size();
+    size_t stop = end > begin && data[end - 1] == '\r' ? end - 1 : end;
+    lines.push_back(data.substr(begin, stop - begin));
+    begin = end + 1;
+  }
+  return lines;
+}
+
+// SRT and WebVTT: blocks of a "start --> end" line and the text below
+// it. Blocks without a timing line (headers, NOTE, STYLE) are skipped.
+void ParseBlocks(const std::vector<std::string>& lines,
+                 std::vector<Cue>* cues) {
+  for (size_t i = 0; i < lines.size(); i++) {
+    size_t arrow = lines[i].find("-->");
+    if (arrow == std::string::npos) continue;
+    size_t pos = 0;
+    size_t end_pos = arrow + 3;
+    Cue cue;
+    if (!ParseTimestamp(lines[i], &pos, &cue.start_ms) ||
+        !ParseTimestamp(lines[i], &end_pos, &cue.end_ms)) {
+      continue;
+    }
+    while (i + 1 < lines.size() && !lines[i + 1].empty()) {
+      if (!cue.text.empty()) cue.text += '\n';
+      cue.text += StripTags(lines[++i]);
+    }
+    cues->push_back(std::move(cue));
+  }
+}
+
+// LRC: lines of one or more "[mm:ss.xx]" tags followed by the text.
+// Other tags ([ar:...], [ti:...]) are metadata.
+void ParseLrc(const std::vector<std::string>& lines, std::vector<Cue>* cues) {
+  for (const std::string& line : lines) {
+    std::vector<int64_t> starts;
+    size_t pos = 0;
+    while (pos < line.size() && line[pos] == '[') {
+      size_t close = line.find(']', pos);
+      if (close == std::string::npos) break;
+      size_t time_pos = pos + 1;
+      int64_t ms;
+      if (ParseTimestamp(line, &time_pos, &ms) && time_pos == close) {
+        starts.push_back(ms);
+      }
+      pos = close + 1;
+    }
+    std::string text = StripTags(line.substr(pos));
+    for (int64_t start : starts) {
+      cues->push_back({start, kForever, text});
+    }
+  }
+  std::stable_sort(cues->begin(), cues->end(),
+                   [](const Cue& a, const Cue& b) {
+                     return a.start_ms < b.start_ms;
+                   });
+  for (size_t i = 0; i + 1 < cues->size(); i++) {
+    (*cues)[i].end_ms = (*cues)[i + 1].start_ms;
+  }
+}
+
+}  // namespace
+
+const size_t CueTrack::kNoCue;
+
+bool CueTrack::Parse(const std::string& data, std::vector<Cue>* cues) {
+  std::vector<std::string> lines = SplitLines(data);
+  cues->clear();
+  if (data.find("-->") != std::string::npos) {
+    ParseBlocks(lines, cues);
+  } else {
+    ParseLrc(lines, cues);
+  }
+  return !cues->empty();
+}
+
+void CueTrack::Load(std::vector<Cue> cues) {
+  std::stable_sort(cues.begin(), cues.end(), [](const Cue& a, const Cue& b) {
+    return a.start_ms < b.start_ms;
+  });
+  cues_ = std::move(cues);
+  reach_.resize(cues_.size());
+  int64_t reach = std::numeric_limits<int64_t>::min();
+  for (size_t i = 0; i < cues_.size(); i++) {
+    reach = std::max(reach, cues_[i].end_ms);
+    reach_[i] = reach;
+  }
+  boundaries_.clear();
+  for (const Cue& cue : cues_) {
+    boundaries_.push_back(cue.start_ms);
+    if (cue.end_ms != kForever) {
+      boundaries_.push_back(cue.end_ms);
+    }
+  }
+  std::sort(boundaries_.begin(), boundaries_.end());
+  playing_ = false;
+  anchor_ms_ = 0;
+  anchor_us_ = 0;
+}
+
+void CueTrack::Play(int64_t now_us) {
+  anchor_ms_ = PositionMs(now_us);
+  anchor_us_ = now_us;
+  playing_ = true;
+}
+
+void CueTrack::Pause(int64_t now_us) {
+  anchor_ms_ = PositionMs(now_us);
+  anchor_us_ = now_us;
+  playing_ = false;
+}
+
+void CueTrack::Seek(int64_t position_ms, int64_t now_us) {
+  anchor_ms_ = position_ms < 0 ? 0 : position_ms;
+  anchor_us_ = now_us;
+}
+
+void CueTrack::SetRate(double rate, int64_t now_us) {
+  anchor_ms_ = PositionMs(now_us);
+  anchor_us_ = now_us;
+  rate_ = rate < 0 ? 0 : rate;
+}
+
+int64_t CueTrack::PositionMs(int64_t now_us) const {
+  if (!playing_) {
+    return anchor_ms_;
+  }
+  return anchor_ms_ + static_cast<int64_t>((now_us - anchor_us_) * rate_ /
+                                           1000);
+}
+
+int64_t CueTrack::NextChangeUs(int64_t now_us) const {
+  if (!playing_ || rate_ <= 0) {
+    return -1;
+  }
+  auto next = std::upper_bound(boundaries_.begin(), boundaries_.end(),
+                               PositionMs(now_us));
+  if (next == boundaries_.end()) {
+    return -1;
+  }
+  // The first time PositionMs() reaches the boundary.
+  int64_t due_us = anchor_us_ + static_cast<int64_t>(std::ceil(
+                                    (*next - anchor_ms_) * 1000.0 / rate_));
+  return due_us > now_us ? due_us : now_us + 1;
+}
+
+size_t CueTrack::CueAt(int64_t position_ms) const {
+  // The last cue started by now, then back over the ones it overlaps.
+  size_t i = std::upper_bound(cues_.begin(), cues_.end(), position_ms,
+                              [](int64_t ms, const Cue& cue) {
+                                return ms < cue.start_ms;
+                              }) -
+             cues_.begin();
+  while (i > 0 && reach_[i - 1] > position_ms) {
+    i--;
+    if (cues_[i].end_ms > position_ms) {
+      return i;
+    }
+  }
+  return kNoCue;
+}
+
+}  // namespace pip_plugin
@@ -0,0 +1,70 @@
+// cue_track.h
+#ifndef FLUTTER_PLUGIN_CUE_TRACK_H_
+#define FLUTTER_PLUGIN_CUE_TRACK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace pip_plugin {
+
+// One timed line of a cue track, shown from |start_ms| until |end_ms|.
+struct Cue {
+  int64_t start_ms;
+  int64_t end_ms;
+  std::string text;
+};
+
+// Lyrics or subtitles played natively against a monotonic time in
+// microseconds, so the shown cue never depends on when Dart gets to run.
+class CueTrack {
+ public:
+  static const size_t kNoCue = static_cast<size_t>(-1);
+
+  // Parses SRT, WebVTT or LRC, told apart by their content. Markup tags
+  // are dropped. An LRC line lasts until the next one. Returns false if
+  // |data| has no cue.
+  static bool Parse(const std::string& data, std::vector<Cue>* cues);
+
+  // Replaces the cues and rewinds to 0, paused.
+  void Load(std::vector<Cue> cues);
+  void Clear() { Load({}); }
+
+  bool loaded() const { return !cues_.empty(); }
+  bool playing() const { return playing_; }
+  size_t size() const { return cues_.size(); }
+  const Cue& cue(size_t index) const { return cues_[index]; }
+
+  void Play(int64_t now_us);
+  void Pause(int64_t now_us);
+  void Seek(int64_t position_ms, int64_t now_us);
+  // Playback speed; 1 is real time. Negative rates are clamped to 0.
+  void SetRate(double rate, int64_t now_us);
+
+  // Track position at |now_us|.
+  int64_t PositionMs(int64_t now_us) const;
+  // The cue shown at |position_ms|, kNoCue for none. Of overlapping cues
+  // the one that started last wins.
+  size_t CueAt(int64_t position_ms) const;
+  // Monotonic time after |now_us| at which the next cue starts or ends,
+  // so the shown cue may change; -1 while paused, at rate 0 or after the
+  // last cue ended.
+  int64_t NextChangeUs(int64_t now_us) const;
+
+ private:
+  std::vector<Cue> cues_;  // by start
+  // reach_[i] is the latest end of cues_[0..i], bounding the search back.
+  std::vector<int64_t> reach_;
+  // Every cue start and end, sorted.
+  std::vector<int64_t> boundaries_;
+  bool playing_ = false;
+  double rate_ = 1;
+  // Position at anchor_us_, advanced at rate_ while playing.
+  int64_t anchor_ms_ = 0;
+  int64_t anchor_us_ = 0;
+};
+
+}  // namespace pip_plugin
+
+#endif  // FLUTTER_PLUGIN_CUE_TRACK_H_
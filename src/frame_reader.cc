@@ -0,0 +1,75 @@
+// frame_reader.cc
+#include "frame_reader.h"
+
+#include <algorithm>
+
+namespace pip_plugin {
+
+const size_t FrameReader::kMaxFrameLength;
+
+void FrameReader::Reset(Framing framing) {
+  framing_ = framing;
+  partial_.clear();
+  header_size_ = 0;
+  frame_length_ = 0;
+  frame_.clear();
+  has_frame_ = false;
+}
+
+bool FrameReader::Feed(const char* data, size_t length) {
+  const char* end = data + length;
+  if (framing_ == kLines) {
+    // Only the last complete line matters; it starts after the line break
+    // before it, or in the bytes held back from earlier feeds.
+    const char* last = end;
+    while (last > data && last[-1] != '\n') last--;
+    if (last == data) {
+      partial_.append(data, length);
+      return partial_.size() <= kMaxFrameLength;
+    }
+    const char* line_end = last - 1;
+    const char* line = line_end;
+    while (line > data && line[-1] != '\n') line--;
+    if (line == data) {
+      partial_.append(data, line_end - data);
+      frame_.swap(partial_);
+    } else {
+      frame_.assign(line, line_end);
+    }
+    if (!frame_.empty() && frame_.back() == '\r') frame_.pop_back();
+    has_frame_ = true;
+    partial_.assign(last, end);
+    return frame_.size() <= kMaxFrameLength &&
+           partial_.size() <= kMaxFrameLength;
+  }
+
+  while (data < end) {
+    if (header_size_ < 4) {
+      frame_length_ = frame_length_ << 8 | static_cast<unsigned char>(*data++);
+      if (++header_size_ < 4) continue;
+      if (frame_length_ > kMaxFrameLength) return false;
+      partial_.clear();
+    } else {
+      size_t take = std::min<size_t>(end - data,
+                                     frame_length_ - partial_.size());
+      partial_.append(data, take);
+      data += take;
+    }
+    if (partial_.size() == frame_length_) {
+      frame_.swap(partial_);
+      has_frame_ = true;
+      header_size_ = 0;
+      frame_length_ = 0;
+    }
+  }
+  return true;
+}
+
+bool FrameReader::TakeFrame(std::string* frame) {
+  if (!has_frame_) return false;
+  frame->swap(frame_);
+  has_frame_ = false;
+  return true;
+}
+
+}  // namespace pip_plugin
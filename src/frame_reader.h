@@ -0,0 +1,46 @@
+// frame_reader.h
+#ifndef FLUTTER_PLUGIN_FRAME_READER_H_
+#define FLUTTER_PLUGIN_FRAME_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace pip_plugin {
+
+// Splits the byte stream of a socket or pipe source into text frames:
+// lines ending in '\n', or frames prefixed with their length as a 32-bit
+// big-endian integer. Only the newest complete frame is kept, as only it
+// is shown; older lines are skipped without being copied.
+class FrameReader {
+ public:
+  enum Framing { kLines, kLengthPrefixed };
+
+  // Longer frames mean the stream is corrupt or not meant for PiP.
+  static const size_t kMaxFrameLength = 1 << 20;
+
+  // Starts over, as for a new connection.
+  void Reset(Framing framing);
+
+  // Feeds received bytes. Returns false if a frame exceeds
+  // kMaxFrameLength; the stream cannot be followed past it.
+  bool Feed(const char* data, size_t length);
+
+  // Moves the newest frame completed since the last call to |frame|.
+  // Returns false if there is none.
+  bool TakeFrame(std::string* frame);
+
+ private:
+  Framing framing_ = kLines;
+  // The incomplete frame, and for length-prefixed frames the bytes of
+  // its length read so far and the length itself.
+  std::string partial_;
+  size_t header_size_ = 0;
+  uint32_t frame_length_ = 0;
+  std::string frame_;
+  bool has_frame_ = false;
+};
+
+}  // namespace pip_plugin
+
+#endif  // FLUTTER_PLUGIN_FRAME_READER_H_
@@ -0,0 +1,123 @@
+// line_tail.cc
+#include "line_tail.h"
+
+#include <cstring>
+
+namespace pip_plugin {
+
+namespace {
+
+// Length of the UTF-8 |text| in UTF-16 code units.
+size_t Utf16Length(const std::string& text) {
+  size_t units = 0;
+  for (unsigned char c : text) {
+    if ((c & 0xC0) != 0x80) {
+      // Characters outside the BMP are a surrogate pair.
+      units += c >= 0xF0 ? 2 : 1;
+    }
+  }
+  return units;
+}
+
+}  // namespace
+
+const size_t LineTail::kMaxLineLength;
+
+void LineTail::Reset(size_t max_lines) {
+  ring_.assign(max_lines > 0 ? max_lines : 1, std::string());
+  head_ = 0;
+  count_ = 0;
+  partial_.clear();
+  text_size_ = 0;
+  text_units_ = 0;
+}
+
+LineTail::Edit LineTail::Feed(const char* data, size_t length) {
+  old_lines_ = count_;
+  dropped_old_ = 0;
+  dropped_size_ = 0;
+  dropped_units_ = 0;
+
+  const char* end = data + length;
+  while (data < end) {
+    const char* line_break =
+        static_cast<const char*>(memchr(data, '\n', end - data));
+    size_t take = (line_break != nullptr ? line_break : end) - data;
+    size_t room = kMaxLineLength - partial_.size();
+    if (take > room) {
+      partial_.append(data, room);
+      data += room;
+      // Break before a character rather than inside it: back up over at
+      // most three continuation bytes and carry them to the next line.
+      size_t cut = partial_.size();
+      unsigned char next = static_cast<unsigned char>(*data);
+      while ((next & 0xC0) == 0x80 && cut + 3 > partial_.size()) {
+        next = static_cast<unsigned char>(partial_[--cut]);
+      }
+      std::string rest = partial_.substr(cut);
+      partial_.resize(cut);
+      Push(&partial_);
+      partial_.swap(rest);
+      continue;
+    }
+    partial_.append(data, take);
+    data += take;
+    if (line_break == nullptr) {
+      break;
+    }
+    data++;
+    if (!partial_.empty() && partial_.back() == '\r') {
+      partial_.pop_back();
+    }
+    Push(&partial_);
+  }
+
+  // The lines from before this feed that are left, then the new ones.
+  Edit edit;
+  size_t kept_old = old_lines_ - dropped_old_;
+  if (kept_old == 0) {
+    edit.remove = text_size_;
+    edit.remove_units = text_units_;
+  } else {
+    edit.remove = dropped_size_;
+    edit.remove_units = dropped_units_;
+  }
+  for (size_t i = kept_old; i < count_; i++) {
+    if (i > 0) {
+      edit.append += '\n';
+    }
+    edit.append += line(i);
+  }
+  text_size_ = text_size_ - edit.remove + edit.append.size();
+  text_units_ = text_units_ - edit.remove_units + Utf16Length(edit.append);
+  return edit;
+}
+
+void LineTail::Push(std::string* line) {
+  if (count_ == ring_.size()) {
+    if (dropped_old_ < old_lines_) {
+      dropped_old_++;
+      dropped_size_ += ring_[head_].size() + 1;
+      dropped_units_ += Utf16Length(ring_[head_]) + 1;
+    }
+    head_ = (head_ + 1) % ring_.size();
+    count_--;
+  }
+  ring_[(head_ + count_) % ring_.size()].swap(*line);
+  count_++;
+  line->clear();
+}
+
+std::string LineTail::Text() const {
+  std::string text;
+  text.reserve(text_size_);
+  for (size_t i = 0; i < count_; i++) {
+    if (i > 0) {
+      text += '\n';
+    }
+    text += line(i);
+  }
+  return text;
+}
+
+}  // namespace pip_plugin
@@ -0,0 +1,70 @@
+// line_tail.h
+#ifndef FLUTTER_PLUGIN_LINE_TAIL_H_
+#define FLUTTER_PLUGIN_LINE_TAIL_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace pip_plugin {
+
+// The last lines of a growing file, as shown by the file tail mode: fed
+// with the bytes appended to the file, it keeps a bounded ring of complete
+// lines and reports each change as an edit of the shown text, so only the
+// new lines have to be laid out.
+class LineTail {
+ public:
+  // Longer lines are broken before the character that would not fit, so a
+  // file without line breaks stays bounded.
+  static const size_t kMaxLineLength = 16384;
+
+  // Change of the text by one Feed(): the first |remove| bytes, or
+  // |remove_units| UTF-16 code units, are dropped and |append| appended.
+  struct Edit {
+    size_t remove = 0;
+    size_t remove_units = 0;
+    std::string append;
+  };
+
+  // Drops all lines and keeps at most |max_lines| (at least one) from now.
+  void Reset(size_t max_lines);
+
+  // Feeds bytes appended to the file. A trailing incomplete line is held
+  // back until its line break arrives; "\r\n" counts as a line break.
+  Edit Feed(const char* data, size_t length);
+  // Drops the incomplete line, as the bytes after it were skipped or the
+  // file was truncated.
+  void Discard() { partial_.clear(); }
+
+  // The complete lines, joined by '\n'.
+  std::string Text() const;
+  // Length of Text() in bytes and in UTF-16 code units.
+  size_t size() const { return text_size_; }
+  size_t units() const { return text_units_; }
+  size_t lines() const { return count_; }
+
+ private:
+  const std::string& line(size_t index) const {
+    return ring_[(head_ + index) % ring_.size()];
+  }
+  // Appends |line|, dropping the oldest line when the ring is full.
+  void Push(std::string* line);
+
+  std::vector<std::string> ring_{1};
+  size_t head_ = 0;
+  size_t count_ = 0;
+  std::string partial_;
+  size_t text_size_ = 0;
+  size_t text_units_ = 0;
+
+  // Bookkeeping of the running Feed(): lines present before it that were
+  // dropped, and their length with the following line break.
+  size_t old_lines_ = 0;
+  size_t dropped_old_ = 0;
+  size_t dropped_size_ = 0;
+  size_t dropped_units_ = 0;
+};
+
+}  // namespace pip_plugin
+
+#endif  // FLUTTER_PLUGIN_LINE_TAIL_H_
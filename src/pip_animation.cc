@@ -0,0 +1,79 @@
+// pip_animation.cc
+#include "pip_animation.h"
+
+namespace pip_plugin {
+
+bool PipAnimation::ParseCurve(const std::string& name, Curve* curve) {
+  if (name == "linear") {
+    *curve = kLinear;
+  } else if (name == "easeIn") {
+    *curve = kEaseIn;
+  } else if (name == "easeOut") {
+    *curve = kEaseOut;
+  } else if (name == "easeInOut") {
+    *curve = kEaseInOut;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+double PipAnimation::Ease(Curve curve, double t) {
+  double u = 1 - t;
+  switch (curve) {
+    case kEaseIn:
+      return t * t * t;
+    case kEaseOut:
+      return 1 - u * u * u;
+    case kEaseInOut:
+      return t < 0.5 ? 4 * t * t * t : 1 - 4 * u * u * u;
+    case kLinear:
+    default:
+      return t;
+  }
+}
+
+void PipAnimation::Start(const double* from, const double* to,
+                         unsigned properties, int64_t duration_us,
+                         Curve curve, int64_t repeat, bool reverse,
+                         int64_t now_us) {
+  properties_ = properties & ((1u << kPropertyCount) - 1);
+  for (int p = 0; p < kPropertyCount; p++) {
+    from_[p] = from[p];
+    to_[p] = to[p];
+  }
+  duration_us_ = duration_us < 0 ? 0 : duration_us;
+  curve_ = curve;
+  repeat_ = repeat < 0 ? 0 : repeat;
+  reverse_ = reverse;
+  start_us_ = now_us;
+}
+
+bool PipAnimation::Sample(int64_t now_us, double* values) {
+  int64_t elapsed = now_us > start_us_ ? now_us - start_us_ : 0;
+  int64_t run = duration_us_ > 0 ? elapsed / duration_us_ : 0;
+  double t = duration_us_ > 0
+                 ? static_cast<double>(elapsed % duration_us_) / duration_us_
+                 : 1;
+  bool done = duration_us_ == 0 || (repeat_ > 0 && run >= repeat_);
+  if (done) {
+    run = repeat_ > 0 ? repeat_ - 1 : 0;
+    t = 1;
+  }
+  if (reverse_ && run % 2 == 1) {
+    t = 1 - t;
+  }
+
+  double progress = Ease(curve_, t);
+  for (int p = 0; p < kPropertyCount; p++) {
+    if (properties_ & (1u << p)) {
+      values[p] = from_[p] + (to_[p] - from_[p]) * progress;
+    }
+  }
+  if (done) {
+    properties_ = 0;
+  }
+  return !done;
+}
+
+}  // namespace pip_plugin
@@ -0,0 +1,66 @@
+// pip_animation.h
+#ifndef FLUTTER_PLUGIN_PIP_ANIMATION_H_
+#define FLUTTER_PLUGIN_PIP_ANIMATION_H_
+
+#include <cstdint>
+#include <string>
+
+namespace pip_plugin {
+
+// Style transition started by animate: the animated properties run from
+// their values at the start to the targets over the duration, sampled from
+// a monotonic time in microseconds on every frame.
+class PipAnimation {
+ public:
+  // Animatable style values. Color channels and alphas are 0..1.
+  enum Property {
+    kBackgroundRed,
+    kBackgroundGreen,
+    kBackgroundBlue,
+    kBackgroundAlpha,
+    kTextRed,
+    kTextGreen,
+    kTextBlue,
+    kTextAlpha,
+    kTextSize,
+    kPropertyCount,
+  };
+
+  enum Curve { kLinear, kEaseIn, kEaseOut, kEaseInOut };
+
+  // Reads the Dart names "linear", "easeIn", "easeOut" and "easeInOut".
+  static bool ParseCurve(const std::string& name, Curve* curve);
+  // Progress along |curve| at |t| in [0, 1]; the eased curves are cubic.
+  static double Ease(Curve curve, double t);
+
+  // Animates the properties whose bit is set in |properties| from |from|
+  // to |to|, both indexed by Property. The animation runs |repeat| times,
+  // or forever for 0 or less; with |reverse| every other run goes back.
+  void Start(const double* from, const double* to, unsigned properties,
+             int64_t duration_us, Curve curve, int64_t repeat, bool reverse,
+             int64_t now_us);
+  void Stop() { properties_ = 0; }
+
+  bool active() const { return properties_ != 0; }
+  // Bits of the animated properties.
+  unsigned properties() const { return properties_; }
+
+  // Writes the animated properties at |now_us| into |values|, indexed by
+  // Property. After the last run they hold its end values and the
+  // animation stops; returns false then.
+  bool Sample(int64_t now_us, double* values);
+
+ private:
+  unsigned properties_ = 0;
+  double from_[kPropertyCount] = {};
+  double to_[kPropertyCount] = {};
+  int64_t duration_us_ = 0;
+  Curve curve_ = kLinear;
+  int64_t repeat_ = 1;
+  bool reverse_ = false;
+  int64_t start_us_ = 0;
+};
+
+}  // namespace pip_plugin
+
+#endif  // FLUTTER_PLUGIN_PIP_ANIMATION_H_
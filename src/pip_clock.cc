@@ -0,0 +1,87 @@
+// pip_clock.cc
+#include "pip_clock.h"
+
+namespace pip_plugin {
+
+void PipClock::Start(bool countdown, int64_t start_ms,
+                     const std::string& format, int64_t now_us) {
+  active_ = true;
+  countdown_ = countdown;
+  start_ms_ = start_ms < 0 ? 0 : start_ms;
+  origin_us_ = now_us;
+  format_ = format.empty() ? "mm:ss" : format;
+}
+
+int64_t PipClock::ValueMs(int64_t now_us) const {
+  int64_t elapsed_ms = (now_us - origin_us_) / 1000;
+  if (!countdown_) {
+    return start_ms_ + elapsed_ms;
+  }
+  return elapsed_ms < start_ms_ ? start_ms_ - elapsed_ms : 0;
+}
+
+std::string PipClock::Text(int64_t now_us) const {
+  int64_t ms = ValueMs(now_us);
+  if (countdown_) {
+    // A countdown shows the started unit, so it reads zero only once it
+    // has run out.
+    int64_t resolution = 1000;
+    for (size_t i = format_.find('S'); i != std::string::npos &&
+                                       i < format_.size() &&
+                                       format_[i] == 'S' && resolution > 1;
+         i++) {
+      resolution /= 10;
+    }
+    ms = (ms + resolution - 1) / resolution * resolution;
+  }
+  return Format(format_, ms);
+}
+
+std::string PipClock::Format(const std::string& format, int64_t ms) {
+  bool has_hours = format.find('h') != std::string::npos;
+  bool has_minutes = format.find('m') != std::string::npos;
+  std::string text;
+  for (size_t i = 0; i < format.size();) {
+    char field = format[i];
+    size_t run = 1;
+    while (i + run < format.size() && format[i + run] == field) {
+      run++;
+    }
+    int64_t value;
+    size_t width = run;
+    switch (field) {
+      case 'h':
+        value = ms / 3600000;
+        break;
+      case 'm':
+        value = ms / 60000;
+        if (has_hours) value %= 60;
+        break;
+      case 's':
+        value = ms / 1000;
+        if (has_hours || has_minutes) value %= 60;
+        break;
+      case 'S':
+        // Truncated, so a digit changes on the boundary it names.
+        width = run < 3 ? run : 3;
+        value = ms % 1000;
+        for (size_t digits = 3; digits > width; digits--) {
+          value /= 10;
+        }
+        break;
+      default:
+        text.append(format, i, run);
+        i += run;
+        continue;
+    }
+    std::string digits = std::to_string(value);
+    if (digits.size() < width) {
+      text.append(width - digits.size(), '0');
+    }
+    text += digits;
+    i += run;
+  }
+  return text;
+}
+
+}  // namespace pip_plugin
@@ -0,0 +1,43 @@
+// pip_clock.h
+#ifndef FLUTTER_PLUGIN_PIP_CLOCK_H_
+#define FLUTTER_PLUGIN_PIP_CLOCK_H_
+
+#include <cstdint>
+#include <string>
+
+namespace pip_plugin {
+
+// Stopwatch or countdown shown by the clock content mode. Its value is
+// derived from a monotonic time in microseconds on every frame, so it
+// never drifts however late frames arrive.
+class PipClock {
+ public:
+  // Starts counting from |start_ms|, up or (|countdown|) down to zero.
+  // |format| spells fields as runs of h, m and s, and fractions of a
+  // second as one S per digit, e.g. "hh:mm:ss" or "mm:ss.S". The largest
+  // field present is not wrapped, so "mm:ss" shows 90:00 for 90 minutes.
+  // Other characters are copied.
+  void Start(bool countdown, int64_t start_ms, const std::string& format,
+             int64_t now_us);
+  void Stop() { active_ = false; }
+
+  bool active() const { return active_; }
+
+  // Milliseconds shown at |now_us|.
+  int64_t ValueMs(int64_t now_us) const;
+  // Text shown at |now_us|.
+  std::string Text(int64_t now_us) const;
+
+  static std::string Format(const std::string& format, int64_t ms);
+
+ private:
+  bool active_ = false;
+  bool countdown_ = false;
+  int64_t start_ms_ = 0;
+  int64_t origin_us_ = 0;
+  std::string format_;
+};
+
+}  // namespace pip_plugin
+
+#endif  // FLUTTER_PLUGIN_PIP_CLOCK_H_
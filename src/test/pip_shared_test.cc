@@ -0,0 +1,258 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "cue_track.h"
+#include "frame_reader.h"
+#include "line_tail.h"
+#include "pip_animation.h"
+#include "pip_clock.h"
+#include "text_fit.h"
+#include "text_ring.h"
+
+// Tests for the platform-independent helpers in src/. Both the Linux and the
+// Windows test runners build this file.
+
+namespace pip_plugin {
+namespace test {
+
+// Writes one record the way the Dart producer does.
+static uint64_t write_record(TextRing* ring, uint64_t index, uint32_t kind,
+                             const std::string& payload) {
+  const uint64_t size = (TextRing::kHeaderSize + payload.size() + 7) & ~7ull;
+  uint64_t offset = index & (ring->capacity() - 1);
+  if (ring->capacity() - offset < size) {
+    const uint32_t wrap = TextRing::kWrap;
+    memcpy(ring->data() + offset, &wrap, sizeof(wrap));
+    index += ring->capacity() - offset;
+    offset = 0;
+  }
+  const uint32_t length = static_cast<uint32_t>(payload.size());
+  memcpy(ring->data() + offset, &kind, sizeof(kind));
+  memcpy(ring->data() + offset + 4, &length, sizeof(length));
+  memcpy(ring->data() + offset + TextRing::kHeaderSize, payload.data(),
+         payload.size());
+  return index + size;
+}
+
+TEST(PipPlugin, ClockFormatsFields) {
+  // 1:30:23.456
+  const int64_t ms = 5423456;
+  EXPECT_EQ(PipClock::Format("hh:mm:ss", ms), "01:30:23");
+  EXPECT_EQ(PipClock::Format("mm:ss", ms), "90:23");
+  EXPECT_EQ(PipClock::Format("mm:ss.S", ms), "90:23.4");
+  EXPECT_EQ(PipClock::Format("h:mm:ss.SSS", ms), "1:30:23.456");
+
+  // A countdown reads zero only once it has run out.
+  PipClock clock;
+  clock.Start(true, 3000, "ss", 0);
+  EXPECT_EQ(clock.Text(200000), "03");
+  EXPECT_EQ(clock.Text(2500000), "01");
+  EXPECT_EQ(clock.Text(9000000), "00");
+}
+
+TEST(PipPlugin, CueTrackParsesAndSeeks) {
+  std::vector<Cue> cues;
+  ASSERT_TRUE(CueTrack::Parse(
+      "1\r\n00:00:01,000 --> 00:00:02,500\r\n<i>Hello</i>\r\nworld\r\n",
+      &cues));
+  EXPECT_EQ(cues[0].start_ms, 1000);
+  EXPECT_EQ(cues[0].end_ms, 2500);
+  EXPECT_EQ(cues[0].text, "Hello\nworld");
+
+  ASSERT_TRUE(CueTrack::Parse(
+      "WEBVTT\n\n00:01.000 --> 00:02.000 align:start\n<v Bob>Hi\n", &cues));
+  EXPECT_EQ(cues[0].text, "Hi");
+
+  // An LRC line lasts until the next one; tags may repeat a line.
+  ASSERT_TRUE(CueTrack::Parse(
+      "[ar:Someone]\n[00:10.50][00:30.00]Chorus\n[00:20.00]Verse\n", &cues));
+  ASSERT_EQ(cues.size(), 3u);
+  EXPECT_EQ(cues[0].end_ms, 20000);
+
+  CueTrack track;
+  track.Load(cues);
+  EXPECT_EQ(track.CueAt(5000), CueTrack::kNoCue);
+  EXPECT_EQ(track.CueAt(25000), 1u);
+
+  track.Play(0);
+  track.SetRate(2, 1000000);
+  EXPECT_EQ(track.PositionMs(2000000), 3000);
+  track.Pause(2000000);
+  track.Seek(21000, 3000000);
+  EXPECT_EQ(track.PositionMs(9000000), 21000);
+  EXPECT_EQ(track.NextChangeUs(9000000), -1);
+
+  // Boundaries are reached at the rate; the last line never ends.
+  track.Play(9000000);
+  EXPECT_EQ(track.NextChangeUs(9000000), 13500000);
+  track.Seek(31000, 9000000);
+  EXPECT_EQ(track.NextChangeUs(9000000), -1);
+}
+
+TEST(PipPlugin, AnimationEasesAndRepeats) {
+  PipAnimation::Curve curve;
+  ASSERT_TRUE(PipAnimation::ParseCurve("easeOut", &curve));
+  EXPECT_DOUBLE_EQ(PipAnimation::Ease(curve, 0.5), 0.875);
+  EXPECT_DOUBLE_EQ(PipAnimation::Ease(PipAnimation::kEaseInOut, 0.5), 0.5);
+  EXPECT_FALSE(PipAnimation::ParseCurve("bounce", &curve));
+
+  // A size pulse: up in the first run, back down in the second.
+  double from[PipAnimation::kPropertyCount] = {};
+  double to[PipAnimation::kPropertyCount] = {};
+  double values[PipAnimation::kPropertyCount] = {};
+  from[PipAnimation::kTextSize] = 20;
+  to[PipAnimation::kTextSize] = 40;
+  PipAnimation animation;
+  animation.Start(from, to, 1u << PipAnimation::kTextSize, 1000000,
+                  PipAnimation::kLinear, 2, true, 0);
+  EXPECT_TRUE(animation.Sample(250000, values));
+  EXPECT_DOUBLE_EQ(values[PipAnimation::kTextSize], 25);
+  EXPECT_TRUE(animation.Sample(1250000, values));
+  EXPECT_DOUBLE_EQ(values[PipAnimation::kTextSize], 35);
+  EXPECT_FALSE(animation.Sample(5000000, values));
+  EXPECT_DOUBLE_EQ(values[PipAnimation::kTextSize], 20);
+  EXPECT_FALSE(animation.active());
+
+  // A negative count repeats forever, like 0.
+  animation.Start(from, to, 1u << PipAnimation::kTextSize, 1000000,
+                  PipAnimation::kLinear, -1, false, 0);
+  EXPECT_TRUE(animation.Sample(5250000, values));
+  EXPECT_DOUBLE_EQ(values[PipAnimation::kTextSize], 25);
+  EXPECT_TRUE(animation.active());
+}
+
+TEST(PipPlugin, FrameReaderKeepsNewestFrame) {
+  FrameReader reader;
+  reader.Reset(FrameReader::kLines);
+  std::string frame;
+  EXPECT_TRUE(reader.Feed("12", 2));
+  EXPECT_FALSE(reader.TakeFrame(&frame));
+  EXPECT_TRUE(reader.Feed(":00\r\n12:01\n12:0", 15));
+  EXPECT_TRUE(reader.TakeFrame(&frame));
+  EXPECT_EQ(frame, "12:01");
+  EXPECT_TRUE(reader.Feed("2\n", 2));
+  EXPECT_TRUE(reader.TakeFrame(&frame));
+  EXPECT_EQ(frame, "12:02");
+
+  reader.Reset(FrameReader::kLengthPrefixed);
+  EXPECT_TRUE(reader.Feed("\0\0\0\2hi\0\0\0\3a\nb", 13));
+  EXPECT_TRUE(reader.TakeFrame(&frame));
+  EXPECT_EQ(frame, "a\nb");
+  EXPECT_FALSE(reader.TakeFrame(&frame));
+  // A length past the limit ends the stream.
+  EXPECT_FALSE(reader.Feed("\x7F\0\0\0", 4));
+}
+
+TEST(PipPlugin, LineTailKeepsLastLines) {
+  LineTail tail;
+  tail.Reset(2);
+  LineTail::Edit edit = tail.Feed("one\ntw", 6);
+  EXPECT_EQ(edit.remove, 0u);
+  EXPECT_EQ(edit.append, "one");
+
+  // The held back line completes and "one" is dropped.
+  edit = tail.Feed("o\r\nthree\n", 9);
+  EXPECT_EQ(edit.remove, 3u);
+  EXPECT_EQ(edit.append, "two\nthree");
+
+  // A kept line stays; the dropped one goes with its line break.
+  edit = tail.Feed("4\n", 2);
+  EXPECT_EQ(edit.remove, 4u);
+  EXPECT_EQ(edit.remove_units, 4u);
+  EXPECT_EQ(edit.append, "\n4");
+  EXPECT_EQ(tail.Text(), "three\n4");
+
+  // Lines dropped within one feed are never appended.
+  edit = tail.Feed("5\n\xC3\xA9\xF0\x9F\x98\x80\n", 9);
+  EXPECT_EQ(edit.remove_units, 7u);
+  EXPECT_EQ(edit.append, "5\n\xC3\xA9\xF0\x9F\x98\x80");
+  EXPECT_EQ(tail.units(), 5u);
+}
+
+TEST(PipPlugin, LineTailBreaksLongLines) {
+  const size_t max = LineTail::kMaxLineLength;
+  LineTail tail;
+  tail.Reset(3);
+
+  // A line of exactly the maximum length is not broken.
+  tail.Feed(std::string(max, 'a').data(), max);
+  tail.Feed("\nb\n", 3);
+  EXPECT_EQ(tail.lines(), 2u);
+  EXPECT_EQ(tail.Text(), std::string(max, 'a') + "\nb");
+
+  // A longer one is broken before the character that does not fit.
+  tail.Reset(3);
+  std::string line = std::string(max - 2, 'a') + "\xF0\x9F\x98\x80\n";
+  LineTail::Edit edit = tail.Feed(line.data(), line.size());
+  EXPECT_EQ(tail.lines(), 2u);
+  EXPECT_EQ(edit.append, std::string(max - 2, 'a') + "\n\xF0\x9F\x98\x80");
+  EXPECT_EQ(tail.units(), max - 2 + 1 + 2);
+}
+
+TEST(PipPlugin, TextRingDrainsRecordsInOrder) {
+  TextRing ring(64);
+  std::string text;
+  bool replace = false;
+  EXPECT_EQ(ring.Drain(&text, &replace), 0u);
+
+  uint64_t index = write_record(&ring, 0, TextRing::kSetText, "one");
+  index = write_record(&ring, index, TextRing::kAppendText, " two");
+  EXPECT_TRUE(ring.Publish(index));
+  EXPECT_EQ(ring.Drain(&text, &replace), 2u);
+  EXPECT_TRUE(replace);
+  EXPECT_EQ(text, "one two");
+
+  // A 24 byte record leaves 8 bytes at the end, so the next one wraps.
+  replace = false;
+  index = write_record(&ring, index, TextRing::kAppendText,
+                       std::string(16, 'x'));
+  index = write_record(&ring, index, TextRing::kAppendText, " three");
+  EXPECT_EQ(index, 80u);
+  ring.Publish(index);
+  EXPECT_EQ(ring.Drain(&text, &replace), 2u);
+  EXPECT_FALSE(replace);
+  EXPECT_EQ(text, "one two" + std::string(16, 'x') + " three");
+  EXPECT_EQ(ring.read_index(), index);
+  EXPECT_TRUE(ring.Sleep());
+}
+
+TEST(PipPlugin, TextFitMemoizesMeasurements) {
+  int calls = 0;
+  double width = 240;
+  // 40 characters, 0.6 of the size wide, wrapped into lines 1.25 tall.
+  TextFit::Measure measure = [&calls, &width](int size) {
+    calls++;
+    return std::ceil(40 * size * 0.6 / width) * size * 1.25;
+  };
+  TextFit fit;
+  EXPECT_EQ(fit.Fit(width, 100, 8, 512, measure), 26);
+  int first_calls = calls;
+  EXPECT_EQ(static_cast<size_t>(first_calls), fit.measured());
+
+  // The same text in the same box measures nothing again, and a box only
+  // as tall as another only measures the sizes not seen yet.
+  EXPECT_EQ(fit.Fit(width, 100, 8, 512, measure), 26);
+  EXPECT_EQ(calls, first_calls);
+  EXPECT_EQ(fit.Fit(width, 120, 8, 512, measure), 30);
+  EXPECT_LT(calls - first_calls, first_calls);
+
+  // Another width wraps the text differently and measures again.
+  width = 960;
+  int wide_calls = calls;
+  EXPECT_EQ(fit.Fit(width, 100, 8, 512, measure), 40);
+  EXPECT_EQ(static_cast<size_t>(calls - wide_calls), fit.measured());
+
+  // Nothing fits: the smallest size.
+  EXPECT_EQ(fit.Fit(width, 5, 8, 512, measure), 8);
+
+  fit.Reset();
+  EXPECT_EQ(fit.measured(), 0u);
+}
+
+}  // namespace test
+}  // namespace pip_plugin
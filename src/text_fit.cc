@@ -0,0 +1,30 @@
+// text_fit.cc
+#include "text_fit.h"
+
+namespace pip_plugin {
+
+int TextFit::Fit(double width, double height, int min_size, int max_size,
+                 const Measure& measure) {
+  if (width != width_) {
+    heights_.clear();
+    width_ = width;
+  }
+  // Bisects (low, high]; |low| is the answer when nothing larger fits.
+  int low = min_size;
+  int high = max_size;
+  while (low < high) {
+    int size = low + (high - low + 1) / 2;
+    auto it = heights_.find(size);
+    if (it == heights_.end()) {
+      it = heights_.emplace(size, measure(size)).first;
+    }
+    if (it->second <= height) {
+      low = size;
+    } else {
+      high = size - 1;
+    }
+  }
+  return low;
+}
+
+}  // namespace pip_plugin
@@ -0,0 +1,42 @@
+// text_fit.h
+#ifndef FLUTTER_PLUGIN_TEXT_FIT_H_
+#define FLUTTER_PLUGIN_TEXT_FIT_H_
+
+#include <cstddef>
+#include <functional>
+#include <map>
+
+namespace pip_plugin {
+
+// Largest text size at which the text fits a box, for the auto-fit mode.
+// Whole pixel sizes are bisected. The text is wrapped to the width of the
+// box, so only its height is compared. The heights measured at a size are
+// kept until the text or the width of the box changes, so fitting the same
+// text to a box only as tall as another measures only the sizes not seen
+// before.
+class TextFit {
+ public:
+  // Measures the height of the text at |size| pixels, wrapped to the width
+  // of the box.
+  typedef std::function<double(int size)> Measure;
+
+  // Forgets the measurements, as the text changed.
+  void Reset() { heights_.clear(); }
+
+  // The largest size in [|min_size|, |max_size|] whose height is at most
+  // |height| in a box |width| wide, or |min_size| if none is. Heights are
+  // assumed to grow with the size.
+  int Fit(double width, double height, int min_size, int max_size,
+          const Measure& measure);
+
+  // Sizes measured since the last Reset().
+  size_t measured() const { return heights_.size(); }
+
+ private:
+  std::map<int, double> heights_;
+  double width_ = 0;
+};
+
+}  // namespace pip_plugin
+
+#endif  // FLUTTER_PLUGIN_TEXT_FIT_H_
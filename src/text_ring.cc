@@ -0,0 +1,78 @@
+// text_ring.cc
+#include "text_ring.h"
+
+#include <cstring>
+
+namespace pip_plugin {
+
+TextRing::TextRing(uint32_t capacity) {
+  capacity_ = 64;
+  while (capacity_ < capacity && capacity_ < (1u << 30)) {
+    capacity_ <<= 1;
+  }
+  storage_.reset(new uint64_t[capacity_ / sizeof(uint64_t)]());
+  data_ = reinterpret_cast<uint8_t*>(storage_.get());
+}
+
+uint64_t TextRing::read_index() const {
+  return read_index_.load(std::memory_order_acquire);
+}
+
+uint64_t TextRing::write_index() const {
+  return write_index_.load(std::memory_order_relaxed);
+}
+
+bool TextRing::Publish(uint64_t write_index) {
+  write_index_.store(write_index);
+  return !awake_.exchange(true);
+}
+
+size_t TextRing::Drain(std::string* text, bool* replace) {
+  uint64_t read = read_index_.load(std::memory_order_relaxed);
+  uint64_t write = write_index_.load(std::memory_order_acquire);
+  if (read == write) {
+    return 0;
+  }
+
+  size_t records = 0;
+  while (read < write) {
+    uint32_t offset = static_cast<uint32_t>(read & (capacity_ - 1));
+    uint32_t kind;
+    uint32_t length;
+    memcpy(&kind, data_ + offset, sizeof(kind));
+    memcpy(&length, data_ + offset + sizeof(kind), sizeof(length));
+    if (kind == kWrap) {
+      read += capacity_ - offset;
+      continue;
+    }
+    if (length > capacity_ - offset - kHeaderSize) {
+      // A malformed record; drop everything published so far.
+      read = write;
+      break;
+    }
+    const char* payload =
+        reinterpret_cast<const char*>(data_ + offset + kHeaderSize);
+    if (kind == kSetText) {
+      text->assign(payload, length);
+      *replace = true;
+    } else if (kind == kAppendText) {
+      text->append(payload, length);
+    }
+    records++;
+    read += (kHeaderSize + length + 7) & ~static_cast<uint64_t>(7);
+  }
+  read_index_.store(read, std::memory_order_release);
+  return records;
+}
+
+bool TextRing::Sleep() {
+  awake_.store(false);
+  if (write_index_.load() == read_index_.load(std::memory_order_relaxed)) {
+    return true;
+  }
+  // Records arrived in between. If their producer saw the consumer idle it
+  // has already scheduled a wake-up; otherwise keep going.
+  return awake_.exchange(true);
+}
+
+}  // namespace pip_plugin
@@ -0,0 +1,57 @@
+// text_ring.h
+#ifndef FLUTTER_PLUGIN_TEXT_RING_H_
+#define FLUTTER_PLUGIN_TEXT_RING_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace pip_plugin {
+
+// Lock-free single-producer/single-consumer byte ring that Dart writes
+// through FFI (see include/pip_plugin/pip_plugin_ffi.h).
+//
+// Records start at 8-byte aligned offsets: a uint32 kind, a uint32 payload
+// length and the payload. A record never wraps; a kWrap header pads the
+// rest of the ring instead. Indices only grow and are masked by the
+// power-of-two capacity.
+class TextRing {
+ public:
+  enum Kind : uint32_t { kWrap = 0, kSetText = 1, kAppendText = 2 };
+  static const uint32_t kHeaderSize = 8;
+
+  // |capacity| is rounded up to a power of two of at least 64 bytes.
+  explicit TextRing(uint32_t capacity);
+
+  uint8_t* data() { return data_; }
+  uint32_t capacity() const { return capacity_; }
+
+  // Producer side. Records before read_index() may be overwritten; a new
+  // producer resumes at write_index().
+  uint64_t read_index() const;
+  uint64_t write_index() const;
+  // Makes the records before |write_index| visible. Returns true if the
+  // consumer went idle and has to be woken.
+  bool Publish(uint64_t write_index);
+
+  // Consumer side. Applies every published record to |text| in order:
+  // kSetText replaces it and sets |*replace|, kAppendText appends to it.
+  // Returns the number of records applied, 0 if there was nothing to read.
+  size_t Drain(std::string* text, bool* replace);
+  // Marks the consumer idle. Returns false if records were published in
+  // the meantime without waking it, so the caller must keep draining.
+  bool Sleep();
+
+ private:
+  std::unique_ptr<uint64_t[]> storage_;
+  uint8_t* data_;
+  uint32_t capacity_;
+  std::atomic<uint64_t> write_index_{0};
+  std::atomic<uint64_t> read_index_{0};
+  std::atomic<bool> awake_{false};
+};
+
+}  // namespace pip_plugin
+
+#endif  // FLUTTER_PLUGIN_TEXT_RING_H_
@@ -0,0 +1,520 @@
+// direct_write_renderer.cpp
+#include "direct_write_renderer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace pip_plugin {
+
+using Microsoft::WRL::ComPtr;
+
+namespace {
+
+D2D1_COLOR_F ToColorF(COLORREF color, BYTE alpha) {
+  return D2D1::ColorF(GetRValue(color) / 255.0f,
+                      GetGValue(color) / 255.0f,
+                      GetBValue(color) / 255.0f,
+                      alpha / 255.0f);
+}
+
+DWRITE_TEXT_ALIGNMENT ToTextAlignment(UINT text_format) {
+  if (text_format & DT_RIGHT)  return DWRITE_TEXT_ALIGNMENT_TRAILING;
+  if (text_format & DT_CENTER) return DWRITE_TEXT_ALIGNMENT_CENTER;
+  return DWRITE_TEXT_ALIGNMENT_LEADING;
+}
+
+// Height of the formatted text, capped at the layout box it is trimmed to.
+float LayoutHeight(IDWriteTextLayout* layout) {
+  DWRITE_TEXT_METRICS metrics = {};
+  layout->GetMetrics(&metrics);
+  return metrics.height < metrics.layoutHeight ? metrics.height
+                                               : metrics.layoutHeight;
+}
+
+// The UTF-8 |size| bytes at |data| as UTF-16.
+std::wstring WidenUtf8(const char* data, size_t size) {
+  std::wstring text;
+  int bytes = static_cast<int>(size);
+  int length = MultiByteToWideChar(CP_UTF8, 0, data, bytes, nullptr, 0);
+  if (length > 0) {
+    text.resize(length);
+    MultiByteToWideChar(CP_UTF8, 0, data, bytes, &text[0], length);
+  }
+  return text;
+}
+
+}  // namespace
+
+DirectWriteDevice::DirectWriteDevice() = default;
+
+DirectWriteDevice::~DirectWriteDevice() = default;
+
+bool DirectWriteDevice::Create() {
+  if (dcomp_device_) return true;
+
+  if (!d2d_factory_ &&
+      FAILED(D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED,
+                               d2d_factory_.GetAddressOf()))) {
+    return false;
+  }
+  if (!dwrite_factory_ &&
+      FAILED(DWriteCreateFactory(
+          DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory),
+          reinterpret_cast<IUnknown**>(dwrite_factory_.GetAddressOf())))) {
+    return false;
+  }
+
+  // Prefer the GPU; WARP keeps the backend usable on machines without one.
+  const UINT flags = D3D11_CREATE_DEVICE_BGRA_SUPPORT;
+  HRESULT hr = D3D11CreateDevice(
+      nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, flags, nullptr, 0,
+      D3D11_SDK_VERSION, d3d_device_.GetAddressOf(), nullptr, nullptr);
+  if (FAILED(hr)) {
+    hr = D3D11CreateDevice(
+        nullptr, D3D_DRIVER_TYPE_WARP, nullptr, flags, nullptr, 0,
+        D3D11_SDK_VERSION, d3d_device_.GetAddressOf(), nullptr, nullptr);
+  }
+  if (FAILED(hr)) return false;
+
+  ComPtr<IDXGIDevice> dxgi_device;
+  if (FAILED(d3d_device_.As(&dxgi_device)) ||
+      FAILED(d2d_factory_->CreateDevice(dxgi_device.Get(),
+                                        d2d_device_.GetAddressOf())) ||
+      FAILED(d2d_device_->CreateDeviceContext(
+          D2D1_DEVICE_CONTEXT_OPTIONS_NONE,
+          resource_context_.GetAddressOf())) ||
+      FAILED(DCompositionCreateDevice(
+          dxgi_device.Get(), IID_PPV_ARGS(dcomp_device_.GetAddressOf())))) {
+    ReleaseDevice();
+    return false;
+  }
+  ++generation_;
+  return true;
+}
+
+bool DirectWriteDevice::Recreate() {
+  ReleaseDevice();
+  return Create();
+}
+
+void DirectWriteDevice::ReleaseDevice() {
+  resource_context_.Reset();
+  d2d_device_.Reset();
+  dcomp_device_.Reset();
+  d3d_device_.Reset();
+}
+
+IDWriteTextFormat* DirectWriteDevice::TextFormat(float size) {
+  ComPtr<IDWriteTextFormat>& format = text_formats_[size];
+  if (format) return format.Get();
+
+  if (FAILED(dwrite_factory_->CreateTextFormat(
+          L"Consolas", nullptr, DWRITE_FONT_WEIGHT_BOLD,
+          DWRITE_FONT_STYLE_NORMAL, DWRITE_FONT_STRETCH_NORMAL, size, L"",
+          format.GetAddressOf()))) {
+    text_formats_.erase(size);
+    return nullptr;
+  }
+  format->SetWordWrapping(DWRITE_WORD_WRAPPING_WRAP);
+
+  // Text that does not fit is cut at a character boundary with an ellipsis
+  // instead of spilling out of the window.
+  DWRITE_TRIMMING trimming = {DWRITE_TRIMMING_GRANULARITY_CHARACTER, 0, 0};
+  ComPtr<IDWriteInlineObject> ellipsis;
+  if (SUCCEEDED(dwrite_factory_->CreateEllipsisTrimmingSign(
+          format.Get(), ellipsis.GetAddressOf()))) {
+    format->SetTrimming(&trimming, ellipsis.Get());
+  }
+  return format.Get();
+}
+
+DirectWriteRenderer::DirectWriteRenderer(
+    std::shared_ptr<DirectWriteDevice> device)
+    : device_(std::move(device)) {}
+
+DirectWriteRenderer::~DirectWriteRenderer() {
+  DetachWindow();
+}
+
+bool DirectWriteRenderer::AttachWindow(HWND hwnd) {
+  IDCompositionDevice* dcomp_device = device_->dcomp_device();
+  if (!dcomp_device) return false;
+  DetachWindow();
+  if (FAILED(dcomp_device->CreateTargetForHwnd(
+          hwnd, TRUE, dcomp_target_.GetAddressOf())) ||
+      FAILED(dcomp_device->CreateVisual(dcomp_visual_.GetAddressOf())) ||
+      FAILED(dcomp_target_->SetRoot(dcomp_visual_.Get()))) {
+    DetachWindow();
+    return false;
+  }
+  hwnd_ = hwnd;
+  generation_ = device_->generation();
+  return true;
+}
+
+void DirectWriteRenderer::DetachWindow() {
+  surface_.Reset();
+  dcomp_visual_.Reset();
+  dcomp_target_.Reset();
+  text_brush_.Reset();
+  surface_width_ = 0;
+  surface_height_ = 0;
+  stretched_ = false;
+  hwnd_ = nullptr;
+}
+
+void DirectWriteRenderer::SpliceText(const std::wstring& text, size_t start,
+                                     size_t old_end, size_t new_end) {
+  // Paragraphs [first, last) overlap the edit. One ending exactly at
+  // |start| is included, as the edit may remove its line break.
+  size_t first = 0;
+  while (first < paragraphs_.size() &&
+         paragraphs_[first].start + paragraphs_[first].length < start) {
+    ++first;
+  }
+  size_t last = first;
+  while (last < paragraphs_.size() && paragraphs_[last].start <= old_end) {
+    ++last;
+  }
+
+  size_t region_start = 0;
+  size_t region_end = text.size();
+  if (first < last) {
+    const Paragraph& tail = paragraphs_[last - 1];
+    region_start = paragraphs_[first].start;
+    region_end = tail.start + tail.length + new_end - old_end;
+  }
+
+  std::vector<Paragraph> pieces;
+  for (size_t piece_start = region_start;;) {
+    size_t end = text.find(L'\n', piece_start);
+    if (end == std::wstring::npos || end > region_end) end = region_end;
+    Paragraph piece = {};
+    piece.start = piece_start;
+    piece.length = end - piece_start;
+    pieces.push_back(piece);
+    if (end == region_end) break;
+    piece_start = end + 1;
+  }
+
+  for (size_t i = last; i < paragraphs_.size(); ++i) {
+    paragraphs_[i].start = paragraphs_[i].start + new_end - old_end;
+  }
+  if (first_laid_out_ > first) {
+    first_laid_out_ = first_laid_out_ >= last
+                          ? first_laid_out_ + pieces.size() - (last - first)
+                          : first;
+  }
+  paragraphs_.erase(paragraphs_.begin() + first, paragraphs_.begin() + last);
+  paragraphs_.insert(paragraphs_.begin() + first, pieces.begin(),
+                     pieces.end());
+}
+
+void DirectWriteRenderer::MapText(const char* data, size_t size) {
+  paragraphs_.clear();
+  mapped_data_ = data;
+  for (size_t start = 0;;) {
+    const void* line_break = memchr(data + start, '\n', size - start);
+    size_t end = line_break
+                     ? static_cast<const char*>(line_break) - data
+                     : size;
+    Paragraph paragraph = {};
+    paragraph.start = start;
+    paragraph.length = end - start;
+    paragraphs_.push_back(paragraph);
+    if (end == size) break;
+    start = end + 1;
+  }
+  first_laid_out_ = paragraphs_.size();
+}
+
+void DirectWriteRenderer::ResetText() {
+  paragraphs_.clear();
+  first_laid_out_ = 0;
+  mapped_data_ = nullptr;
+}
+
+bool DirectWriteRenderer::EnsureTextLayout(const Frame& frame,
+                                           int width, int height) {
+  IDWriteTextFormat* format = device_->TextFormat(frame.text_size);
+  if (!format) return false;
+  if (text_format_.Get() != format) {
+    text_format_ = format;
+    for (size_t i = first_laid_out_; i < paragraphs_.size(); ++i) {
+      paragraphs_[i].layout.Reset();
+    }
+  }
+
+  if (paragraphs_.empty()) {
+    SpliceText(*frame.text, 0, 0, frame.text->size());
+  }
+
+  // Resizing or re-aligning only re-wraps the existing layouts.
+  DWRITE_TEXT_ALIGNMENT alignment = ToTextAlignment(frame.text_format);
+  bool relayout = width != layout_width_ || height != layout_height_ ||
+                  alignment != alignment_;
+
+  // A block taller than the window is anchored to the bottom, so only the
+  // paragraphs from the end up to the visible top are laid out. A frame
+  // scaled down shows more above the center.
+  float center = height / 2.0f;
+  float visible = std::max(static_cast<float>(height),
+                           center + center / frame.text_scale);
+  size_t first = paragraphs_.size();
+  block_height_ = 0.0f;
+  while (first > 0 && block_height_ < visible) {
+    Paragraph& paragraph = paragraphs_[--first];
+    if (!paragraph.layout) {
+      std::wstring mapped;
+      if (mapped_data_) {
+        mapped = WidenUtf8(mapped_data_ + paragraph.start, paragraph.length);
+      }
+      const wchar_t* text = mapped_data_
+                                ? mapped.c_str()
+                                : frame.text->c_str() + paragraph.start;
+      UINT32 length = static_cast<UINT32>(mapped_data_ ? mapped.size()
+                                                       : paragraph.length);
+      if (FAILED(device_->dwrite_factory()->CreateTextLayout(
+              text, length, text_format_.Get(), static_cast<FLOAT>(width),
+              static_cast<FLOAT>(height), paragraph.layout.GetAddressOf()))) {
+        first_laid_out_ = std::min(first_laid_out_, first + 1);
+        return false;
+      }
+      paragraph.layout->SetTextAlignment(alignment);
+      paragraph.height = LayoutHeight(paragraph.layout.Get());
+    } else if (relayout) {
+      paragraph.layout->SetMaxWidth(static_cast<FLOAT>(width));
+      paragraph.layout->SetMaxHeight(static_cast<FLOAT>(height));
+      paragraph.layout->SetTextAlignment(alignment);
+      paragraph.height = LayoutHeight(paragraph.layout.Get());
+    }
+    block_height_ += paragraph.height;
+  }
+  // Layouts scrolled out above are released.
+  for (size_t i = first_laid_out_; i < first; ++i) {
+    paragraphs_[i].layout.Reset();
+  }
+  first_laid_out_ = first;
+  layout_width_ = width;
+  layout_height_ = height;
+  alignment_ = alignment;
+  return true;
+}
+
+bool DirectWriteRenderer::EnsureSurface(int width, int height,
+                                        bool* created) {
+  *created = false;
+  if (surface_ && width == surface_width_ && height == surface_height_) {
+    return true;
+  }
+  surface_.Reset();
+  if (FAILED(device_->dcomp_device()->CreateSurface(
+          width, height, DXGI_FORMAT_B8G8R8A8_UNORM,
+          DXGI_ALPHA_MODE_PREMULTIPLIED, surface_.GetAddressOf()))) {
+    return false;
+  }
+  dcomp_visual_->SetContent(surface_.Get());
+  surface_width_ = width;
+  surface_height_ = height;
+  *created = true;
+  return true;
+}
+
+bool DirectWriteRenderer::EnsureBrush(const Frame& frame) {
+  return text_brush_ ||
+         SUCCEEDED(device_->resource_context()->CreateSolidColorBrush(
+             ToColorF(frame.text_color, frame.text_alpha),
+             text_brush_.GetAddressOf()));
+}
+
+bool DirectWriteRenderer::BeginDraw(const RECT& update,
+                                    ComPtr<ID2D1DeviceContext>* dc) {
+  POINT offset = {};
+  HRESULT hr = surface_->BeginDraw(&update, IID_PPV_ARGS(dc->GetAddressOf()),
+                                   &offset);
+  if (FAILED(hr)) {
+    if (hr == DXGI_ERROR_DEVICE_REMOVED || hr == DXGI_ERROR_DEVICE_RESET) {
+      // Rebuild the shared stack; every window attaches to it again on its
+      // next frame.
+      if (device_->Recreate()) AttachWindow(hwnd_);
+    }
+    return false;
+  }
+  (*dc)->SetTransform(D2D1::Matrix3x2F::Translation(
+      static_cast<FLOAT>(offset.x - update.left),
+      static_cast<FLOAT>(offset.y - update.top)));
+  return true;
+}
+
+void DirectWriteRenderer::ApplyScale(ID2D1DeviceContext* dc, float scale,
+                                     int width, int height) {
+  D2D1::Matrix3x2F surface;
+  dc->GetTransform(&surface);
+  dc->SetTransform(
+      D2D1::Matrix3x2F::Scale(scale, scale,
+                              D2D1::Point2F(width / 2.0f, height / 2.0f)) *
+      surface);
+}
+
+bool DirectWriteRenderer::PresentStretched(int width, int height) {
+  if (!hwnd_ || !surface_ || generation_ != device_->generation() ||
+      surface_width_ <= 0 || surface_height_ <= 0) {
+    return false;
+  }
+  dcomp_visual_->SetTransform(D2D1::Matrix3x2F::Scale(
+      static_cast<FLOAT>(width) / surface_width_,
+      static_cast<FLOAT>(height) / surface_height_));
+  stretched_ = true;
+  return SUCCEEDED(device_->dcomp_device()->Commit());
+}
+
+void DirectWriteRenderer::EndStretch() {
+  if (!stretched_) return;
+  dcomp_visual_->SetTransform(D2D1::Matrix3x2F::Identity());
+  stretched_ = false;
+}
+
+bool DirectWriteRenderer::Render(const Frame& frame, int width, int height) {
+  if (!hwnd_) return false;
+  // Another window rebuilt the shared devices.
+  if (generation_ != device_->generation() && !AttachWindow(hwnd_)) {
+    return false;
+  }
+
+  bool created;
+  if (!EnsureSurface(width, height, &created) || !EnsureBrush(frame) ||
+      !EnsureTextLayout(frame, width, height)) {
+    return false;
+  }
+  EndStretch();
+
+  ComPtr<ID2D1DeviceContext> dc;
+  RECT update = {0, 0, width, height};
+  if (!BeginDraw(update, &dc)) return false;
+
+  dc->Clear(ToColorF(frame.background_color, frame.background_alpha));
+  text_brush_->SetColor(ToColorF(frame.text_color, frame.text_alpha));
+
+  // A scaled frame shows a taller span of the layout.
+  float visible_top = 0.0f;
+  float visible_bottom = static_cast<float>(height);
+  if (frame.text_scale != 1.0f) {
+    float center = height / 2.0f;
+    ApplyScale(dc.Get(), frame.text_scale, width, height);
+    visible_top = center - center / frame.text_scale;
+    visible_bottom = center + center / frame.text_scale;
+  }
+
+  // Paragraphs are stacked and centered; a block taller than the window is
+  // anchored to the bottom so the newest text stays visible.
+  float top = block_height_ <= height ? (height - block_height_) / 2
+                                      : height - block_height_;
+  for (size_t i = first_laid_out_; i < paragraphs_.size(); ++i) {
+    const Paragraph& paragraph = paragraphs_[i];
+    if (top >= visible_bottom) break;
+    if (top + paragraph.height > visible_top) {
+      dc->DrawTextLayout(D2D1::Point2F(0.0f, top), paragraph.layout.Get(),
+                         text_brush_.Get());
+    }
+    top += paragraph.height;
+  }
+
+  if (FAILED(surface_->EndDraw())) return false;
+  return SUCCEEDED(device_->dcomp_device()->Commit());
+}
+
+IDWriteTextLayout* DirectWriteRenderer::CellLayout(wchar_t c) {
+  ComPtr<IDWriteTextLayout>& layout = cell_layouts_[c];
+  if (!layout &&
+      SUCCEEDED(device_->dwrite_factory()->CreateTextLayout(
+          &c, 1, cell_format_.Get(), cell_width_, cell_height_,
+          layout.GetAddressOf()))) {
+    layout->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_CENTER);
+    layout->SetWordWrapping(DWRITE_WORD_WRAPPING_NO_WRAP);
+  }
+  return layout.Get();
+}
+
+bool DirectWriteRenderer::RenderCells(const Frame& frame, int width,
+                                      int height, size_t first, size_t last) {
+  if (!hwnd_) return false;
+  if (generation_ != device_->generation() && !AttachWindow(hwnd_)) {
+    return false;
+  }
+
+  IDWriteTextFormat* format = device_->TextFormat(frame.text_size);
+  bool created;
+  if (!format || !EnsureSurface(width, height, &created) ||
+      !EnsureBrush(frame)) {
+    return false;
+  }
+  if (cell_format_.Get() != format) {
+    // Measure the digits once per text size; every cell is as wide as the
+    // widest so a changing digit never moves its neighbours.
+    cell_format_ = format;
+    cell_layouts_.clear();
+    cell_width_ = 0.0f;
+    cell_height_ = 0.0f;
+    for (wchar_t digit = L'0'; digit <= L'9'; ++digit) {
+      ComPtr<IDWriteTextLayout> layout;
+      if (FAILED(device_->dwrite_factory()->CreateTextLayout(
+              &digit, 1, format, 10000.0f, 10000.0f,
+              layout.GetAddressOf()))) {
+        cell_format_.Reset();
+        return false;
+      }
+      DWRITE_TEXT_METRICS metrics = {};
+      layout->GetMetrics(&metrics);
+      cell_width_ = std::max(cell_width_, metrics.widthIncludingTrailingWhitespace);
+      cell_height_ = std::max(cell_height_, metrics.height);
+    }
+  }
+
+  const std::wstring& text = *frame.text;
+  last = std::min(last, text.size());
+  if (created || first >= last || frame.text_scale != 1.0f) {
+    first = 0;
+    last = text.size();
+  }
+  bool whole = first == 0 && last == text.size();
+  if (whole) EndStretch();
+
+  float total = cell_width_ * text.size();
+  float x = 0.0f;
+  DWRITE_TEXT_ALIGNMENT alignment = ToTextAlignment(frame.text_format);
+  if (alignment == DWRITE_TEXT_ALIGNMENT_CENTER) x = (width - total) / 2;
+  if (alignment == DWRITE_TEXT_ALIGNMENT_TRAILING) x = width - total;
+  float y = (height - cell_height_) / 2;
+
+  RECT update = {0, 0, width, height};
+  if (!whole) {
+    update.left = std::max(0L, static_cast<LONG>(x + cell_width_ * first));
+    update.top = std::max(0L, static_cast<LONG>(y));
+    update.right = std::min(static_cast<LONG>(width),
+                            static_cast<LONG>(x + cell_width_ * last) + 1);
+    update.bottom = std::min(static_cast<LONG>(height),
+                             static_cast<LONG>(y + cell_height_) + 1);
+    if (update.left >= update.right || update.top >= update.bottom) {
+      return true;
+    }
+  }
+
+  ComPtr<ID2D1DeviceContext> dc;
+  if (!BeginDraw(update, &dc)) return false;
+  dc->Clear(ToColorF(frame.background_color, frame.background_alpha));
+  text_brush_->SetColor(ToColorF(frame.text_color, frame.text_alpha));
+  if (frame.text_scale != 1.0f) {
+    ApplyScale(dc.Get(), frame.text_scale, width, height);
+  }
+  for (size_t i = first; i < last; ++i) {
+    IDWriteTextLayout* layout = CellLayout(text[i]);
+    if (!layout) continue;
+    dc->DrawTextLayout(D2D1::Point2F(x + cell_width_ * i, y), layout,
+                       text_brush_.Get());
+  }
+
+  if (FAILED(surface_->EndDraw())) return false;
+  return SUCCEEDED(device_->dcomp_device()->Commit());
+}
+
+}  // namespace pip_plugin
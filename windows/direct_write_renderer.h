@@ -0,0 +1,180 @@
+// direct_write_renderer.h
+#ifndef FLUTTER_PLUGIN_DIRECT_WRITE_RENDERER_H_
+#define FLUTTER_PLUGIN_DIRECT_WRITE_RENDERER_H_
+
+#include <windows.h>
+#include <d2d1_1.h>
+#include <d3d11.h>
+#include <dcomp.h>
+#include <dwrite.h>
+#include <wrl/client.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace pip_plugin {
+
+// Factories, devices and text formats shared by the renderers of every PiP
+// window, so another window costs only its own surface and layouts.
+class DirectWriteDevice {
+ public:
+  DirectWriteDevice();
+  ~DirectWriteDevice();
+
+  // Creates the factories and the D3D/D2D/DirectComposition devices. Must
+  // succeed before a window is created with WS_EX_NOREDIRECTIONBITMAP;
+  // returns false when any part of the stack is unavailable.
+  bool Create();
+
+  // Rebuilds the devices after DXGI reported them removed or reset. Text
+  // formats are device independent and are kept.
+  bool Recreate();
+
+  // Changes whenever the devices are rebuilt; renderers attached to an
+  // older generation have to attach again.
+  unsigned generation() const { return generation_; }
+
+  IDWriteFactory*      dwrite_factory() const { return dwrite_factory_.Get(); }
+  ID2D1DeviceContext*  resource_context() const {
+    return resource_context_.Get();
+  }
+  IDCompositionDevice* dcomp_device() const { return dcomp_device_.Get(); }
+
+  // The bold, wrapping, ellipsis-trimmed text format for |size|, created
+  // once and shared by every window using that size.
+  IDWriteTextFormat* TextFormat(float size);
+
+ private:
+  void ReleaseDevice();
+
+  Microsoft::WRL::ComPtr<ID2D1Factory1>          d2d_factory_;
+  Microsoft::WRL::ComPtr<IDWriteFactory>         dwrite_factory_;
+  Microsoft::WRL::ComPtr<ID3D11Device>           d3d_device_;
+  Microsoft::WRL::ComPtr<ID2D1Device>            d2d_device_;
+  Microsoft::WRL::ComPtr<ID2D1DeviceContext>     resource_context_;
+  Microsoft::WRL::ComPtr<IDCompositionDevice>    dcomp_device_;
+
+  std::map<float, Microsoft::WRL::ComPtr<IDWriteTextFormat>> text_formats_;
+
+  unsigned generation_ = 0;
+};
+
+// Renders the contents of one PiP window with Direct2D/DirectWrite into a
+// DirectComposition surface. Unlike the GDI path, background and text keep
+// independent per-pixel alpha, and one layout per '\n'-separated paragraph
+// is cached across frames.
+class DirectWriteRenderer {
+ public:
+  struct Frame {
+    const std::wstring* text;
+    COLORREF            background_color;
+    BYTE                background_alpha;
+    COLORREF            text_color;
+    BYTE                text_alpha;
+    float               text_size;
+    UINT                text_format;  // DT_LEFT/DT_CENTER/DT_RIGHT
+    // Scale of the contents about the center while a size tween runs; the
+    // text stays laid out at |text_size|.
+    float               text_scale;
+  };
+
+  explicit DirectWriteRenderer(std::shared_ptr<DirectWriteDevice> device);
+  ~DirectWriteRenderer();
+
+  // Binds the composition target to |hwnd|.
+  bool AttachWindow(HWND hwnd);
+  void DetachWindow();
+
+  // Draws |frame| at |width| x |height| pixels and commits it. Returns
+  // false if nothing could be presented; the caller should retry later.
+  bool Render(const Frame& frame, int width, int height);
+
+  // Re-splits the paragraphs touched by an edit that replaced code units
+  // [|start|, |old_end|) of the text with what is now [|start|, |new_end|)
+  // of |text|. Only those paragraphs are laid out again by the next
+  // Render(); the others keep their layouts.
+  void SpliceText(const std::wstring& text, size_t start, size_t old_end,
+                  size_t new_end);
+
+  // Renders the |size| UTF-8 bytes at |data| instead of the text of the
+  // frames, until ResetText(). Paragraphs are found without converting
+  // the bytes, and only those that can be visible are converted and laid
+  // out. |data| has to stay valid until then.
+  void MapText(const char* data, size_t size);
+  // Drops the paragraphs and the mapped text; the next Render() splits the
+  // text of its frame again.
+  void ResetText();
+
+  // Clock mode: draws the text of |frame| as one row of cells as wide as
+  // the widest digit, each drawn from a glyph layout cached per character.
+  // Only cells [|first|, |last|) are drawn into the retained surface,
+  // unless the surface has to be drawn whole anyway.
+  bool RenderCells(const Frame& frame, int width, int height,
+                   size_t first = 0, size_t last = SIZE_MAX);
+
+  // Live resize: shows the frame drawn last stretched to |width| x
+  // |height| by the composition visual, without drawing. The next frame
+  // drawn whole ends the stretch. Returns false if there is no frame.
+  bool PresentStretched(int width, int height);
+
+ private:
+  // Spans code units of the text, or bytes of a mapped text.
+  struct Paragraph {
+    size_t                                    start;
+    size_t                                    length;
+    Microsoft::WRL::ComPtr<IDWriteTextLayout> layout;
+    float                                     height;
+  };
+
+  bool EnsureTextLayout(const Frame& frame, int width, int height);
+  // (Re)creates the surface for |width| x |height|; sets |*created| if
+  // it has no content yet.
+  bool EnsureSurface(int width, int height, bool* created);
+  bool EnsureBrush(const Frame& frame);
+  // Starts drawing |update| of the surface, translated to surface
+  // coordinates. Rebuilds the devices if they were lost.
+  bool BeginDraw(const RECT& update,
+                 Microsoft::WRL::ComPtr<ID2D1DeviceContext>* dc);
+  IDWriteTextLayout* CellLayout(wchar_t c);
+  // Drops the stretch of PresentStretched(); committed with the next frame.
+  void EndStretch();
+  // Scales what |dc| draws next by |scale| about the center of the
+  // |width| x |height| surface.
+  void ApplyScale(ID2D1DeviceContext* dc, float scale, int width,
+                  int height);
+
+  std::shared_ptr<DirectWriteDevice>             device_;
+  Microsoft::WRL::ComPtr<IDCompositionTarget>    dcomp_target_;
+  Microsoft::WRL::ComPtr<IDCompositionVisual>    dcomp_visual_;
+  Microsoft::WRL::ComPtr<IDCompositionSurface>   surface_;
+  Microsoft::WRL::ComPtr<ID2D1SolidColorBrush>   text_brush_;
+  Microsoft::WRL::ComPtr<IDWriteTextFormat>      text_format_;
+
+  // Only the bottom of the block that can be visible is laid out:
+  // paragraphs [first_laid_out_, end) have layouts.
+  std::vector<Paragraph> paragraphs_;
+  size_t                 first_laid_out_ = 0;
+  const char*            mapped_data_    = nullptr;
+
+  // Clock cells, laid out with |cell_format_|.
+  Microsoft::WRL::ComPtr<IDWriteTextFormat>      cell_format_;
+  std::map<wchar_t, Microsoft::WRL::ComPtr<IDWriteTextLayout>> cell_layouts_;
+  float    cell_width_      = 0.0f;
+  float    cell_height_     = 0.0f;
+
+  HWND     hwnd_            = nullptr;
+  unsigned generation_      = 0;
+  int      surface_width_   = 0;
+  int      surface_height_  = 0;
+  bool     stretched_       = false;
+  int      layout_width_    = 0;
+  int      layout_height_   = 0;
+  float    block_height_    = 0.0f;
+  DWRITE_TEXT_ALIGNMENT alignment_ = DWRITE_TEXT_ALIGNMENT_CENTER;
+};
+
+}  // namespace pip_plugin
+
+#endif  // FLUTTER_PLUGIN_DIRECT_WRITE_RENDERER_H_
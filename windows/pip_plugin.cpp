@@ -1,11 +1,653 @@
 // pip_plugin.cpp
 #include "pip_plugin.h"
+#include "direct_write_renderer.h"
+#include "frame_reader.h"
+#include "text_ring.h"
 #include <VersionHelpers.h>
+#include <flutter/method_result_functions.h>
 #include <flutter/standard_method_codec.h>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 namespace pip_plugin {
 
+namespace {
+
+const UINT kFfiUpdateMessage = WM_APP + 1;
+const UINT kRingWakeMessage  = WM_APP + 2;
+const UINT kTailChangedMessage = WM_APP + 3;
+const UINT kSourceFrameMessage = WM_APP + 4;
+
+// Bytes read from a tailed file at most at once. Anything before them
+// would be dropped from the tail anyway, unless its lines are very short.
+const int64_t kTailReadLimit = 1 << 20;
+const size_t kDefaultTailLines = 200;
+// Bytes of a mapped text converted for the single line of the GDI path.
+const size_t kMappedLineBytes = 4096;
+
+// Default bounds of the auto-fit size, in pixels.
+const double kDefaultFitMinSize = 8;
+const double kDefaultFitMaxSize = 512;
+
+// Updates staged by the dart:ffi entry points. A burst of calls only
+// rewrites this state and posts one message; the PiP window applies the
+// newest state on its own thread.
+struct FfiUpdate {
+  std::mutex  mutex;
+  HWND        hwnd    = nullptr;
+  bool        posted  = false;
+  bool        replace = false;  // |text| replaces rather than appends
+  bool        redraw  = false;
+  uint64_t    staged  = 0;      // calls since the last apply, for getStats
+  std::string text;
+};
+
+FfiUpdate ffi_update;
+
+// The consumer only touches the ring after a wake-up, which happens after
+// creation.
+std::atomic<TextRing*> ffi_ring{nullptr};
+
+// Must be called with the mutex held.
+void PostFfiUpdate() {
+  if (!ffi_update.posted && ffi_update.hwnd) {
+    ffi_update.posted =
+        PostMessage(ffi_update.hwnd, kFfiUpdateMessage, 0, 0) != FALSE;
+  }
+}
+
+// Converts all of |text|, including any NUL bytes of a pipe frame.
+std::wstring Utf8ToWide(const std::string& text) {
+  std::wstring wtext;
+  int bytes = static_cast<int>(text.size());
+  int len = MultiByteToWideChar(CP_UTF8, 0, text.data(), bytes, nullptr, 0);
+  if (len > 0) {
+    wtext.resize(len);
+    MultiByteToWideChar(CP_UTF8, 0, text.data(), bytes, &wtext[0], len);
+  }
+  return wtext;
+}
+
+int64_t PerfCounter() {
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  return counter.QuadPart;
+}
+
+int64_t PerfFrequency() {
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  return frequency.QuadPart;
+}
+
+// Monotonic time in microseconds, split so the counter cannot overflow.
+int64_t MonotonicMicros() {
+  int64_t counter = PerfCounter();
+  int64_t frequency = PerfFrequency();
+  return counter / frequency * 1000000 +
+         counter % frequency * 1000000 / frequency;
+}
+
+// The standard codec sends small ints as int32 and larger ones as int64.
+bool GetInt(const flutter::EncodableMap& args, const char* key,
+            int64_t* value) {
+  auto it = args.find(flutter::EncodableValue(key));
+  if (it == args.end()) return false;
+  if (auto i = std::get_if<int32_t>(&it->second)) {
+    *value = *i;
+  } else if (auto l = std::get_if<int64_t>(&it->second)) {
+    *value = *l;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// As GetInt, with negative values clamped to 0.
+bool GetIndex(const flutter::EncodableMap& args, const char* key,
+              size_t* index) {
+  int64_t value;
+  if (!GetInt(args, key, &value)) return false;
+  *index = static_cast<size_t>(std::max<int64_t>(value, 0));
+  return true;
+}
+
+// Reads the "start" and "end" of a replaceRange, which must satisfy
+// 0 <= start <= end like RangeError.checkValidRange on the Dart side.
+bool GetRange(const flutter::EncodableMap& args, size_t* start, size_t* end) {
+  int64_t first;
+  int64_t last;
+  if (!GetInt(args, "start", &first) || !GetInt(args, "end", &last) ||
+      first < 0 || last < first) {
+    return false;
+  }
+  *start = static_cast<size_t>(first);
+  *end = static_cast<size_t>(last);
+  return true;
+}
+
+// Checks one applyBatch operation before any is applied. Only the calls a
+// PipOperation sends are taken, with the arguments their handlers need, so
+// a checked batch cannot fail halfway. Showing and hiding need the HWND.
+bool CheckBatchOperation(const flutter::EncodableValue& operation,
+                         bool has_hwnd) {
+  const auto* map = std::get_if<flutter::EncodableMap>(&operation);
+  if (!map) return false;
+  const std::string* method = nullptr;
+  if (auto it = map->find(flutter::EncodableValue("method"));
+      it != map->end()) {
+    method = std::get_if<std::string>(&it->second);
+  }
+  if (!method) return false;
+  const flutter::EncodableMap* args = nullptr;
+  const std::string* text = nullptr;
+  if (auto it = map->find(flutter::EncodableValue("args")); it != map->end()) {
+    args = std::get_if<flutter::EncodableMap>(&it->second);
+  }
+  if (args) {
+    if (auto it = args->find(flutter::EncodableValue("text"));
+        it != args->end()) {
+      text = std::get_if<std::string>(&it->second);
+    }
+  }
+
+  if (*method == "updatePip" || *method == "controlScroll") return args;
+  if (*method == "updateText" || *method == "appendText") return text;
+  if (*method == "replaceRange") {
+    size_t start;
+    size_t end;
+    return text && GetRange(*args, &start, &end);
+  }
+  if (*method == "startPip" || *method == "stopPip") return has_hwnd;
+  return *method == "clearText";
+}
+
+// Reads the file at the UTF-8 |path| into |data|.
+bool ReadWholeFile(const std::string& path, std::string* data) {
+  HANDLE file = CreateFileW(Utf8ToWide(path).c_str(), GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER size;
+  bool ok = GetFileSizeEx(file, &size) && size.QuadPart < (1 << 30);
+  if (ok) {
+    data->resize(static_cast<size_t>(size.QuadPart));
+    DWORD read = 0;
+    ok = data->empty() ||
+         (ReadFile(file, &(*data)[0], static_cast<DWORD>(data->size()), &read,
+                   nullptr) &&
+          read == data->size());
+  }
+  CloseHandle(file);
+  return ok;
+}
+
+// Reads the "cues" list of {startMs, endMs, text} maps.
+bool GetCues(const flutter::EncodableMap& args, std::vector<Cue>* cues) {
+  auto it = args.find(flutter::EncodableValue("cues"));
+  if (it == args.end()) return false;
+  const auto* list = std::get_if<flutter::EncodableList>(&it->second);
+  if (!list) return false;
+  for (const auto& item : *list) {
+    const auto* map = std::get_if<flutter::EncodableMap>(&item);
+    if (!map) return false;
+    size_t start, end;
+    auto text = map->find(flutter::EncodableValue("text"));
+    if (!GetIndex(*map, "startMs", &start) || !GetIndex(*map, "endMs", &end) ||
+        text == map->end() || !std::get_if<std::string>(&text->second)) {
+      return false;
+    }
+    cues->push_back({static_cast<int64_t>(start), static_cast<int64_t>(end),
+                     std::get<std::string>(text->second)});
+  }
+  return true;
+}
+
+// Reads an [r, g, b] or [r, g, b, a] list; alpha defaults to opaque.
+bool GetColor(const flutter::EncodableMap& args, const char* key,
+              COLORREF* color, BYTE* alpha) {
+  auto it = args.find(flutter::EncodableValue(key));
+  if (it == args.end()) return false;
+  const auto* list = std::get_if<flutter::EncodableList>(&it->second);
+  if (!list || list->size() < 3) return false;
+  int channels[4] = {0, 0, 0, 255};
+  for (size_t i = 0; i < 4 && i < list->size(); ++i) {
+    const int* value = std::get_if<int>(&list->at(i));
+    if (!value) return false;
+    channels[i] = *value;
+  }
+  *color = RGB(channels[0], channels[1], channels[2]);
+  *alpha = static_cast<BYTE>(channels[3]);
+  return true;
+}
+
+// A 0..1 animation value as a color channel.
+BYTE ToChannel(double value) {
+  return static_cast<BYTE>(
+      std::lround(std::min(std::max(value, 0.0), 1.0) * 255));
+}
+
+// The clock text with every digit replaced by 0. The auto-fit size only
+// depends on this shape, as the clock cells are as wide as the widest
+// digit.
+std::wstring ClockShape(const std::wstring& text) {
+  std::wstring shape = text;
+  for (wchar_t& c : shape) {
+    if (c >= L'0' && c <= L'9') c = L'0';
+  }
+  return shape;
+}
+
+// Writes |color| and |alpha| as the four 0..1 channels of an animation.
+void ToChannelValues(COLORREF color, BYTE alpha, double* channels) {
+  channels[0] = GetRValue(color) / 255.0;
+  channels[1] = GetGValue(color) / 255.0;
+  channels[2] = GetBValue(color) / 255.0;
+  channels[3] = alpha / 255.0;
+}
+
+}  // namespace
+
+unsigned ParseStyle(const flutter::EncodableMap& args, PipStyle* style) {
+  unsigned dirty = 0;
+
+  COLORREF color;
+  BYTE alpha;
+  if (GetColor(args, "backgroundColor", &color, &alpha) &&
+      (color != style->background_color ||
+       alpha != style->background_alpha)) {
+    style->background_color = color;
+    style->background_alpha = alpha;
+    dirty |= kStyleBackground;
+  }
+  if (GetColor(args, "textColor", &color, &alpha) &&
+      (color != style->text_color || alpha != style->text_alpha)) {
+    style->text_color = color;
+    style->text_alpha = alpha;
+    dirty |= kStyleTextColor;
+  }
+
+  if (auto it = args.find(flutter::EncodableValue("textSize"));
+      it != args.end()) {
+    if (auto d = std::get_if<double>(&it->second)) {
+      int size = static_cast<int>(*d);
+      if (size != style->text_size) {
+        style->text_size = size;
+        dirty |= kStyleTextSize;
+      }
+    }
+  }
+
+  if (auto it = args.find(flutter::EncodableValue("textAlign"));
+      it != args.end()) {
+    if (auto s = std::get_if<std::string>(&it->second)) {
+      UINT format = DT_CENTER;
+      if (*s == "left")       format = DT_LEFT;
+      else if (*s == "right") format = DT_RIGHT;
+      if (format != style->text_format) {
+        style->text_format = format;
+        dirty |= kStyleTextAlign;
+      }
+    }
+  }
+
+  if (auto it = args.find(flutter::EncodableValue("ratio"));
+      it != args.end()) {
+    if (auto list = std::get_if<flutter::EncodableList>(&it->second)) {
+      const int* width = list->size() >= 2 ? std::get_if<int>(&list->at(0))
+                                           : nullptr;
+      const int* height = list->size() >= 2 ? std::get_if<int>(&list->at(1))
+                                            : nullptr;
+      if (width && height && *width > 0 && *height > 0 &&
+          (*width != style->ratio_width || *height != style->ratio_height)) {
+        style->ratio_width = *width;
+        style->ratio_height = *height;
+        dirty |= kStyleRatio;
+      }
+    }
+  }
+
+  return dirty;
+}
+
+// A read-only view of a whole file, kept mapped while its text is shown.
+// An empty file is not mapped and reads as no bytes.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  // Maps the file at |path|. Returns false if it cannot be read.
+  bool Open(const std::wstring& path);
+
+  const char* data() const { return view_; }
+  size_t size() const { return size_; }
+
+ private:
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  HANDLE      file_    = INVALID_HANDLE_VALUE;
+  HANDLE      mapping_ = nullptr;
+  const char* view_    = nullptr;
+  size_t      size_    = 0;
+};
+
+MappedFile::~MappedFile() {
+  if (view_) UnmapViewOfFile(view_);
+  if (mapping_) CloseHandle(mapping_);
+  if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+}
+
+bool MappedFile::Open(const std::wstring& path) {
+  file_ = CreateFileW(path.c_str(), GENERIC_READ,
+                      FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_ == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file_, &size) || size.QuadPart >= INT_MAX) return false;
+  if (size.QuadPart == 0) return true;
+  mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping_) return false;
+  view_ = static_cast<const char*>(
+      MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+  if (!view_) return false;
+  size_ = static_cast<size_t>(size.QuadPart);
+  return true;
+}
+
+// Follows a file for the tail mode. A thread waits on overlapped
+// ReadDirectoryChangesW calls for the file's directory and posts
+// kTailChangedMessage to the window when the file changed; the window then
+// reads the appended bytes on its own thread.
+class TailWatch {
+ public:
+  TailWatch() = default;
+  ~TailWatch();
+
+  // Opens the file at |path| and starts watching it. Returns false if it
+  // cannot be read or watched.
+  bool Open(const std::wstring& path);
+  // Window notified of changes, or none while it has no HWND.
+  void SetWindow(HWND hwnd) { hwnd_ = hwnd; }
+
+  // Called by the window before reading: changes from now on are posted
+  // again. Returns true if the file was replaced, as by log rotation, and
+  // has been reopened to be read from its start.
+  bool Rearm();
+
+  HANDLE  file   = INVALID_HANDLE_VALUE;
+  int64_t offset = 0;
+
+ private:
+  TailWatch(const TailWatch&) = delete;
+  TailWatch& operator=(const TailWatch&) = delete;
+
+  void Run();
+  void Post();
+
+  std::wstring      path_;
+  std::wstring      name_;
+  HANDLE            directory_  = INVALID_HANDLE_VALUE;
+  HANDLE            stop_event_ = nullptr;
+  std::thread       thread_;
+  std::atomic<HWND> hwnd_{nullptr};
+  std::atomic<bool> posted_{false};
+  std::atomic<bool> replaced_{false};
+};
+
+namespace {
+
+HANDLE OpenTailedFile(const std::wstring& path) {
+  return CreateFileW(path.c_str(), GENERIC_READ,
+                     FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                     nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+}
+
+}  // namespace
+
+TailWatch::~TailWatch() {
+  if (thread_.joinable()) {
+    SetEvent(stop_event_);
+    thread_.join();
+  }
+  if (stop_event_) CloseHandle(stop_event_);
+  if (directory_ != INVALID_HANDLE_VALUE) CloseHandle(directory_);
+  if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
+
+bool TailWatch::Open(const std::wstring& path) {
+  size_t slash = path.find_last_of(L"\\/");
+  std::wstring directory =
+      slash == std::wstring::npos ? L"." : path.substr(0, slash + 1);
+  path_ = path;
+  name_ = slash == std::wstring::npos ? path : path.substr(slash + 1);
+
+  file = OpenTailedFile(path);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  directory_ = CreateFileW(
+      directory.c_str(), FILE_LIST_DIRECTORY,
+      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+      OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+      nullptr);
+  if (directory_ == INVALID_HANDLE_VALUE) return false;
+  stop_event_ = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+  if (!stop_event_) return false;
+  thread_ = std::thread(&TailWatch::Run, this);
+  return true;
+}
+
+bool TailWatch::Rearm() {
+  posted_ = false;
+  if (!replaced_.exchange(false)) return false;
+  HANDLE replacement = OpenTailedFile(path_);
+  if (replacement == INVALID_HANDLE_VALUE) return false;
+  CloseHandle(file);
+  file = replacement;
+  offset = 0;
+  return true;
+}
+
+void TailWatch::Post() {
+  if (posted_.exchange(true)) return;
+  HWND hwnd = hwnd_;
+  if (!hwnd || !PostMessage(hwnd, kTailChangedMessage, 0, 0)) {
+    posted_ = false;
+  }
+}
+
+void TailWatch::Run() {
+  alignas(DWORD) char buffer[4096];
+  OVERLAPPED overlapped = {};
+  overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+  HANDLE events[] = {overlapped.hEvent, stop_event_};
+  const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME |
+                       FILE_NOTIFY_CHANGE_SIZE |
+                       FILE_NOTIFY_CHANGE_LAST_WRITE;
+  while (overlapped.hEvent &&
+         ReadDirectoryChangesW(directory_, buffer, sizeof(buffer), FALSE,
+                               filter, nullptr, &overlapped, nullptr)) {
+    DWORD bytes = 0;
+    if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0) {
+      CancelIo(directory_);
+      GetOverlappedResult(directory_, &overlapped, &bytes, TRUE);
+      break;
+    }
+    if (!GetOverlappedResult(directory_, &overlapped, &bytes, FALSE)) break;
+
+    // No bytes means the buffer overflowed; the file may have changed.
+    bool changed = bytes == 0;
+    auto info = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(buffer);
+    while (bytes > 0) {
+      if (CompareStringOrdinal(info->FileName,
+                               info->FileNameLength / sizeof(WCHAR),
+                               name_.c_str(), static_cast<int>(name_.size()),
+                               TRUE) == CSTR_EQUAL) {
+        changed = true;
+        if (info->Action == FILE_ACTION_ADDED ||
+            info->Action == FILE_ACTION_RENAMED_NEW_NAME) {
+          replaced_ = true;
+        }
+      }
+      if (info->NextEntryOffset == 0) break;
+      info = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(
+          reinterpret_cast<char*>(info) + info->NextEntryOffset);
+    }
+    if (changed) Post();
+  }
+  if (overlapped.hEvent) CloseHandle(overlapped.hEvent);
+}
+
+// Serves the named pipe of a pipe source. A thread accepts one writer at a
+// time and reads its frames with overlapped I/O. Like the FFI updates, only
+// the newest frame is kept and one kSourceFrameMessage is posted for a
+// burst; the window applies it on its own thread.
+class PipeSource {
+ public:
+  PipeSource() = default;
+  ~PipeSource();
+
+  // Creates the pipe |name| and starts serving it. Returns false if it
+  // cannot be created, e.g. as another server owns it.
+  bool Open(const std::wstring& name, FrameReader::Framing framing);
+  // Window notified of new frames, or none while it has no HWND.
+  void SetWindow(HWND hwnd);
+  // Moves the newest frame not taken yet to |frame|. Returns false if
+  // there is none.
+  bool TakeFrame(std::string* frame);
+
+ private:
+  PipeSource(const PipeSource&) = delete;
+  PipeSource& operator=(const PipeSource&) = delete;
+
+  void Run();
+  // Waits for the overlapped operation; false once the source is stopped.
+  bool Await(OVERLAPPED* overlapped);
+  void Post(std::string* frame);
+
+  FrameReader::Framing framing_ = FrameReader::kLines;
+  HANDLE      pipe_       = INVALID_HANDLE_VALUE;
+  HANDLE      stop_event_ = nullptr;
+  std::thread thread_;
+
+  std::mutex  mutex_;
+  HWND        hwnd_       = nullptr;
+  bool        posted_     = false;
+  bool        has_frame_  = false;
+  std::string frame_;
+};
+
+PipeSource::~PipeSource() {
+  if (thread_.joinable()) {
+    SetEvent(stop_event_);
+    thread_.join();
+  }
+  if (stop_event_) CloseHandle(stop_event_);
+  if (pipe_ != INVALID_HANDLE_VALUE) CloseHandle(pipe_);
+}
+
+bool PipeSource::Open(const std::wstring& name, FrameReader::Framing framing) {
+  framing_ = framing;
+  pipe_ = CreateNamedPipeW(
+      name.c_str(),
+      PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED |
+          FILE_FLAG_FIRST_PIPE_INSTANCE,
+      PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT |
+          PIPE_REJECT_REMOTE_CLIENTS,
+      1, 0, 64 * 1024, 0, nullptr);
+  if (pipe_ == INVALID_HANDLE_VALUE) return false;
+  stop_event_ = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+  if (!stop_event_) return false;
+  thread_ = std::thread(&PipeSource::Run, this);
+  return true;
+}
+
+void PipeSource::SetWindow(HWND hwnd) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  hwnd_ = hwnd;
+  posted_ = false;
+}
+
+bool PipeSource::TakeFrame(std::string* frame) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  posted_ = false;
+  if (!has_frame_) return false;
+  frame->swap(frame_);
+  has_frame_ = false;
+  return true;
+}
+
+void PipeSource::Post(std::string* frame) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  frame_.swap(*frame);
+  has_frame_ = true;
+  if (!posted_ && hwnd_) {
+    posted_ = PostMessage(hwnd_, kSourceFrameMessage, 0, 0) != FALSE;
+  }
+}
+
+bool PipeSource::Await(OVERLAPPED* overlapped) {
+  HANDLE events[] = {overlapped->hEvent, stop_event_};
+  if (WaitForMultipleObjects(2, events, FALSE, INFINITE) == WAIT_OBJECT_0) {
+    return true;
+  }
+  DWORD bytes = 0;
+  CancelIo(pipe_);
+  GetOverlappedResult(pipe_, overlapped, &bytes, TRUE);
+  return false;
+}
+
+void PipeSource::Run() {
+  OVERLAPPED overlapped = {};
+  overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+  if (!overlapped.hEvent) return;
+  std::vector<char> buffer(64 * 1024);
+  FrameReader reader;
+  std::string frame;
+  bool running = true;
+  while (running) {
+    if (!ConnectNamedPipe(pipe_, &overlapped)) {
+      DWORD error = GetLastError();
+      if (error == ERROR_IO_PENDING) {
+        running = Await(&overlapped);
+      } else if (error != ERROR_PIPE_CONNECTED) {
+        break;
+      }
+    }
+
+    // Read the writer until it disconnects or sends a corrupt stream.
+    reader.Reset(framing_);
+    while (running) {
+      DWORD bytes = 0;
+      if (!ReadFile(pipe_, buffer.data(), static_cast<DWORD>(buffer.size()),
+                    nullptr, &overlapped) &&
+          GetLastError() != ERROR_IO_PENDING) {
+        break;
+      }
+      running = Await(&overlapped);
+      if (!running ||
+          !GetOverlappedResult(pipe_, &overlapped, &bytes, FALSE) ||
+          !reader.Feed(buffer.data(), bytes)) {
+        break;
+      }
+      if (reader.TakeFrame(&frame)) Post(&frame);
+    }
+    DisconnectNamedPipe(pipe_);
+  }
+  CloseHandle(overlapped.hEvent);
+}
+
+PipWindow::PipWindow(PipPlugin* plugin, int64_t id) : plugin(plugin), id(id) {}
+
+PipWindow::~PipWindow() = default;
+
 bool PipPlugin::window_class_registered_ = false;
 const wchar_t PipPlugin::kPipWindowClass[] = L"PipPluginWindow";
 
@@ -26,11 +668,29 @@ void PipPlugin::RegisterWithRegistrar(flutter::PluginRegistrarWindows* registrar
   registrar->AddPlugin(std::unique_ptr<PipPlugin>(plugin));
 }
 
-PipPlugin::PipPlugin() = default;
+PipPlugin::PipPlugin() {
+  auto window = std::make_unique<PipWindow>(this, next_window_id_++);
+  default_window_ = window.get();
+  windows_[window->id] = std::move(window);
+}
 
 PipPlugin::~PipPlugin() {
-  if (pip_hwnd_) DestroyWindow(pip_hwnd_);
-  if (pip_font_) DeleteObject(pip_font_);
+  for (auto& [id, window] : windows_) {
+    if (window->hwnd) DestroyWindow(window->hwnd);
+    ReleaseBackBuffer(window.get());
+    ReleaseClockGlyphs(window.get());
+    if (window->background_brush) DeleteObject(window->background_brush);
+  }
+  windows_.clear();
+  for (auto& [size, font] : fonts_) DeleteObject(font);
+}
+
+PipWindow* PipPlugin::LookupWindow(const flutter::EncodableValue* args) {
+  const auto* map = args ? std::get_if<flutter::EncodableMap>(args) : nullptr;
+  size_t id;
+  if (!map || !GetIndex(*map, "id", &id)) return default_window_;
+  auto it = windows_.find(static_cast<int64_t>(id));
+  return it != windows_.end() ? it->second.get() : nullptr;
 }
 
 void PipPlugin::HandleMethodCall(
@@ -48,7 +708,12 @@ void PipPlugin::HandleMethodCall(
     return;
   }
 
-  if (method == "setupPip" || method == "updatePip") {
+  if (method == "isPipSupported") {
+    result->Success(flutter::EncodableValue(true));
+    return;
+  }
+
+  if (method == "setupPip") {
     auto maybeMap = std::get_if<flutter::EncodableMap>(call.arguments());
     if (!maybeMap) {
       result->Error("bad_args", "Expected map of configuration");
@@ -56,127 +721,107 @@ void PipPlugin::HandleMethodCall(
     }
     const auto& args = *maybeMap;
 
-    // windowTitle only on setupPip
-    if (method == "setupPip") {
-      if (auto it = args.find(flutter::EncodableValue("windowTitle"));
-          it != args.end()) {
-        if (auto s = std::get_if<std::string>(&it->second)) {
-          int len = MultiByteToWideChar(
-              CP_UTF8, 0, s->c_str(), -1, nullptr, 0);
-          window_title_.resize(len);
-          MultiByteToWideChar(
-              CP_UTF8, 0, s->c_str(), -1,
-              &window_title_[0], len);
-          if (!window_title_.empty()) window_title_.pop_back();
-        }
-      }
+    // newWindow adds a window next to the existing ones; otherwise the
+    // default window is (re)configured.
+    PipWindow* window = default_window_;
+    if (auto it = args.find(flutter::EncodableValue("newWindow"));
+        it != args.end() && std::get_if<bool>(&it->second) &&
+        std::get<bool>(it->second)) {
+      auto created = std::make_unique<PipWindow>(this, next_window_id_++);
+      window = created.get();
+      windows_[window->id] = std::move(created);
     }
 
-    // backgroundColor RGBA
-    if (auto it = args.find(flutter::EncodableValue("backgroundColor"));
+    if (auto it = args.find(flutter::EncodableValue("windowTitle"));
         it != args.end()) {
-      if (auto list = std::get_if<flutter::EncodableList>(&it->second)) {
-        int r=0,g=0,b=0,a=255;
-        if (list->size()>=3) {
-          r = std::get<int>(list->at(0));
-          g = std::get<int>(list->at(1));
-          b = std::get<int>(list->at(2));
-        }
-        if (list->size()>=4) {
-          a = std::get<int>(list->at(3));
-        }
-        background_color_ = RGB(r,g,b);
-        background_alpha_ = static_cast<BYTE>(a);
+      if (auto s = std::get_if<std::string>(&it->second)) {
+        window->title = Utf8ToWide(*s);
       }
     }
 
-    // textColor RGBA
-    if (auto it = args.find(flutter::EncodableValue("textColor"));
-        it != args.end()) {
-      if (auto list = std::get_if<flutter::EncodableList>(&it->second)) {
-        int r=255,g=255,b=255,a=255;
-        if (list->size()>=3) {
-          r = std::get<int>(list->at(0));
-          g = std::get<int>(list->at(1));
-          b = std::get<int>(list->at(2));
-        }
-        if (list->size()>=4) {
-          a = std::get<int>(list->at(3));
-        }
-        text_color_ = RGB(r,g,b);
-        text_alpha_ = static_cast<BYTE>(a);
-      }
+    if (auto it = args.find(flutter::EncodableValue("prewarm"));
+        it != args.end() && std::get_if<bool>(&it->second)) {
+      window->prewarm = window->prewarm || std::get<bool>(it->second);
     }
 
-    // textSize
-    if (auto it = args.find(flutter::EncodableValue("textSize"));
-        it != args.end()) {
-      if (auto d = std::get_if<double>(&it->second)) {
-        text_size_ = static_cast<int>(*d);
-      }
-    }
+    unsigned dirty = ParseStyle(args, &window->style);
+    if (window->hwnd) ApplyConfiguration(window, dirty);
+    CreatePipWindow(window);
+    UpdatePipText(window, "");
+    if (window->prewarm) PrewarmPipWindow(window);
+    result->Success(flutter::EncodableValue(window->id));
+    return;
+  }
 
-    // textAlign
-    if (auto it = args.find(flutter::EncodableValue("textAlign"));
-        it != args.end()) {
-      if (auto s = std::get_if<std::string>(&it->second)) {
-        if (*s == "left")       text_format_ = DT_LEFT;
-        else if (*s == "right") text_format_ = DT_RIGHT;
-        else                    text_format_ = DT_CENTER;
-      }
-    }
+  PipWindow* window = LookupWindow(call.arguments());
+  if (!window) {
+    result->Error("unknown_window", "No PiP window with this id");
+    return;
+  }
 
-    // ratio
-    if (auto it = args.find(flutter::EncodableValue("ratio"));
-        it != args.end()) {
-      if (auto list = std::get_if<flutter::EncodableList>(&it->second)) {
-        if (list->size() >= 2) {
-          ratio_.assign({
-            std::get<int>(list->at(0)),
-            std::get<int>(list->at(1))
-          });
-        }
-      }
+  if (method == "updatePip") {
+    auto maybeMap = std::get_if<flutter::EncodableMap>(call.arguments());
+    if (!maybeMap) {
+      result->Error("bad_args", "Expected map of configuration");
+      return;
     }
-
-    if (method == "setupPip") {
-      CreatePipWindow();
-    } else {
-      ApplyConfiguration();
+    NoteUpdates(window, 1);
+    // The values set now replace those of a running animation.
+    unsigned dirty = StopAnimation(window);
+    dirty |= ParseStyle(*maybeMap, &window->style);
+    if (window->fit_enabled && (dirty & kStyleTextSize)) {
+      // Shown again once auto-fit is turned off.
+      window->fit_base_size = window->style.text_size;
     }
-    UpdatePipText("");
+    ApplyConfiguration(window, dirty);
     result->Success(flutter::EncodableValue(true));
     return;
   }
 
   if (method == "startPip") {
-    if (!pip_hwnd_) {
+    if (!window->hwnd) {
       result->Error("not_ready", "PiP has not been set up");
     } else {
-      ShowWindow(pip_hwnd_, SW_SHOW);
-      pip_visible_ = true;
+      if (!IsWindowVisible(window->hwnd)) window->show_time = PerfCounter();
+      ShowWindow(window->hwnd, SW_SHOW);
+      window->visible = true;
       result->Success(flutter::EncodableValue(true));
     }
     return;
   }
 
   if (method == "stopPip") {
-    if (!pip_hwnd_) {
+    if (!window->hwnd) {
       result->Error("not_ready", "PiP has not been set up");
     } else {
-      ShowWindow(pip_hwnd_, SW_HIDE);
-      pip_visible_ = false;
+      ShowWindow(window->hwnd, SW_HIDE);
+      window->visible = false;
       result->Success(flutter::EncodableValue(true));
     }
     return;
   }
 
+  if (method == "destroyPip") {
+    // WM_DESTROY reports the stop to Dart. Windows other than the default
+    // one are forgotten with their HWND.
+    if (window->hwnd) DestroyWindow(window->hwnd);
+    if (window != default_window_) {
+      ReleaseBackBuffer(window);
+      ReleaseClockGlyphs(window);
+      if (window->background_brush) DeleteObject(window->background_brush);
+      windows_.erase(window->id);
+    }
+    result->Success(flutter::EncodableValue(true));
+    return;
+  }
+
   if (method == "updateText") {
     if (auto args = std::get_if<flutter::EncodableMap>(call.arguments())) {
       if (auto it = args->find(flutter::EncodableValue("text"));
           it != args->end()) {
         if (auto s = std::get_if<std::string>(&it->second)) {
-          UpdatePipText(*s);
+          NoteUpdates(window, 1);
+          UpdatePipText(window, *s);
           result->Success(flutter::EncodableValue(true));
           return;
         }
@@ -186,141 +831,1565 @@ void PipPlugin::HandleMethodCall(
     return;
   }
 
-  if (method == "isPipSupported") {
+  if (method == "appendText" || method == "replaceRange") {
+    const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+    const std::string* text = nullptr;
+    if (args) {
+      if (auto it = args->find(flutter::EncodableValue("text"));
+          it != args->end()) {
+        text = std::get_if<std::string>(&it->second);
+      }
+    }
+    size_t start = SIZE_MAX;
+    size_t end = SIZE_MAX;
+    if (!text ||
+        (method == "replaceRange" && !GetRange(*args, &start, &end))) {
+      result->Error("invalid_argument", "Expected text and a valid range");
+      return;
+    }
+    NoteUpdates(window, 1);
+    EditPipText(window, start, end, *text);
     result->Success(flutter::EncodableValue(true));
     return;
   }
 
-  result->NotImplemented();
-}
-
-void PipPlugin::CreatePipWindow() {
-  if (pip_hwnd_) return;
-
-  if (!window_class_registered_) {
-    WNDCLASS wc = {};
-    wc.lpfnWndProc   = PipWndProc;
-    wc.hInstance     = GetModuleHandle(nullptr);
-    wc.lpszClassName = kPipWindowClass;
-    wc.hCursor       = LoadCursor(nullptr, IDC_ARROW);
-    RegisterClass(&wc);
-    window_class_registered_ = true;
+  if (method == "clearText") {
+    NoteUpdates(window, 1);
+    EditPipText(window, 0, SIZE_MAX, "");
+    result->Success(flutter::EncodableValue(true));
+    return;
   }
 
-  int h = 180;
-  int w = static_cast<int>(h * ratio_[0] / (double)ratio_[1]);
-  DWORD ex = WS_EX_TOPMOST | WS_EX_LAYERED;
-  pip_hwnd_ = CreateWindowEx(
-      ex,
-      kPipWindowClass,
-      window_title_.c_str(),
-      WS_OVERLAPPEDWINDOW,
-      CW_USEDEFAULT, CW_USEDEFAULT, w, h,
-      nullptr, nullptr, GetModuleHandle(nullptr), this);
-
-  SetLayeredWindowAttributes(pip_hwnd_, 0, background_alpha_, LWA_ALPHA);
-
-  ApplyConfiguration();
-}
-
-void PipPlugin::ApplyConfiguration() {
-  if (pip_font_) {
-    DeleteObject(pip_font_);
-    pip_font_ = nullptr;
+  if (method == "loadTextFile") {
+    const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+    const std::string* path = nullptr;
+    if (args) {
+      auto it = args->find(flutter::EncodableValue("path"));
+      if (it != args->end()) path = std::get_if<std::string>(&it->second);
+    }
+    if (!path) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+    }
+    NoteUpdates(window, 1);
+    if (!LoadTextFile(window, *path)) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+    }
+    if (window->hwnd) {
+      ScheduleRepaint(window);
+    } else {
+      FlushPendingUpdate(window);
+    }
+    result->Success(flutter::EncodableValue(true));
+    return;
   }
-  pip_font_ = CreateFont(
-      -text_size_, 0, 0, 0, FW_BOLD,
-      FALSE, FALSE, FALSE,
-      DEFAULT_CHARSET, OUT_OUTLINE_PRECIS,
-      CLIP_DEFAULT_PRECIS, CLEARTYPE_QUALITY,
-      VARIABLE_PITCH, L"Consolas");
-
-  if (pip_hwnd_) {
-    SetLayeredWindowAttributes(pip_hwnd_, 0, background_alpha_, LWA_ALPHA);
-
-    RECT rc;
-    GetWindowRect(pip_hwnd_, &rc);
-    int currentHeight = rc.bottom - rc.top;
-    int newWidth = static_cast<int>(currentHeight * ratio_[0] / (double)ratio_[1]);
-    SetWindowPos(pip_hwnd_, nullptr,
-                 0, 0, newWidth, currentHeight,
-                 SWP_NOMOVE | SWP_NOZORDER);
 
-    InvalidateRect(pip_hwnd_, nullptr, TRUE);
-    UpdateWindow(pip_hwnd_);
+  if (method == "tailFile") {
+    const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+    const std::string* path = nullptr;
+    if (args) {
+      auto it = args->find(flutter::EncodableValue("path"));
+      if (it != args->end()) path = std::get_if<std::string>(&it->second);
+    }
+    if (!path) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+    }
+    size_t max_lines = kDefaultTailLines;
+    GetIndex(*args, "maxLines", &max_lines);
+    auto watch = std::make_unique<TailWatch>();
+    if (!watch->Open(Utf8ToWide(*path))) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+    }
+    // Replacing the watch stops the one of a previous tailFile.
+    window->tail_watch = std::move(watch);
+    window->tail.Reset(max_lines);
+    window->text_pending = false;
+    window->pending_text.clear();
+    ReplaceCurrentText(window, 0, window->current_text.size(), L"");
+    window->tail_generation = window->text_generation;
+    window->tail_watch->SetWindow(window->hwnd);
+    ReadTail(window);
+    if (window->hwnd) {
+      ScheduleRepaint(window);
+    } else {
+      FlushPendingUpdate(window);
+    }
+    result->Success(flutter::EncodableValue(true));
+    return;
   }
-}
-
-void PipPlugin::UpdatePipText(const std::string& text) {
-  int len = MultiByteToWideChar(
-      CP_UTF8, 0, text.c_str(), -1, nullptr, 0);
-  if (len <= 0) return;
-  std::wstring wtext(len, L'\0');
-  MultiByteToWideChar(
-      CP_UTF8, 0, text.c_str(), -1, &wtext[0], len);
-  if (!wtext.empty()) wtext.pop_back();
-
-  pip_current_text_ = std::move(wtext);
 
-  if (pip_hwnd_) {
-    InvalidateRect(pip_hwnd_, nullptr, TRUE);
-    UpdateWindow(pip_hwnd_);
+  if (method == "stopTail") {
+    // The text shown stays.
+    bool tailing = window->tail_watch != nullptr;
+    window->tail_watch.reset();
+    result->Success(flutter::EncodableValue(tailing));
+    return;
   }
-}
 
-void PipPlugin::NotifyPipStopped() {
-  if (channel_) {
-    channel_->InvokeMethod("pipStopped", nullptr);
+  if (method == "openSource") {
+    const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+    const std::string* path = nullptr;
+    bool length_prefixed = false;
+    if (args) {
+      auto it = args->find(flutter::EncodableValue("path"));
+      if (it != args->end()) path = std::get_if<std::string>(&it->second);
+      it = args->find(flutter::EncodableValue("lengthPrefixed"));
+      if (it != args->end()) {
+        if (auto b = std::get_if<bool>(&it->second)) length_prefixed = *b;
+      }
+    }
+    if (!path) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+    }
+    // A bare name is taken as a pipe of the local machine.
+    std::wstring name = Utf8ToWide(*path);
+    if (name.rfind(L"\\\\", 0) != 0) name = L"\\\\.\\pipe\\" + name;
+    // The old pipe is closed first, so the same name can be served again.
+    window->source.reset();
+    auto source = std::make_unique<PipeSource>();
+    if (!source->Open(name, length_prefixed ? FrameReader::kLengthPrefixed
+                                            : FrameReader::kLines)) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+    }
+    window->source = std::move(source);
+    window->source->SetWindow(window->hwnd);
+    result->Success(flutter::EncodableValue(true));
+    return;
   }
-}
+
+  if (method == "closeSource") {
+    // The text shown stays.
+    bool open = window->source != nullptr;
+    window->source.reset();
+    result->Success(flutter::EncodableValue(open));
+    return;
+  }
+
+  if (method == "applyBatch") {
+    // A bare list targets the default window; {id, operations} another.
+    const auto* operations =
+        std::get_if<flutter::EncodableList>(call.arguments());
+    if (auto args = std::get_if<flutter::EncodableMap>(call.arguments())) {
+      if (auto it = args->find(flutter::EncodableValue("operations"));
+          it != args->end()) {
+        operations = std::get_if<flutter::EncodableList>(&it->second);
+      }
+    }
+    if (!operations) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+    }
+    // The batch is applied as a whole or not at all.
+    for (const auto& operation : *operations) {
+      if (!CheckBatchOperation(operation, window->hwnd != nullptr)) {
+        result->Success(flutter::EncodableValue(false));
+        return;
+      }
+    }
+    // The operations only mark state dirty; the repaint is scheduled once
+    // after the last one.
+    bool success = true;
+    NoteUpdates(window, 1);
+    ++window->batch_depth;
+    for (const auto& operation : *operations) {
+      success = ApplyBatchOperation(window, operation) && success;
+    }
+    --window->batch_depth;
+    if (window->repaint_pending && window->hwnd) ScheduleRepaint(window);
+    result->Success(flutter::EncodableValue(success));
+    return;
+  }
+
+  if (method == "loadCueTrack") {
+    const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+    if (!args) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+    }
+    std::vector<Cue> cues;
+    auto path = args->find(flutter::EncodableValue("path"));
+    if (path != args->end() && std::get_if<std::string>(&path->second)) {
+      const std::string& file = std::get<std::string>(path->second);
+      std::string data;
+      if (!ReadWholeFile(file, &data)) {
+        result->Success(flutter::EncodableValue(false));
+        return;
+      }
+      CueTrack::Parse(data, &cues);
+    } else if (!GetCues(*args, &cues)) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+    }
+    if (cues.empty()) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+    }
+
+    window->cues.Load(std::move(cues));
+    auto play = args->find(flutter::EncodableValue("play"));
+    if (play == args->end() || !std::get_if<bool>(&play->second) ||
+        std::get<bool>(play->second)) {
+      window->cues.Play(MonotonicMicros());
+    }
+    SetCue(window, window->cues.CueAt(0));
+    if (window->hwnd) {
+      ScheduleRepaint(window);
+    } else {
+      FlushPendingUpdate(window);
+    }
+    UpdateCueTimer(window);
+    result->Success(flutter::EncodableValue(true));
+    return;
+  }
+
+  if (method == "controlCueTrack") {
+    const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+    if (!args || !window->cues.loaded()) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+    }
+    int64_t now = MonotonicMicros();
+    auto rate = args->find(flutter::EncodableValue("rate"));
+    if (rate != args->end() && std::get_if<double>(&rate->second)) {
+      window->cues.SetRate(std::get<double>(rate->second), now);
+    }
+    size_t position;
+    if (GetIndex(*args, "positionMs", &position)) {
+      window->cues.Seek(static_cast<int64_t>(position), now);
+    }
+    auto playing = args->find(flutter::EncodableValue("playing"));
+    if (playing != args->end() && std::get_if<bool>(&playing->second)) {
+      if (std::get<bool>(playing->second)) {
+        window->cues.Play(now);
+      } else {
+        window->cues.Pause(now);
+      }
+    }
+    if (ShowCue(window)) {
+      if (window->hwnd) {
+        ScheduleRepaint(window);
+      } else {
+        FlushPendingUpdate(window);
+      }
+    }
+    UpdateCueTimer(window);
+    result->Success(flutter::EncodableValue(true));
+    return;
+  }
+
+  if (method == "unloadCueTrack") {
+    if (!window->cues.loaded()) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+    }
+    window->cues.Clear();
+    UpdateCueTimer(window);
+    SetCue(window, CueTrack::kNoCue);
+    if (window->hwnd) {
+      ScheduleRepaint(window);
+    } else {
+      FlushPendingUpdate(window);
+    }
+    result->Success(flutter::EncodableValue(true));
+    return;
+  }
+
+  if (method == "startClock") {
+    const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+    if (!args) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+    }
+    bool countdown = false;
+    if (auto it = args->find(flutter::EncodableValue("countdown"));
+        it != args->end() && std::get_if<bool>(&it->second)) {
+      countdown = std::get<bool>(it->second);
+    }
+    size_t start_ms = 0;
+    GetIndex(*args, "startMs", &start_ms);
+    std::string format;
+    if (auto it = args->find(flutter::EncodableValue("format"));
+        it != args->end() && std::get_if<std::string>(&it->second)) {
+      format = std::get<std::string>(it->second);
+    }
+
+    window->clock.Start(countdown, static_cast<int64_t>(start_ms), format,
+                        MonotonicMicros());
+    window->clock_text = Utf8ToWide(window->clock.Text(MonotonicMicros()));
+    window->fit.Reset();
+    window->back_dirty = true;
+    if (window->hwnd) {
+      SetTimer(window->hwnd, kClockTimerId, window->frame_interval_ms,
+               nullptr);
+      ScheduleRepaint(window);
+    }
+    result->Success(flutter::EncodableValue(true));
+    return;
+  }
+
+  if (method == "stopClock") {
+    if (!window->clock.active()) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+    }
+    window->clock.Stop();
+    window->clock_text.clear();
+    ReleaseClockGlyphs(window);
+    window->fit.Reset();
+    window->back_dirty = true;
+    if (window->hwnd) {
+      KillTimer(window->hwnd, kClockTimerId);
+      ScheduleRepaint(window);
+    }
+    result->Success(flutter::EncodableValue(true));
+    return;
+  }
+
+  if (method == "animate") {
+    const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+    if (!args) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+    }
+    PipAnimation::Curve curve = PipAnimation::kEaseInOut;
+    if (auto it = args->find(flutter::EncodableValue("curve"));
+        it != args->end()) {
+      const auto* name = std::get_if<std::string>(&it->second);
+      if (!name || !PipAnimation::ParseCurve(*name, &curve)) {
+        result->Success(flutter::EncodableValue(false));
+        return;
+      }
+    }
+    size_t duration_ms = 0;
+    GetIndex(*args, "durationMs", &duration_ms);
+    int64_t repeat = 1;
+    GetInt(*args, "repeat", &repeat);
+    bool reverse = false;
+    if (auto it = args->find(flutter::EncodableValue("reverse"));
+        it != args->end() && std::get_if<bool>(&it->second)) {
+      reverse = std::get<bool>(it->second);
+    }
+
+    // A new animation starts from the values shown now.
+    unsigned dirty = StopAnimation(window);
+    double from[PipAnimation::kPropertyCount];
+    double to[PipAnimation::kPropertyCount];
+    const PipStyle& style = window->style;
+    ToChannelValues(style.background_color, style.background_alpha,
+                    from + PipAnimation::kBackgroundRed);
+    ToChannelValues(style.text_color, style.text_alpha,
+                    from + PipAnimation::kTextRed);
+    from[PipAnimation::kTextSize] = style.text_size;
+    std::copy(from, from + PipAnimation::kPropertyCount, to);
+
+    unsigned properties = 0;
+    COLORREF color;
+    BYTE alpha;
+    if (GetColor(*args, "backgroundColor", &color, &alpha)) {
+      ToChannelValues(color, alpha, to + PipAnimation::kBackgroundRed);
+      properties |= 0xFu << PipAnimation::kBackgroundRed;
+    }
+    if (GetColor(*args, "textColor", &color, &alpha)) {
+      ToChannelValues(color, alpha, to + PipAnimation::kTextRed);
+      properties |= 0xFu << PipAnimation::kTextRed;
+    }
+    if (auto it = args->find(flutter::EncodableValue("textSize"));
+        it != args->end() && std::get_if<double>(&it->second) &&
+        std::get<double>(it->second) > 0) {
+      to[PipAnimation::kTextSize] = std::get<double>(it->second);
+      properties |= 1u << PipAnimation::kTextSize;
+      // Laid out once at the larger size, which is then only scaled down.
+      int layout_size = static_cast<int>(std::ceil(std::max(
+          from[PipAnimation::kTextSize], to[PipAnimation::kTextSize])));
+      if (layout_size != window->style.text_size) {
+        window->text_scale =
+            static_cast<float>(window->style.text_size) / layout_size;
+        window->style.text_size = layout_size;
+        dirty |= kStyleTextSize;
+      }
+    }
+
+    NoteUpdates(window, 1);
+    window->animation.Start(from, to, properties,
+                            static_cast<int64_t>(duration_ms) * 1000, curve,
+                            repeat, reverse, MonotonicMicros());
+    if (StepAnimation(window, dirty) && window->hwnd) {
+      SetTimer(window->hwnd, kAnimationTimerId, window->frame_interval_ms,
+               nullptr);
+    }
+    result->Success(flutter::EncodableValue(true));
+    return;
+  }
+
+  if (method == "autoFit") {
+    const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+    if (!args) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+    }
+    bool enabled = true;
+    if (auto it = args->find(flutter::EncodableValue("enabled"));
+        it != args->end() && std::get_if<bool>(&it->second)) {
+      enabled = std::get<bool>(it->second);
+    }
+    if (!enabled) {
+      if (!window->fit_enabled) {
+        result->Success(flutter::EncodableValue(false));
+        return;
+      }
+      window->fit_enabled = false;
+      window->style.text_size = window->fit_base_size;
+      window->fit.Reset();
+      ApplyConfiguration(window, kStyleTextSize);
+      result->Success(flutter::EncodableValue(true));
+      return;
+    }
+
+    double min_size = kDefaultFitMinSize;
+    double max_size = kDefaultFitMaxSize;
+    if (auto it = args->find(flutter::EncodableValue("minSize"));
+        it != args->end() && std::get_if<double>(&it->second)) {
+      min_size = std::get<double>(it->second);
+    }
+    if (auto it = args->find(flutter::EncodableValue("maxSize"));
+        it != args->end() && std::get_if<double>(&it->second)) {
+      max_size = std::get<double>(it->second);
+    }
+    if (min_size < 1 || max_size < min_size) {
+      result->Success(flutter::EncodableValue(false));
+      return;
+    }
+
+    if (!window->fit_enabled) window->fit_base_size = window->style.text_size;
+    window->fit_enabled = true;
+    window->fit_min_size = static_cast<int>(std::ceil(min_size));
+    window->fit_max_size = static_cast<int>(max_size);
+    window->back_dirty = true;
+    if (window->hwnd) ScheduleRepaint(window);
+    result->Success(flutter::EncodableValue(true));
+    return;
+  }
+
+  if (method == "getStats") {
+    const PipStats& stats = window->stats;
+    flutter::EncodableMap map = {
+        {flutter::EncodableValue("updates"),
+         flutter::EncodableValue(static_cast<int64_t>(stats.updates))},
+        {flutter::EncodableValue("superseded"),
+         flutter::EncodableValue(static_cast<int64_t>(stats.superseded))},
+        {flutter::EncodableValue("frames"),
+         flutter::EncodableValue(static_cast<int64_t>(stats.frames))},
+    };
+    if (stats.first_frame_us != 0) {
+      map[flutter::EncodableValue("firstFrameUs")] =
+          flutter::EncodableValue(static_cast<int64_t>(stats.first_frame_us));
+    }
+    result->Success(flutter::EncodableValue(map));
+    return;
+  }
+
+  result->NotImplemented();
+}
+
+void PipPlugin::CreatePipWindow(PipWindow* window) {
+  if (window->hwnd) return;
+
+  if (!window_class_registered_) {
+    WNDCLASS wc = {};
+    wc.lpfnWndProc   = PipWndProc;
+    wc.hInstance     = GetModuleHandle(nullptr);
+    wc.lpszClassName = kPipWindowClass;
+    wc.hCursor       = LoadCursor(nullptr, IDC_ARROW);
+    RegisterClass(&wc);
+    window_class_registered_ = true;
+  }
+
+  // Prefer Direct2D; its composition surface needs a window without a
+  // redirection bitmap, so the backend is chosen before the window exists.
+  // All windows render with the same devices.
+  if (!d2d_device_) {
+    auto device = std::make_shared<DirectWriteDevice>();
+    if (device->Create()) d2d_device_ = std::move(device);
+  }
+  if (d2d_device_ && !window->d2d_renderer) {
+    window->d2d_renderer = std::make_unique<DirectWriteRenderer>(d2d_device_);
+    if (window->mapped_text) {
+      window->d2d_renderer->MapText(window->mapped_text->data(),
+                                    window->mapped_text->size());
+    }
+  }
+
+  if (window->d2d_renderer) {
+    window->hwnd =
+        CreatePipHwnd(window, WS_EX_TOPMOST | WS_EX_NOREDIRECTIONBITMAP);
+    if (window->hwnd && !window->d2d_renderer->AttachWindow(window->hwnd)) {
+      // GDI output would be invisible in this window; rebuild it for the
+      // fallback without reporting a stop to Dart.
+      SetWindowLongPtr(window->hwnd, GWLP_USERDATA, 0);
+      DestroyWindow(window->hwnd);
+      window->hwnd = nullptr;
+      window->d2d_renderer.reset();
+    }
+  }
+  if (!window->hwnd) {
+    window->hwnd = CreatePipHwnd(window, WS_EX_TOPMOST | WS_EX_LAYERED);
+    SetLayeredWindowAttributes(window->hwnd, 0, window->style.background_alpha,
+                               LWA_ALPHA);
+  }
+
+  // Pace repaints to the refresh rate of the display.
+  HDC screen_dc = GetDC(window->hwnd);
+  int refresh_hz = GetDeviceCaps(screen_dc, VREFRESH);
+  ReleaseDC(window->hwnd, screen_dc);
+  if (refresh_hz > 1) {
+    window->frame_interval_ms = static_cast<UINT>(1000 / refresh_hz);
+  }
+
+  ApplyConfiguration(window, kStyleAll);
+  if (window == default_window_) BindFfiWindow(window->hwnd);
+  if (window->clock.active()) {
+    SetTimer(window->hwnd, kClockTimerId, window->frame_interval_ms, nullptr);
+  }
+  UpdateCueTimer(window);
+  if (window->animation.active()) {
+    SetTimer(window->hwnd, kAnimationTimerId, window->frame_interval_ms,
+             nullptr);
+  }
+  if (window->tail_watch) {
+    // Changes while the window had no HWND were not posted.
+    window->tail_watch->SetWindow(window->hwnd);
+    ReadTail(window);
+  }
+  if (window->source) {
+    // Frames received while the window had no HWND were not posted.
+    window->source->SetWindow(window->hwnd);
+    ApplySourceFrame(window);
+  }
+}
+
+HWND PipPlugin::CreatePipHwnd(PipWindow* window, DWORD ex_style) {
+  int h = 180;
+  int w = static_cast<int>(h * window->style.ratio_width /
+                           (double)window->style.ratio_height);
+  return CreateWindowEx(
+      ex_style,
+      kPipWindowClass,
+      window->title.c_str(),
+      WS_OVERLAPPEDWINDOW,
+      CW_USEDEFAULT, CW_USEDEFAULT, w, h,
+      nullptr, nullptr, GetModuleHandle(nullptr), window);
+}
+
+void PipPlugin::PrewarmPipWindow(PipWindow* window) {
+  if (!window->hwnd) return;
+  // Apply the text now rather than with the next frame, which a hidden
+  // window would otherwise wait for.
+  if (window->repaint_timer_armed) {
+    KillTimer(window->hwnd, kRepaintTimerId);
+    window->repaint_timer_armed = false;
+  }
+  FlushPendingUpdate(window);
+
+  RECT rc;
+  GetClientRect(window->hwnd, &rc);
+  if (rc.right > 0 && rc.bottom > 0 &&
+      (window->back_dirty || rc.right != window->back_width ||
+       rc.bottom != window->back_height)) {
+    RenderBackBuffer(window, rc.right, rc.bottom);
+  }
+}
+
+void PipPlugin::ApplyConfiguration(PipWindow* window, unsigned dirty) {
+  // GDI objects are only needed by the fallback renderer; the Direct2D one
+  // keys its text format on the size and sets colors per frame.
+  if (!window->d2d_renderer) {
+    if ((dirty & kStyleTextSize) || !window->font) {
+      window->font = SharedFont(window->style.text_size);
+    }
+    if ((dirty & kStyleBackground) || !window->background_brush) {
+      if (window->background_brush) DeleteObject(window->background_brush);
+      window->background_brush =
+          CreateSolidBrush(window->style.background_color);
+    }
+  }
+  if (dirty & (kStyleBackground | kStyleTextColor | kStyleTextSize |
+               kStyleTextAlign)) {
+    window->back_dirty = true;
+  }
+  if (dirty & (kStyleBackground | kStyleTextColor | kStyleTextSize)) {
+    ReleaseClockGlyphs(window);
+  }
+
+  if (!window->hwnd) return;
+
+  // Direct2D carries alpha per pixel; GDI fades the whole window.
+  if (!window->d2d_renderer && (dirty & kStyleBackground)) {
+    SetLayeredWindowAttributes(window->hwnd, 0,
+                               window->style.background_alpha, LWA_ALPHA);
+  }
+
+  if (dirty & kStyleRatio) {
+    RECT rc;
+    GetWindowRect(window->hwnd, &rc);
+    int currentHeight = rc.bottom - rc.top;
+    int newWidth = static_cast<int>(currentHeight * window->style.ratio_width /
+                                    (double)window->style.ratio_height);
+    SetWindowPos(window->hwnd, nullptr,
+                 0, 0, newWidth, currentHeight,
+                 SWP_NOMOVE | SWP_NOZORDER);
+  }
+
+  if (window->back_dirty) ScheduleRepaint(window);
+}
+
+HFONT PipPlugin::SharedFont(int size) {
+  HFONT& font = fonts_[size];
+  if (!font) {
+    font = CreateFont(
+        -size, 0, 0, 0, FW_BOLD,
+        FALSE, FALSE, FALSE,
+        DEFAULT_CHARSET, OUT_OUTLINE_PRECIS,
+        CLIP_DEFAULT_PRECIS, CLEARTYPE_QUALITY,
+        VARIABLE_PITCH, L"Consolas");
+  }
+  return font;
+}
+
+void PipPlugin::UpdatePipText(PipWindow* window, const std::string& text) {
+  // Only the newest text is kept; it is converted when the next frame is
+  // flushed, so superseded texts in a burst are never converted or drawn.
+  window->pending_text = text;
+  window->text_pending = true;
+  if (window->hwnd) {
+    ScheduleRepaint(window);
+  } else {
+    FlushPendingUpdate(window);
+  }
+}
+
+void PipPlugin::EditPipText(PipWindow* window, size_t start, size_t end,
+                            const std::string& text) {
+  // A full update still waiting for the next frame is the base of the edit.
+  ApplyPendingText(window);
+  // UTF-8 takes at least as many bytes as UTF-16 code units, so an edit
+  // from 0 to the size of a mapped text replaces all of it.
+  if (window->mapped_text) {
+    UnmapText(window, start > 0 || end < window->mapped_text->size());
+  }
+  size_t size = window->current_text.size();
+  start = std::min(start, size);
+  end = std::min(std::max(start, end), size);
+  ReplaceCurrentText(window, start, end, Utf8ToWide(text));
+  if (window->hwnd) {
+    ScheduleRepaint(window);
+  } else {
+    FlushPendingUpdate(window);
+  }
+}
+
+bool PipPlugin::LoadTextFile(PipWindow* window, const std::string& path) {
+  auto mapped = std::make_unique<MappedFile>();
+  if (!mapped->Open(Utf8ToWide(path))) return false;
+
+  // Replaces the text as a whole, including an update still pending. The
+  // renderer indexes the paragraphs of the view and converts only those it
+  // lays out; the UTF-8 bytes are never copied.
+  window->text_pending = false;
+  window->pending_text.clear();
+  if (window->d2d_renderer) {
+    window->d2d_renderer->MapText(mapped->data(), mapped->size());
+  }
+  window->current_text.clear();
+  window->mapped_text = std::move(mapped);
+  window->text_generation++;
+  if (!window->clock.active()) window->fit.Reset();
+  window->text_dirty = true;
+  return true;
+}
+
+bool PipPlugin::ApplyBatchOperation(PipWindow* window,
+                                    const flutter::EncodableValue& operation) {
+  const auto* map = std::get_if<flutter::EncodableMap>(&operation);
+  if (!map) return false;
+  const std::string* method = nullptr;
+  if (auto it = map->find(flutter::EncodableValue("method"));
+      it != map->end()) {
+    method = std::get_if<std::string>(&it->second);
+  }
+  if (!method) return false;
+  // Scrolling is not supported on Windows, so the text stays where it is.
+  if (*method == "controlScroll") return true;
+
+  // Every operation addresses the batch's window.
+  flutter::EncodableMap op_args;
+  if (auto it = map->find(flutter::EncodableValue("args"));
+      it != map->end()) {
+    if (auto args = std::get_if<flutter::EncodableMap>(&it->second)) {
+      op_args = *args;
+    }
+  }
+  op_args[flutter::EncodableValue("id")] = flutter::EncodableValue(window->id);
+
+  bool success = false;
+  HandleMethodCall(
+      flutter::MethodCall<flutter::EncodableValue>(
+          *method, std::make_unique<flutter::EncodableValue>(op_args)),
+      std::make_unique<flutter::MethodResultFunctions<>>(
+          [&success](const flutter::EncodableValue* result) {
+            const bool* value = result ? std::get_if<bool>(result) : nullptr;
+            success = !value || *value;
+          },
+          nullptr, nullptr));
+  return success;
+}
+
+void PipPlugin::StageFfiText(const char* text, bool replace) {
+  std::lock_guard<std::mutex> lock(ffi_update.mutex);
+  if (replace) {
+    ffi_update.text.assign(text);
+    ffi_update.replace = true;
+  } else {
+    ffi_update.text.append(text);
+  }
+  ++ffi_update.staged;
+  PostFfiUpdate();
+}
+
+void PipPlugin::StageFfiRedraw() {
+  std::lock_guard<std::mutex> lock(ffi_update.mutex);
+  ffi_update.redraw = true;
+  ++ffi_update.staged;
+  PostFfiUpdate();
+}
+
+void PipPlugin::BindFfiWindow(HWND hwnd) {
+  std::lock_guard<std::mutex> lock(ffi_update.mutex);
+  ffi_update.hwnd = hwnd;
+  ffi_update.posted = false;
+  // Updates staged before the window existed are applied now.
+  if (ffi_update.replace || ffi_update.redraw || !ffi_update.text.empty()) {
+    PostFfiUpdate();
+  }
+  // So are ring records published while no window could be woken.
+  if (hwnd && ffi_ring.load()) PostMessage(hwnd, kRingWakeMessage, 0, 0);
+}
+
+TextRing* PipPlugin::OpenFfiRing(uint32_t capacity) {
+  std::lock_guard<std::mutex> lock(ffi_update.mutex);
+  if (!ffi_ring.load()) ffi_ring.store(new TextRing(capacity));
+  return ffi_ring.load();
+}
+
+TextRing* PipPlugin::FfiRing() {
+  return ffi_ring.load();
+}
+
+void PipPlugin::WakeFfiRingConsumer() {
+  std::lock_guard<std::mutex> lock(ffi_update.mutex);
+  if (ffi_update.hwnd) PostMessage(ffi_update.hwnd, kRingWakeMessage, 0, 0);
+}
+
+void PipPlugin::DrainFfiRing(PipWindow* window) {
+  TextRing* ring = ffi_ring.load();
+  bool replace = false;
+  if (size_t records = ring->Drain(&ffi_text_, &replace)) {
+    NoteUpdates(window, records);
+    ++window->batch_depth;
+    ApplyCoalescedText(window, ffi_text_, replace);
+    --window->batch_depth;
+    ffi_text_.clear();
+  } else if (ring->Sleep()) {
+    window->ring_draining = false;
+  }
+}
+
+void PipPlugin::ApplyCoalescedText(PipWindow* window, const std::string& text,
+                                   bool replace) {
+  if (replace) {
+    UpdatePipText(window, text);
+  } else if (!text.empty()) {
+    EditPipText(window, SIZE_MAX, SIZE_MAX, text);
+  }
+}
+
+void PipPlugin::ApplyFfiUpdate(PipWindow* window) {
+  bool replace;
+  bool redraw;
+  uint64_t staged;
+  {
+    std::lock_guard<std::mutex> lock(ffi_update.mutex);
+    ffi_text_.swap(ffi_update.text);
+    replace = ffi_update.replace;
+    redraw = ffi_update.redraw;
+    staged = ffi_update.staged;
+    ffi_update.replace = false;
+    ffi_update.redraw = false;
+    ffi_update.posted = false;
+    ffi_update.staged = 0;
+  }
+
+  NoteUpdates(window, staged);
+  ++window->batch_depth;
+  ApplyCoalescedText(window, ffi_text_, replace);
+  if (redraw) {
+    window->back_dirty = true;
+    window->repaint_pending = true;
+  }
+  --window->batch_depth;
+  if (window->repaint_pending) ScheduleRepaint(window);
+  ffi_text_.clear();
+}
+
+void PipPlugin::ScheduleRepaint(PipWindow* window) {
+  window->repaint_pending = true;
+  if (window->batch_depth > 0 || window->repaint_timer_armed) return;
+
+  ULONGLONG now = GetTickCount64();
+  ULONGLONG elapsed = now - window->last_flush_ms;
+  if (elapsed >= window->frame_interval_ms) {
+    FlushPendingUpdate(window);
+    return;
+  }
+  SetTimer(window->hwnd, kRepaintTimerId,
+           static_cast<UINT>(window->frame_interval_ms - elapsed), nullptr);
+  window->repaint_timer_armed = true;
+}
+
+void PipPlugin::FlushPendingUpdate(PipWindow* window) {
+  if (window->ring_draining) DrainFfiRing(window);
+  ApplyPendingText(window);
+  if (window->text_dirty) {
+    window->text_dirty = false;
+    window->back_dirty = true;
+  }
+
+  if (window->hwnd && window->repaint_pending) {
+    // WM_PAINT is delivered asynchronously from the message loop.
+    InvalidateRect(window->hwnd, nullptr, FALSE);
+    ++window->stats.frames;
+  }
+  window->repaint_pending = false;
+  window->last_flush_ms = GetTickCount64();
+
+  if (window->ring_draining && window->hwnd && !window->repaint_timer_armed) {
+    // Check the ring again next frame while records keep arriving.
+    SetTimer(window->hwnd, kRepaintTimerId, window->frame_interval_ms,
+             nullptr);
+    window->repaint_timer_armed = true;
+  }
+}
+
+void PipPlugin::NoteUpdates(PipWindow* window, uint64_t count) {
+  if (count == 0 || window->batch_depth > 0) return;
+  // All but the first share a frame, and so does the first if one is
+  // still owed.
+  window->stats.updates += count;
+  window->stats.superseded += window->repaint_pending ? count : count - 1;
+}
+
+void PipPlugin::ApplyPendingText(PipWindow* window) {
+  if (!window->text_pending) return;
+  std::wstring wtext = Utf8ToWide(window->pending_text);
+  window->pending_text.clear();
+  window->text_pending = false;
+
+  // Only the span between the unchanged head and tail is replaced, so the
+  // paragraphs around it keep their layouts.
+  const std::wstring& current = window->current_text;
+  size_t limit = std::min(current.size(), wtext.size());
+  size_t prefix = 0;
+  while (prefix < limit && current[prefix] == wtext[prefix]) ++prefix;
+  size_t suffix = 0;
+  while (suffix < limit - prefix &&
+         current[current.size() - 1 - suffix] ==
+             wtext[wtext.size() - 1 - suffix]) {
+    ++suffix;
+  }
+  ReplaceCurrentText(window, prefix, current.size() - suffix,
+                     wtext.substr(prefix, wtext.size() - prefix - suffix));
+}
+
+void PipPlugin::UnmapText(PipWindow* window, bool keep) {
+  if (!window->mapped_text) return;
+  if (keep) {
+    window->current_text = Utf8ToWide(std::string(
+        window->mapped_text->data(), window->mapped_text->size()));
+  }
+  // The renderer lets go of the view before it is unmapped.
+  if (window->d2d_renderer) window->d2d_renderer->ResetText();
+  window->mapped_text.reset();
+  window->text_generation++;
+  window->text_dirty = true;
+}
+
+void PipPlugin::ReplaceCurrentText(PipWindow* window, size_t start,
+                                   size_t end, const std::wstring& text) {
+  UnmapText(window, false);
+  window->current_text.replace(start, end - start, text);
+  window->text_generation++;
+  if (!window->clock.active()) window->fit.Reset();
+  if (window->d2d_renderer) {
+    window->d2d_renderer->SpliceText(window->current_text, start, end,
+                                     start + text.size());
+  }
+  window->text_dirty = true;
+}
+
+void PipPlugin::RenderBackBuffer(PipWindow* window, int width, int height) {
+  FitTextSize(window, width, height);
+  const PipStyle& style = window->style;
+  bool clock = window->clock.active();
+  if (window->d2d_renderer) {
+    DirectWriteRenderer::Frame frame = {
+        clock ? &window->clock_text : &window->current_text,
+        style.background_color, style.background_alpha,
+        style.text_color, style.text_alpha,
+        static_cast<float>(style.text_size),
+        style.text_format, window->text_scale};
+    // On failure the buffer stays dirty and the next paint retries.
+    if (clock ? window->d2d_renderer->RenderCells(frame, width, height)
+              : window->d2d_renderer->Render(frame, width, height)) {
+      window->back_width = width;
+      window->back_height = height;
+      window->back_dirty = false;
+    }
+    return;
+  }
+
+  if (!window->back_dc || width != window->back_width ||
+      height != window->back_height) {
+    ReleaseBackBuffer(window);
+    HDC screen_dc = GetDC(window->hwnd);
+    window->back_dc = CreateCompatibleDC(screen_dc);
+    window->back_bitmap = CreateCompatibleBitmap(screen_dc, width, height);
+    ReleaseDC(window->hwnd, screen_dc);
+    window->back_old_bitmap = SelectObject(window->back_dc,
+                                           window->back_bitmap);
+    window->back_width = width;
+    window->back_height = height;
+  }
+
+  HDC back_dc = window->back_dc;
+  RECT rc = {0, 0, width, height};
+
+  // Background
+  FillRect(back_dc, &rc, window->background_brush);
+
+  // A size tween scales the text drawn with the cached font about the
+  // center.
+  float scale = window->text_scale;
+  if (scale != 1.0f) {
+    SetGraphicsMode(back_dc, GM_ADVANCED);
+    XFORM transform = {scale, 0.0f, 0.0f, scale,
+                       (1.0f - scale) * width / 2,
+                       (1.0f - scale) * height / 2};
+    SetWorldTransform(back_dc, &transform);
+  }
+
+  if (clock) {
+    PaintClockCells(window, 0, window->clock_text.size());
+  } else {
+    // Text
+    SetBkMode(back_dc, TRANSPARENT);
+    SetTextColor(back_dc, style.text_color);
+    HFONT old = (HFONT)SelectObject(back_dc, window->font);
+
+    // Of a mapped text only the head that can fit the single line is
+    // converted, cut at a character boundary.
+    std::wstring head;
+    if (window->mapped_text) {
+      const char* data = window->mapped_text->data();
+      size_t length = std::min(window->mapped_text->size(), kMappedLineBytes);
+      if (length < window->mapped_text->size()) {
+        while (length > 0 && (data[length] & 0xC0) == 0x80) --length;
+      }
+      head = Utf8ToWide(std::string(data, length));
+    }
+
+    DrawTextW(
+        back_dc,
+        window->mapped_text ? head.c_str() : window->current_text.c_str(),
+        -1,
+        &rc,
+        style.text_format
+        | DT_VCENTER
+        | DT_SINGLELINE);
+
+    SelectObject(back_dc, old);
+  }
+
+  if (scale != 1.0f) {
+    ModifyWorldTransform(back_dc, nullptr, MWT_IDENTITY);
+    SetGraphicsMode(back_dc, GM_COMPATIBLE);
+  }
+  window->back_dirty = false;
+}
+
+void PipPlugin::ReleaseBackBuffer(PipWindow* window) {
+  if (window->back_dc) {
+    SelectObject(window->back_dc, window->back_old_bitmap);
+    DeleteDC(window->back_dc);
+    window->back_dc = nullptr;
+  }
+  if (window->back_bitmap) {
+    DeleteObject(window->back_bitmap);
+    window->back_bitmap = nullptr;
+  }
+  window->back_old_bitmap = nullptr;
+  window->back_width = 0;
+  window->back_height = 0;
+  window->back_dirty = true;
+}
+
+void PipPlugin::TickClock(PipWindow* window) {
+  std::wstring text = Utf8ToWide(window->clock.Text(MonotonicMicros()));
+  if (text != window->clock_text) SetClockText(window, text);
+}
+
+void PipPlugin::SetClockText(PipWindow* window, const std::wstring& text) {
+  // A clock of another shape is fitted again.
+  bool reshaped = window->fit_enabled &&
+                  ClockShape(text) != ClockShape(window->clock_text);
+  if (reshaped) window->fit.Reset();
+  bool partial = !reshaped && window->hwnd &&
+                 IsWindowVisible(window->hwnd) && !window->back_dirty &&
+                 !window->repaint_pending && window->back_width > 0 &&
+                 window->text_scale == 1.0f &&
+                 text.size() == window->clock_text.size();
+  if (!partial) {
+    window->clock_text = text;
+    window->back_dirty = true;
+    if (window->hwnd) ScheduleRepaint(window);
+    return;
+  }
+
+  size_t first = 0;
+  while (first < text.size() && text[first] == window->clock_text[first]) {
+    ++first;
+  }
+  size_t last = text.size();
+  while (last > first && text[last - 1] == window->clock_text[last - 1]) {
+    --last;
+  }
+  window->clock_text = text;
+  if (first == last) return;
+
+  if (window->d2d_renderer) {
+    const PipStyle& style = window->style;
+    DirectWriteRenderer::Frame frame = {
+        &window->clock_text,
+        style.background_color, style.background_alpha,
+        style.text_color, style.text_alpha,
+        static_cast<float>(style.text_size),
+        style.text_format, window->text_scale};
+    if (!window->d2d_renderer->RenderCells(frame, window->back_width,
+                                           window->back_height, first,
+                                           last)) {
+      window->back_dirty = true;
+      ScheduleRepaint(window);
+      return;
+    }
+  } else {
+    PaintClockCells(window, first, last);
+    RECT cells = ClockCellsRect(window, first, last);
+    // A stretched frame is blitted whole, see WM_PAINT.
+    InvalidateRect(window->hwnd, window->sizing ? nullptr : &cells, FALSE);
+  }
+  ++window->stats.frames;
+}
+
+bool PipPlugin::EnsureClockGlyphs(PipWindow* window) {
+  const std::wstring& text = window->clock_text;
+  bool complete = window->glyph_dc != nullptr;
+  for (size_t i = 0; complete && i < text.size(); ++i) {
+    complete = window->glyph_chars.find(text[i]) != std::wstring::npos;
+  }
+  if (complete) return true;
+
+  // Rebuild with every digit and each character seen so far.
+  std::wstring chars = window->glyph_chars.empty() ? L"0123456789"
+                                                   : window->glyph_chars;
+  for (wchar_t c : text) {
+    if (chars.find(c) == std::wstring::npos) chars += c;
+  }
+  ReleaseClockGlyphs(window);
+
+  HDC screen_dc = GetDC(window->hwnd);
+  HDC glyph_dc = CreateCompatibleDC(screen_dc);
+  HGDIOBJ old_font = SelectObject(glyph_dc, window->font);
+  int cell_width = 0;
+  for (wchar_t c : chars) {
+    SIZE extent;
+    GetTextExtentPoint32W(glyph_dc, &c, 1, &extent);
+    cell_width = std::max(cell_width, static_cast<int>(extent.cx));
+  }
+  TEXTMETRIC metrics;
+  GetTextMetrics(glyph_dc, &metrics);
+  int cell_height = metrics.tmHeight;
+  int strip_width = cell_width * static_cast<int>(chars.size());
+  window->glyph_bitmap =
+      CreateCompatibleBitmap(screen_dc, strip_width, cell_height);
+  ReleaseDC(window->hwnd, screen_dc);
+  window->glyph_old_bitmap = SelectObject(glyph_dc, window->glyph_bitmap);
+
+  RECT strip = {0, 0, strip_width, cell_height};
+  FillRect(glyph_dc, &strip, window->background_brush);
+  SetBkMode(glyph_dc, TRANSPARENT);
+  SetTextColor(glyph_dc, window->style.text_color);
+  for (size_t i = 0; i < chars.size(); ++i) {
+    RECT cell = {cell_width * static_cast<int>(i), 0,
+                 cell_width * static_cast<int>(i + 1), cell_height};
+    DrawTextW(glyph_dc, &chars[i], 1, &cell,
+              DT_CENTER | DT_VCENTER | DT_SINGLELINE);
+  }
+  SelectObject(glyph_dc, old_font);
+
+  window->glyph_dc = glyph_dc;
+  window->glyph_chars = chars;
+  window->cell_width = cell_width;
+  window->cell_height = cell_height;
+  return true;
+}
+
+void PipPlugin::ReleaseClockGlyphs(PipWindow* window) {
+  if (window->glyph_dc) {
+    SelectObject(window->glyph_dc, window->glyph_old_bitmap);
+    DeleteDC(window->glyph_dc);
+    window->glyph_dc = nullptr;
+  }
+  if (window->glyph_bitmap) {
+    DeleteObject(window->glyph_bitmap);
+    window->glyph_bitmap = nullptr;
+  }
+  window->glyph_old_bitmap = nullptr;
+}
+
+RECT PipPlugin::ClockCellsRect(PipWindow* window, size_t first, size_t last) {
+  int total = window->cell_width * static_cast<int>(window->clock_text.size());
+  int x = 0;
+  if (window->style.text_format & DT_CENTER) {
+    x = (window->back_width - total) / 2;
+  } else if (window->style.text_format & DT_RIGHT) {
+    x = window->back_width - total;
+  }
+  int y = (window->back_height - window->cell_height) / 2;
+  RECT rect = {x + window->cell_width * static_cast<int>(first), y,
+               x + window->cell_width * static_cast<int>(last),
+               y + window->cell_height};
+  return rect;
+}
+
+void PipPlugin::PaintClockCells(PipWindow* window, size_t first,
+                                size_t last) {
+  if (!window->back_dc || !EnsureClockGlyphs(window)) return;
+  RECT cells = ClockCellsRect(window, first, last);
+  for (size_t i = first; i < last; ++i) {
+    size_t glyph = window->glyph_chars.find(window->clock_text[i]);
+    BitBlt(window->back_dc,
+           cells.left + window->cell_width * static_cast<int>(i - first),
+           cells.top, window->cell_width, window->cell_height,
+           window->glyph_dc, window->cell_width * static_cast<int>(glyph), 0,
+           SRCCOPY);
+  }
+}
+
+void PipPlugin::SetCue(PipWindow* window, size_t index) {
+  window->cue_index = index;
+  window->text_pending = false;
+  window->pending_text.clear();
+  ReplaceCurrentText(window, 0, window->current_text.size(),
+                     index == CueTrack::kNoCue
+                         ? std::wstring()
+                         : Utf8ToWide(window->cues.cue(index).text));
+}
+
+bool PipPlugin::ShowCue(PipWindow* window) {
+  size_t index =
+      window->cues.CueAt(window->cues.PositionMs(MonotonicMicros()));
+  if (index == window->cue_index) return false;
+  SetCue(window, index);
+  return true;
+}
+
+void PipPlugin::UpdateCueTimer(PipWindow* window) {
+  if (!window->hwnd) return;
+  int64_t now = MonotonicMicros();
+  int64_t due = window->cues.NextChangeUs(now);
+  if (due < 0) {
+    KillTimer(window->hwnd, kCueTimerId);
+    return;
+  }
+  // Rounded up, as firing early would only re-arm. SetTimer replaces the
+  // timer armed before.
+  UINT delay_ms = static_cast<UINT>(
+      std::min<int64_t>((due - now + 999) / 1000, INT_MAX));
+  SetTimer(window->hwnd, kCueTimerId, delay_ms, nullptr);
+}
+
+void PipPlugin::ReadTail(PipWindow* window) {
+  TailWatch* watch = window->tail_watch.get();
+  if (watch->Rearm()) window->tail.Discard();
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(watch->file, &size)) return;
+  // A file that shrank was truncated and is followed again from its start.
+  if (size.QuadPart < watch->offset) {
+    window->tail.Discard();
+    watch->offset = 0;
+  }
+  bool skipped = size.QuadPart - watch->offset > kTailReadLimit;
+  if (skipped) {
+    window->tail.Discard();
+    watch->offset = size.QuadPart - kTailReadLimit;
+  }
+  if (size.QuadPart == watch->offset) return;
+
+  std::string data(static_cast<size_t>(size.QuadPart - watch->offset), '\0');
+  OVERLAPPED position = {};
+  position.Offset = static_cast<DWORD>(watch->offset);
+  position.OffsetHigh = static_cast<DWORD>(watch->offset >> 32);
+  DWORD length = 0;
+  if (!ReadFile(watch->file, &data[0], static_cast<DWORD>(data.size()),
+                &length, &position) ||
+      length == 0) {
+    return;
+  }
+  watch->offset += length;
+  // Lines start after a skip only at its first line break.
+  size_t begin = 0;
+  if (skipped) {
+    size_t line_break = data.find('\n');
+    begin = line_break < length ? line_break + 1 : length;
+  }
+  ApplyTail(window, window->tail.Feed(data.data() + begin, length - begin));
+}
+
+void PipPlugin::ApplyTail(PipWindow* window, const LineTail::Edit& edit) {
+  if (edit.remove == 0 && edit.append.empty()) return;
+  NoteUpdates(window, 1);
+  window->text_pending = false;
+  window->pending_text.clear();
+  size_t size = window->current_text.size();
+  if (window->text_generation != window->tail_generation) {
+    // The text was set otherwise meanwhile.
+    ReplaceCurrentText(window, 0, size, Utf8ToWide(window->tail.Text()));
+  } else {
+    if (edit.remove_units > 0) {
+      ReplaceCurrentText(window, 0, edit.remove_units, L"");
+    }
+    size = window->current_text.size();
+    ReplaceCurrentText(window, size, size, Utf8ToWide(edit.append));
+  }
+  window->tail_generation = window->text_generation;
+  if (window->hwnd) {
+    ScheduleRepaint(window);
+  } else {
+    FlushPendingUpdate(window);
+  }
+}
+
+void PipPlugin::ApplySourceFrame(PipWindow* window) {
+  std::string frame;
+  if (!window->source->TakeFrame(&frame)) return;
+  NoteUpdates(window, 1);
+  UpdatePipText(window, frame);
+}
+
+bool PipPlugin::StepAnimation(PipWindow* window, unsigned dirty) {
+  unsigned properties = window->animation.properties();
+  double values[PipAnimation::kPropertyCount];
+  bool running = window->animation.Sample(MonotonicMicros(), values);
+
+  PipStyle& style = window->style;
+  if (properties & (1u << PipAnimation::kBackgroundRed)) {
+    style.background_color =
+        RGB(ToChannel(values[PipAnimation::kBackgroundRed]),
+            ToChannel(values[PipAnimation::kBackgroundGreen]),
+            ToChannel(values[PipAnimation::kBackgroundBlue]));
+    style.background_alpha = ToChannel(values[PipAnimation::kBackgroundAlpha]);
+    dirty |= kStyleBackground;
+  }
+  if (properties & (1u << PipAnimation::kTextRed)) {
+    style.text_color = RGB(ToChannel(values[PipAnimation::kTextRed]),
+                           ToChannel(values[PipAnimation::kTextGreen]),
+                           ToChannel(values[PipAnimation::kTextBlue]));
+    style.text_alpha = ToChannel(values[PipAnimation::kTextAlpha]);
+    dirty |= kStyleTextColor;
+  }
+  if (properties & (1u << PipAnimation::kTextSize)) {
+    double size = values[PipAnimation::kTextSize];
+    if (running) {
+      window->text_scale = static_cast<float>(size / style.text_size);
+    } else {
+      window->text_scale = 1.0f;
+      int end_size = static_cast<int>(std::lround(size));
+      if (end_size != style.text_size) {
+        style.text_size = end_size;
+        dirty |= kStyleTextSize;
+      }
+    }
+    window->back_dirty = true;
+  }
+  ApplyConfiguration(window, dirty);
+  return running;
+}
+
+unsigned PipPlugin::StopAnimation(PipWindow* window) {
+  if (window->hwnd) KillTimer(window->hwnd, kAnimationTimerId);
+  window->animation.Stop();
+  if (window->text_scale == 1.0f) return 0;
+  window->style.text_size = static_cast<int>(
+      std::lround(window->style.text_size * window->text_scale));
+  window->text_scale = 1.0f;
+  return kStyleTextSize;
+}
+
+void PipPlugin::FitTextSize(PipWindow* window, int width, int height) {
+  // The size fitted last is kept while the window is being sized or a size
+  // tween runs. A mapped file is too large to measure whole; it keeps its
+  // size.
+  if (!window->fit_enabled || window->sizing || window->text_scale != 1.0f ||
+      window->mapped_text) {
+    return;
+  }
+  std::wstring shape;
+  const std::wstring* text = &window->current_text;
+  bool clock = window->clock.active();
+  if (clock) {
+    shape = ClockShape(window->clock_text);
+    text = &shape;
+  }
+  int fitted = window->fit.Fit(
+      width, height, window->fit_min_size,
+      std::max(window->fit_min_size, window->fit_max_size),
+      [&](int size) {
+        return MeasureFitText(window, *text, size, width, !clock);
+      });
+  window->fit_width = width;
+  window->fit_height = height;
+  if (fitted == window->style.text_size) return;
+  window->style.text_size = fitted;
+  if (!window->d2d_renderer) window->font = SharedFont(fitted);
+  ReleaseClockGlyphs(window);
+}
+
+double PipPlugin::MeasureFitText(PipWindow* window, const std::wstring& text,
+                                 int size, int width, bool wrap) {
+  // A size that cannot be measured never fits, nor does a line wider than
+  // |width|.
+  double height = HUGE_VAL;
+  if (window->d2d_renderer) {
+    IDWriteTextFormat* format =
+        d2d_device_->TextFormat(static_cast<float>(size));
+    Microsoft::WRL::ComPtr<IDWriteTextLayout> layout;
+    // Wrapped to |width| as the paragraphs are drawn.
+    if (format &&
+        SUCCEEDED(d2d_device_->dwrite_factory()->CreateTextLayout(
+            text.c_str(), static_cast<UINT32>(text.size()), format,
+            wrap ? static_cast<FLOAT>(width) : 1e6f, 1e6f,
+            layout.GetAddressOf()))) {
+      DWRITE_TEXT_METRICS metrics = {};
+      layout->GetMetrics(&metrics);
+      if (wrap || metrics.widthIncludingTrailingWhitespace <= width) {
+        height = metrics.height;
+      }
+    }
+    return height;
+  }
+
+  // GDI draws the text on a single line.
+  HDC dc = CreateCompatibleDC(nullptr);
+  if (!dc) return height;
+  HGDIOBJ old = SelectObject(dc, SharedFont(size));
+  RECT rc = {0, 0, 0, 0};
+  if (DrawTextW(dc, text.c_str(), -1, &rc,
+                window->style.text_format | DT_SINGLELINE | DT_CALCRECT) &&
+      rc.right - rc.left <= width) {
+    height = static_cast<double>(rc.bottom - rc.top);
+  }
+  SelectObject(dc, old);
+  DeleteDC(dc);
+  return height;
+}
+
+void PipPlugin::NotifyPipStopped(PipWindow* window) {
+  if (channel_) {
+    channel_->InvokeMethod(
+        "pipStopped",
+        std::make_unique<flutter::EncodableValue>(flutter::EncodableMap{
+            {flutter::EncodableValue("id"),
+             flutter::EncodableValue(window->id)},
+        }));
+  }
+}
 
 LRESULT CALLBACK PipPlugin::PipWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
-  PipPlugin* self = nullptr;
+  PipWindow* self = nullptr;
   if (msg == WM_NCCREATE) {
     auto cs = reinterpret_cast<CREATESTRUCT*>(lParam);
-    self = reinterpret_cast<PipPlugin*>(cs->lpCreateParams);
+    self = reinterpret_cast<PipWindow*>(cs->lpCreateParams);
     SetWindowLongPtr(hwnd, GWLP_USERDATA, (LONG_PTR)self);
   } else {
-    self = reinterpret_cast<PipPlugin*>(GetWindowLongPtr(hwnd, GWLP_USERDATA));
+    self = reinterpret_cast<PipWindow*>(GetWindowLongPtr(hwnd, GWLP_USERDATA));
   }
+  PipPlugin* plugin = self ? self->plugin : nullptr;
 
   switch (msg) {
     case WM_PAINT: {
       PAINTSTRUCT ps;
       HDC hdc = BeginPaint(hwnd, &ps);
       RECT rc; GetClientRect(hwnd, &rc);
-      
-      // Background
-      HBRUSH brush = CreateSolidBrush(self->background_color_);
-      FillRect(hdc, &rc, brush);
-      DeleteObject(brush);
-
-      // Text
-      SetBkMode(hdc, TRANSPARENT);
-      SetTextColor(hdc, self->text_color_);
-      HFONT old = (HFONT)SelectObject(hdc, self->pip_font_);
-
-      DrawTextW(
-          hdc,
-          self->pip_current_text_.c_str(),
-          -1,
-          &rc,
-          self->text_format_
-          | DT_VCENTER
-          | DT_SINGLELINE);
-
-      SelectObject(hdc, old);
+      int w = rc.right - rc.left;
+      int h = rc.bottom - rc.top;
+
+      if (self && w > 0 && h > 0) {
+        // Live resize: while the window is being sized the last frame is
+        // stretched to the new size, which WM_SIZING keeps at the same
+        // aspect ratio. It is rendered at the final size after the drag.
+        bool stretch = self->sizing && !self->back_dirty &&
+                       self->back_width > 0 && self->back_height > 0 &&
+                       (w != self->back_width || h != self->back_height);
+        if (stretch && self->d2d_renderer) {
+          stretch = self->d2d_renderer->PresentStretched(w, h);
+        }
+        if (!stretch && (self->back_dirty || w != self->back_width ||
+                         h != self->back_height)) {
+          plugin->RenderBackBuffer(self, w, h);
+        }
+        // The Direct2D backend presents through DirectComposition.
+        if (self->back_dc && stretch) {
+          SetStretchBltMode(hdc, COLORONCOLOR);
+          StretchBlt(hdc, 0, 0, w, h,
+                     self->back_dc, 0, 0,
+                     self->back_width, self->back_height,
+                     SRCCOPY);
+        } else if (self->back_dc) {
+          BitBlt(hdc,
+                 ps.rcPaint.left, ps.rcPaint.top,
+                 ps.rcPaint.right - ps.rcPaint.left,
+                 ps.rcPaint.bottom - ps.rcPaint.top,
+                 self->back_dc,
+                 ps.rcPaint.left, ps.rcPaint.top,
+                 SRCCOPY);
+        }
+      }
+
       EndPaint(hwnd, &ps);
+      if (self && self->show_time != 0) {
+        self->stats.first_frame_us = static_cast<uint64_t>(
+            (PerfCounter() - self->show_time) * 1000000 / PerfFrequency());
+        self->show_time = 0;
+      }
       return 0;
     }
 
+    case WM_TIMER: {
+      if (self && wParam == kClockTimerId) {
+        plugin->TickClock(self);
+        return 0;
+      }
+      if (self && wParam == kCueTimerId) {
+        if (plugin->ShowCue(self)) {
+          // Flushed with this tick rather than coalesced into the next
+          // frame.
+          self->repaint_pending = true;
+          plugin->FlushPendingUpdate(self);
+        }
+        plugin->UpdateCueTimer(self);
+        return 0;
+      }
+      if (self && wParam == kAnimationTimerId) {
+        if (!plugin->StepAnimation(self, 0)) {
+          KillTimer(hwnd, kAnimationTimerId);
+        }
+        return 0;
+      }
+      if (!self || wParam != kRepaintTimerId) break;
+      KillTimer(hwnd, kRepaintTimerId);
+      self->repaint_timer_armed = false;
+      plugin->FlushPendingUpdate(self);
+      return 0;
+    }
+
+    case kFfiUpdateMessage: {
+      if (!self) break;
+      plugin->ApplyFfiUpdate(self);
+      return 0;
+    }
+
+    case kTailChangedMessage: {
+      if (!self || !self->tail_watch) break;
+      plugin->ReadTail(self);
+      return 0;
+    }
+
+    case kSourceFrameMessage: {
+      if (!self || !self->source) break;
+      plugin->ApplySourceFrame(self);
+      return 0;
+    }
+
+    case kRingWakeMessage: {
+      if (!self) break;
+      self->ring_draining = true;
+      plugin->ScheduleRepaint(self);
+      return 0;
+    }
+
+    case WM_CLOSE: {
+      // A prewarmed window is only hidden, so startPip shows it again
+      // without creating and rendering it anew.
+      if (!self || !self->prewarm) break;
+      ShowWindow(hwnd, SW_HIDE);
+      self->visible = false;
+      plugin->NotifyPipStopped(self);
+      return 0;
+    }
+
+    case WM_ERASEBKGND:
+      // WM_PAINT covers the whole client area from the back buffer.
+      return 1;
+
+    case WM_ENTERSIZEMOVE: {
+      if (!self) break;
+      self->sizing = true;
+      return 0;
+    }
+
+    case WM_EXITSIZEMOVE: {
+      if (!self) break;
+      self->sizing = false;
+      // The frame stretched during the drag is rendered at the final size,
+      // and fitted to it in auto-fit mode.
+      RECT rc;
+      GetClientRect(hwnd, &rc);
+      if (rc.right != self->back_width || rc.bottom != self->back_height ||
+          (self->fit_enabled && (rc.right != self->fit_width ||
+                                 rc.bottom != self->fit_height))) {
+        self->back_dirty = true;
+        plugin->ScheduleRepaint(self);
+      }
+      return 0;
+    }
+
+    case WM_SIZE: {
+      // The whole frame depends on the size, not just the area uncovered.
+      if (self) InvalidateRect(hwnd, nullptr, FALSE);
+      break;
+    }
+
     case WM_SIZING: {
       if (!self) break;
       RECT* r = reinterpret_cast<RECT*>(lParam);
       int w = r->right - r->left;
       int h = r->bottom - r->top;
-      double ar = double(self->ratio_[0]) / self->ratio_[1];
-      if (w * self->ratio_[1] >= h * self->ratio_[0]) {
+      const PipStyle& style = self->style;
+      double ar = double(style.ratio_width) / style.ratio_height;
+      if (w * style.ratio_height >= h * style.ratio_width) {
         w = int(h * ar);
       } else {
         h = int(w / ar);
@@ -332,9 +2401,20 @@ LRESULT CALLBACK PipPlugin::PipWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARA
 
     case WM_DESTROY: {
       if (self) {
-        self->pip_hwnd_    = nullptr;
-        self->pip_visible_ = false;
-        self->NotifyPipStopped();
+        if (self->repaint_timer_armed) {
+          KillTimer(hwnd, kRepaintTimerId);
+          self->repaint_timer_armed = false;
+        }
+        plugin->ReleaseBackBuffer(self);
+        plugin->ReleaseClockGlyphs(self);
+        if (self->tail_watch) self->tail_watch->SetWindow(nullptr);
+        if (self->source) self->source->SetWindow(nullptr);
+        if (self->d2d_renderer) self->d2d_renderer->DetachWindow();
+        self->hwnd    = nullptr;
+        self->visible = false;
+        if (self == plugin->default_window_) plugin->BindFfiWindow(nullptr);
+        self->ring_draining = false;
+        plugin->NotifyPipStopped(self);
       }
       break;
     }
@@ -343,4 +2423,3 @@ LRESULT CALLBACK PipPlugin::PipWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARA
 }
 
 }  // namespace pip_plugin
-
@@ -6,12 +6,172 @@
 #include <flutter/plugin_registrar_windows.h>
 #include <windows.h>
 
+#include <cstdint>
+#include <map>
 #include <memory>
 #include <string>
-#include <vector>
+
+#include "cue_track.h"
+#include "line_tail.h"
+#include "pip_animation.h"
+#include "pip_clock.h"
+#include "text_fit.h"
 
 namespace pip_plugin {
 
+class DirectWriteDevice;
+class DirectWriteRenderer;
+class MappedFile;
+class PipeSource;
+class PipPlugin;
+class TailWatch;
+class TextRing;
+
+// Style of the PiP window as set by setupPip and updatePip.
+struct PipStyle {
+  COLORREF background_color = RGB(0,0,0);
+  BYTE     background_alpha = 255;
+  COLORREF text_color       = RGB(255,255,255);
+  BYTE     text_alpha       = 255;
+  int      text_size        = 32;         // pixel size
+  UINT     text_format      = DT_CENTER;  // DT_LEFT/DT_CENTER/DT_RIGHT
+  int      ratio_width      = 16;         // aspect ratio
+  int      ratio_height     = 9;
+};
+
+// Dirty bits of the PipStyle fields, grouped by what a change invalidates.
+enum StyleField : unsigned {
+  kStyleBackground = 1 << 0,  // background brush, layered window alpha
+  kStyleTextColor  = 1 << 1,  // rendered frame only
+  kStyleTextSize   = 1 << 2,  // font and text layout
+  kStyleTextAlign  = 1 << 3,  // text layout
+  kStyleRatio      = 1 << 4,  // window geometry
+  kStyleAll        = (1 << 5) - 1,
+};
+
+// Reads the style keys present in setupPip/updatePip |args| into |style|.
+// Returns the StyleField bits of the fields whose value changed.
+unsigned ParseStyle(const flutter::EncodableMap& args, PipStyle* style);
+
+// Counters reported by getStats. |superseded| counts updates merged into a
+// frame together with a newer one, so their own state was never drawn.
+struct PipStats {
+  uint64_t updates    = 0;
+  uint64_t superseded = 0;
+  uint64_t frames     = 0;
+  // Microseconds from the last startPip showing the window to its first
+  // painted frame, 0 until measured.
+  uint64_t first_frame_us = 0;
+};
+
+// One PiP window, addressed from Dart by |id|. The state outlives the HWND:
+// text and style set before setupPip, or after the window was closed, are
+// shown when it is created again.
+struct PipWindow {
+  PipWindow(PipPlugin* plugin, int64_t id);
+  ~PipWindow();
+
+  PipPlugin*          plugin;
+  int64_t             id;
+
+  // Persisted configuration
+  std::wstring        title{L"PiP Window"};
+  PipStyle            style;
+
+  // Win32 objects
+  HWND                hwnd             = nullptr;
+  // Rendered ahead of startPip and hidden rather than destroyed on close.
+  bool                prewarm          = false;
+  // QueryPerformanceCounter time startPip showed the window at, 0 once
+  // its first frame was painted.
+  int64_t             show_time        = 0;
+  HFONT               font             = nullptr;  // owned by the plugin
+  std::wstring        current_text;
+  // The file of loadTextFile, shown instead of current_text (then empty)
+  // until the text is set otherwise.
+  std::unique_ptr<MappedFile> mapped_text;
+  // Bumped by every change of current_text or mapped_text.
+  uint64_t            text_generation  = 0;
+  bool                visible          = false;
+  HBRUSH              background_brush = nullptr;
+
+  // Retained back buffer. WM_PAINT only blits it; it is re-rendered when
+  // the text, the style or the client size changes.
+  HDC                 back_dc          = nullptr;
+  HBITMAP             back_bitmap      = nullptr;
+  HGDIOBJ             back_old_bitmap  = nullptr;
+  int                 back_width       = 0;
+  int                 back_height      = 0;
+  bool                back_dirty       = true;
+
+  // Direct2D/DirectWrite backend; null when running on the GDI fallback.
+  std::unique_ptr<DirectWriteRenderer> d2d_renderer;
+
+  // Coalesced updates
+  std::string         pending_text;
+  bool                text_pending     = false;
+  bool                text_dirty       = false;
+  bool                repaint_pending  = false;
+  bool                repaint_timer_armed = false;
+  int                 batch_depth      = 0;
+  // The FFI ring is being drained once per frame until it runs dry.
+  bool                ring_draining    = false;
+  UINT                frame_interval_ms = 16;
+  ULONGLONG           last_flush_ms    = 0;
+
+  PipStats            stats;
+
+  // Clock content mode: instead of the text, the clock is rendered from a
+  // timer at the refresh rate. clock_text is what the frame shows.
+  PipClock            clock;
+  std::wstring        clock_text;
+  // GDI glyph cache of the clock: one cell per character of glyph_chars,
+  // side by side, rendered with the current style.
+  HDC                 glyph_dc         = nullptr;
+  HBITMAP             glyph_bitmap     = nullptr;
+  HGDIOBJ             glyph_old_bitmap = nullptr;
+  std::wstring        glyph_chars;
+  int                 cell_width       = 0;
+  int                 cell_height      = 0;
+
+  // Cue track switching the text from a timer while it plays. cue_index
+  // is the cue the text shows, CueTrack::kNoCue for none.
+  CueTrack            cues;
+  size_t              cue_index        = CueTrack::kNoCue;
+
+  // File tail mode: the text is the last lines of the file the watch
+  // follows, null while not tailing. tail_generation is the
+  // text_generation the tail's text was shown at.
+  LineTail            tail;
+  uint64_t            tail_generation  = 0;
+  std::unique_ptr<TailWatch> tail_watch;
+
+  // Named pipe source whose newest frame replaces the text, null while
+  // none is open.
+  std::unique_ptr<PipeSource> source;
+
+  // Style transition of animate, sampled from a timer at the refresh rate.
+  // During a size tween style.text_size is the larger of the two sizes and
+  // the contents are drawn scaled by text_scale, so the font and the
+  // layouts are created once rather than every frame.
+  PipAnimation        animation;
+  float               text_scale       = 1.0f;
+
+  // Auto-fit mode: style.text_size is the largest size in [fit_min_size,
+  // fit_max_size] at which the text, wrapped as drawn (GDI draws a single
+  // line), fits the client area, and fit_base_size is restored when the
+  // mode is turned off. The fit is kept while the window is being sized;
+  // fit_width x fit_height is the area last fitted.
+  bool                fit_enabled      = false;
+  TextFit             fit;
+  int                 fit_min_size     = 8;
+  int                 fit_max_size     = 512;
+  int                 fit_base_size    = 0;
+  int                 fit_width        = 0;
+  int                 fit_height       = 0;
+  bool                sizing           = false;
+};
+
 class PipPlugin : public flutter::Plugin {
  public:
   static void RegisterWithRegistrar(flutter::PluginRegistrarWindows* registrar);
@@ -23,31 +183,134 @@ class PipPlugin : public flutter::Plugin {
       const flutter::MethodCall<flutter::EncodableValue>& call,
       std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
 
+  // Stage updates from the dart:ffi entry points, which may run on any
+  // thread (see include/pip_plugin/pip_plugin_ffi.h). They go to the
+  // default window.
+  static void StageFfiText(const char* text, bool replace);
+  static void StageFfiRedraw();
+
+  // The FFI text ring, created by the producer's first OpenFfiRing(). The
+  // default PiP window drains it once per frame after WakeFfiRingConsumer().
+  static TextRing* OpenFfiRing(uint32_t capacity);
+  static TextRing* FfiRing();
+  static void WakeFfiRingConsumer();
+
  private:
   // Window procedure
   static LRESULT CALLBACK PipWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
+  // The window addressed by the "id" of a map argument, or the default
+  // window when there is none. Null for an unknown id.
+  PipWindow* LookupWindow(const flutter::EncodableValue* args);
+
   // Initialization & update routines
-  void CreatePipWindow();
-  void ApplyConfiguration();
-  void UpdatePipText(const std::string& text);
-  void NotifyPipStopped();
+  void CreatePipWindow(PipWindow* window);
+  HWND CreatePipHwnd(PipWindow* window, DWORD ex_style);
+  // Renders the first frame of the hidden window so that startPip only
+  // shows it.
+  void PrewarmPipWindow(PipWindow* window);
+  // Updates only the resources invalidated by the StyleField bits |dirty|.
+  void ApplyConfiguration(PipWindow* window, unsigned dirty);
+  void UpdatePipText(PipWindow* window, const std::string& text);
+  // Replaces UTF-16 code units [start, end) of the text, as Dart indexes
+  // strings. Out of range offsets are clamped.
+  void EditPipText(PipWindow* window, size_t start, size_t end,
+                   const std::string& text);
+  // Replaces the text with the UTF-8 file at |path|, kept mapped and
+  // rendered from the view. Returns false if the file cannot be read.
+  bool LoadTextFile(PipWindow* window, const std::string& path);
+  void NotifyPipStopped(PipWindow* window);
+  // Runs one applyBatch operation, checked by CheckBatchOperation, on
+  // |window| through HandleMethodCall.
+  bool ApplyBatchOperation(PipWindow* window,
+                           const flutter::EncodableValue& operation);
 
-  // Persisted configuration
-  std::wstring        window_title_{L"PiP Window"};
-  COLORREF            background_color_ = RGB(0,0,0);
-  BYTE                background_alpha_ = 255;
-  COLORREF            text_color_       = RGB(255,255,255);
-  BYTE                text_alpha_       = 255;
-  int                 text_size_        = 32;           // pixel size
-  UINT                text_format_      = DT_CENTER;    // DT_LEFT/DT_CENTER/DT_RIGHT
-  std::vector<int>    ratio_            = {16, 9};      // aspect ratio
+  // Points staged FFI updates at |hwnd| (or nowhere) and applies the newest
+  // one on the window's thread.
+  void BindFfiWindow(HWND hwnd);
+  void ApplyFfiUpdate(PipWindow* window);
+  void DrainFfiRing(PipWindow* window);
+  // Applies coalesced FFI text: replaces the text if |replace| is set and
+  // appends to it otherwise.
+  void ApplyCoalescedText(PipWindow* window, const std::string& text,
+                          bool replace);
 
-  // Win32 objects
-  HWND                           pip_hwnd_        = nullptr;
-  HFONT                          pip_font_        = nullptr;
-  std::wstring                   pip_current_text_;
-  bool                           pip_visible_     = false;
+  // Repaint coalescing: updates only mark state dirty, and at most one
+  // invalidation per display refresh reaches the window.
+  void ScheduleRepaint(PipWindow* window);
+  void FlushPendingUpdate(PipWindow* window);
+  // Counts |count| updates for getStats, before they are applied.
+  void NoteUpdates(PipWindow* window, uint64_t count);
+  void ApplyPendingText(PipWindow* window);
+  // Drops the mapped text of loadTextFile; with |keep| it is converted
+  // into current_text first.
+  void UnmapText(PipWindow* window, bool keep);
+  // Replaces code units [start, end) of current_text. A mapped text is
+  // dropped first and counts as empty.
+  void ReplaceCurrentText(PipWindow* window, size_t start, size_t end,
+                          const std::wstring& text);
+
+  // Back buffer rendering
+  void RenderBackBuffer(PipWindow* window, int width, int height);
+  void ReleaseBackBuffer(PipWindow* window);
+
+  // Clock mode. A tick formats the clock and, when the text changed, only
+  // redraws the span of changed cells.
+  void TickClock(PipWindow* window);
+  void SetClockText(PipWindow* window, const std::wstring& text);
+  // GDI fallback: the glyph cache covering the clock text, and the cells
+  // [first, last) in the back buffer.
+  bool EnsureClockGlyphs(PipWindow* window);
+  void ReleaseClockGlyphs(PipWindow* window);
+  RECT ClockCellsRect(PipWindow* window, size_t first, size_t last);
+  void PaintClockCells(PipWindow* window, size_t first, size_t last);
+
+  // Cue tracks. SetCue sets the text to cue |index| (none for
+  // CueTrack::kNoCue) without repainting; ShowCue switches to the cue due
+  // now and returns true if it changed. The cue timer fires once, when the
+  // next cue starts or ends at the current rate, and repaints right away.
+  void SetCue(PipWindow* window, size_t index);
+  bool ShowCue(PipWindow* window);
+  void UpdateCueTimer(PipWindow* window);
+
+  // File tail mode. ReadTail feeds the bytes appended to the file since the
+  // last read; ApplyTail then replaces only the dropped and the new lines.
+  void ReadTail(PipWindow* window);
+  void ApplyTail(PipWindow* window, const LineTail::Edit& edit);
+  // Shows the newest frame received by the pipe source, if any.
+  void ApplySourceFrame(PipWindow* window);
+
+  // Animations. StepAnimation applies the values due now together with
+  // the StyleField bits |dirty| and returns false once the animation has
+  // ended. StopAnimation leaves the style as shown and returns the bits it
+  // changed.
+  bool StepAnimation(PipWindow* window, unsigned dirty);
+  unsigned StopAnimation(PipWindow* window);
+
+  // Auto-fit mode: sets the text size to the largest that fits a |width| x
+  // |height| client area, from the sizes measured by MeasureFitText.
+  void FitTextSize(PipWindow* window, int width, int height);
+  // Height of |text| at |size| pixels in a client area |width| wide,
+  // wrapped to it if |wrap| and the renderer wraps.
+  double MeasureFitText(PipWindow* window, const std::wstring& text,
+                        int size, int width, bool wrap);
+
+  // GDI font for |size| pixels, shared by every window using that size.
+  HFONT SharedFont(int size);
+
+  // Windows by id. The default window always exists; it is the one
+  // addressed without an id and the target of the FFI entry points.
+  std::map<int64_t, std::unique_ptr<PipWindow>> windows_;
+  PipWindow*                     default_window_  = nullptr;
+  int64_t                        next_window_id_  = 1;
+
+  // Resources shared by all windows: the Direct2D/DirectWrite devices and
+  // text formats, and the GDI fallback's fonts.
+  std::shared_ptr<DirectWriteDevice> d2d_device_;
+  std::map<int, HFONT>           fonts_;
+
+  // Swapped with the staged FFI text so steady streaming does not allocate.
+  std::string                    ffi_text_;
 
   // Flutter channel
   std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> channel_;
@@ -55,6 +318,10 @@ class PipPlugin : public flutter::Plugin {
   // Window class registration
   static bool window_class_registered_;
   static const wchar_t kPipWindowClass[];
+  static const UINT_PTR kRepaintTimerId = 1;
+  static const UINT_PTR kClockTimerId = 2;
+  static const UINT_PTR kCueTimerId = 3;
+  static const UINT_PTR kAnimationTimerId = 4;
 };
 
 }  // namespace pip_plugin
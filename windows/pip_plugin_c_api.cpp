@@ -1,8 +1,10 @@
 #include "include/pip_plugin/pip_plugin_c_api.h"
+#include "include/pip_plugin/pip_plugin_ffi.h"
 
 #include <flutter/plugin_registrar_windows.h>
 
 #include "pip_plugin.h"
+#include "text_ring.h"
 
 void PipPluginCApiRegisterWithRegistrar(
     FlutterDesktopPluginRegistrarRef registrar) {
@@ -10,3 +12,41 @@ void PipPluginCApiRegisterWithRegistrar(
       flutter::PluginRegistrarManager::GetInstance()
           ->GetRegistrar<flutter::PluginRegistrarWindows>(registrar));
 }
+
+void pip_plugin_ffi_set_text(const char* text) {
+  pip_plugin::PipPlugin::StageFfiText(text, true);
+}
+
+void pip_plugin_ffi_append_text(const char* text) {
+  pip_plugin::PipPlugin::StageFfiText(text, false);
+}
+
+void pip_plugin_ffi_request_redraw() {
+  pip_plugin::PipPlugin::StageFfiRedraw();
+}
+
+uint8_t* pip_plugin_ffi_ring_open(uint32_t capacity) {
+  return pip_plugin::PipPlugin::OpenFfiRing(capacity)->data();
+}
+
+uint32_t pip_plugin_ffi_ring_capacity() {
+  pip_plugin::TextRing* ring = pip_plugin::PipPlugin::FfiRing();
+  return ring ? ring->capacity() : 0;
+}
+
+uint64_t pip_plugin_ffi_ring_read_index() {
+  pip_plugin::TextRing* ring = pip_plugin::PipPlugin::FfiRing();
+  return ring ? ring->read_index() : 0;
+}
+
+uint64_t pip_plugin_ffi_ring_write_index() {
+  pip_plugin::TextRing* ring = pip_plugin::PipPlugin::FfiRing();
+  return ring ? ring->write_index() : 0;
+}
+
+void pip_plugin_ffi_ring_publish(uint64_t write_index) {
+  pip_plugin::TextRing* ring = pip_plugin::PipPlugin::FfiRing();
+  if (ring && ring->Publish(write_index)) {
+    pip_plugin::PipPlugin::WakeFfiRingConsumer();
+  }
+}
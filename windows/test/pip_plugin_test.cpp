@@ -7,6 +7,7 @@
 #include <memory>
 #include <string>
 #include <variant>
+#include <vector>
 
 #include "pip_plugin.h"
 
@@ -39,5 +40,138 @@ TEST(PipPlugin, GetPlatformVersion) {
   EXPECT_TRUE(result_string.rfind("Windows ", 0) == 0);
 }
 
+TEST(PipPlugin, ReplaceRangeRequiresRange) {
+  PipPlugin plugin;
+  std::string error_code;
+  EncodableMap args = {{EncodableValue("text"), EncodableValue("abc")}};
+  plugin.HandleMethodCall(
+      MethodCall("replaceRange",
+                 std::make_unique<EncodableValue>(EncodableValue(args))),
+      std::make_unique<MethodResultFunctions<>>(
+          nullptr,
+          [&error_code](const std::string& code, const std::string& message,
+                        const EncodableValue* details) { error_code = code; },
+          nullptr));
+
+  EXPECT_EQ(error_code, "invalid_argument");
+
+  // A start after the end is rejected rather than becoming an insert.
+  error_code.clear();
+  args[EncodableValue("start")] = EncodableValue(3);
+  args[EncodableValue("end")] = EncodableValue(1);
+  plugin.HandleMethodCall(
+      MethodCall("replaceRange",
+                 std::make_unique<EncodableValue>(EncodableValue(args))),
+      std::make_unique<MethodResultFunctions<>>(
+          nullptr,
+          [&error_code](const std::string& code, const std::string& message,
+                        const EncodableValue* details) { error_code = code; },
+          nullptr));
+
+  EXPECT_EQ(error_code, "invalid_argument");
+}
+
+TEST(PipPlugin, GetStatsCountsUpdates) {
+  PipPlugin plugin;
+  for (const char* text : {"one", "two"}) {
+    EncodableMap args = {{EncodableValue("text"), EncodableValue(text)}};
+    plugin.HandleMethodCall(
+        MethodCall("updateText",
+                   std::make_unique<EncodableValue>(EncodableValue(args))),
+        std::make_unique<MethodResultFunctions<>>(nullptr, nullptr, nullptr));
+  }
+
+  EncodableMap stats;
+  plugin.HandleMethodCall(
+      MethodCall("getStats", std::make_unique<EncodableValue>()),
+      std::make_unique<MethodResultFunctions<>>(
+          [&stats](const EncodableValue* result) {
+            stats = std::get<EncodableMap>(*result);
+          },
+          nullptr, nullptr));
+
+  // Without a window every update is applied right away.
+  EXPECT_EQ(std::get<int64_t>(stats[EncodableValue("updates")]), 2);
+  EXPECT_EQ(std::get<int64_t>(stats[EncodableValue("superseded")]), 0);
+}
+
+TEST(PipPlugin, UnknownWindowIdIsAnError) {
+  PipPlugin plugin;
+  std::string error_code;
+  EncodableMap args = {{EncodableValue("id"), EncodableValue(42)},
+                       {EncodableValue("text"), EncodableValue("abc")}};
+  plugin.HandleMethodCall(
+      MethodCall("updateText",
+                 std::make_unique<EncodableValue>(EncodableValue(args))),
+      std::make_unique<MethodResultFunctions<>>(
+          nullptr,
+          [&error_code](const std::string& code, const std::string& message,
+                        const EncodableValue* details) { error_code = code; },
+          nullptr));
+
+  EXPECT_EQ(error_code, "unknown_window");
+}
+
+TEST(PipPlugin, LoadTextFileReturnsFalseForMissingFile) {
+  PipPlugin plugin;
+  bool loaded = true;
+  std::string error_code;
+  EncodableMap args = {
+      {EncodableValue("path"), EncodableValue("no\\such\\script.txt")}};
+  plugin.HandleMethodCall(
+      MethodCall("loadTextFile",
+                 std::make_unique<EncodableValue>(EncodableValue(args))),
+      std::make_unique<MethodResultFunctions<>>(
+          [&loaded](const EncodableValue* result) {
+            loaded = std::get<bool>(*result);
+          },
+          [&error_code](const std::string& code, const std::string& message,
+                        const EncodableValue* details) { error_code = code; },
+          nullptr));
+
+  // As on Linux, a file that cannot be read is not an error.
+  EXPECT_FALSE(loaded);
+  EXPECT_TRUE(error_code.empty());
+}
+
+TEST(PipPlugin, ApplyBatchIsAllOrNothing) {
+  PipPlugin plugin;
+  EncodableMap update_text = {
+      {EncodableValue("method"), EncodableValue("updateText")},
+      {EncodableValue("args"),
+       EncodableValue(EncodableMap{
+           {EncodableValue("text"), EncodableValue("abc")}})}};
+  EncodableMap bad_range = {
+      {EncodableValue("method"), EncodableValue("replaceRange")},
+      {EncodableValue("args"),
+       EncodableValue(EncodableMap{
+           {EncodableValue("start"), EncodableValue(3)},
+           {EncodableValue("end"), EncodableValue(1)},
+           {EncodableValue("text"), EncodableValue("x")}})}};
+  bool applied = true;
+  plugin.HandleMethodCall(
+      MethodCall("applyBatch",
+                 std::make_unique<EncodableValue>(flutter::EncodableList{
+                     EncodableValue(update_text), EncodableValue(bad_range)})),
+      std::make_unique<MethodResultFunctions<>>(
+          [&applied](const EncodableValue* result) {
+            applied = std::get<bool>(*result);
+          },
+          nullptr, nullptr));
+
+  EncodableMap stats;
+  plugin.HandleMethodCall(
+      MethodCall("getStats", std::make_unique<EncodableValue>()),
+      std::make_unique<MethodResultFunctions<>>(
+          [&stats](const EncodableValue* result) {
+            stats = std::get<EncodableMap>(*result);
+          },
+          nullptr, nullptr));
+
+  // The invalid range rejects the whole batch, so the text is not set.
+  EXPECT_FALSE(applied);
+  EXPECT_EQ(std::get<int64_t>(stats[EncodableValue("updates")]), 0);
+}
+
 }  // namespace test
 }  // namespace pip_plugin